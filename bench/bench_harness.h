@@ -0,0 +1,606 @@
+/**
+ * @brief 微基准测试的运行框架，用法和输出格式参照google-benchmark
+ */
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <regex>
+#include <stdexcept>
+#include <ctime>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef POOL_VERSION
+#define POOL_VERSION "unknown"
+#endif
+
+/**
+ * @brief 基准测试框架
+ *
+ * 没有引入google-benchmark依赖，只实现了用到的部分，JSON输出的字段和google-benchmark相同，
+ * 可以直接用它的tools/compare.py比较两个版本的结果：
+ * ./bin/bench_pool --benchmark_out=new.json
+ * compare.py benchmarks old.json new.json
+ *
+ * 使用示例：
+ * Bench::Runner runner(argc, argv);
+ * runner.add("escape/clean", [](Bench::State &state) {
+ *     std::string input(64, 'a');
+ *     while (state.keepRunning())
+ *         Bench::doNotOptimize(Utils::escapeMySQLString(input));
+ *     state.setBytesProcessed(state.iterations() * input.size());
+ * });
+ * return runner.run();
+ *
+ * 命令行参数：
+ * --benchmark_filter=<regex>       只运行名字匹配的基准测试
+ * --benchmark_min_time=<秒>        每次运行至少持续的时间，默认0.5秒
+ * --benchmark_repetitions=<n>      重复运行的次数，大于1时额外输出mean/median/stddev
+ * --benchmark_format=console|json  标准输出的格式，默认console
+ * --benchmark_out=<文件>           同时把JSON结果写入文件
+ */
+namespace Bench
+{
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 当前线程使用的CPU时间（纳秒）
+     */
+    inline double threadCpuNanos()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+    }
+
+    /**
+     * @brief 阻止编译器把结果优化掉
+     */
+    template <typename T>
+    inline void doNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * @brief 一个线程一次运行的状态，基准测试函数通过它控制计时的循环
+     */
+    class State
+    {
+    public:
+        State(size_t maxIterations, int threadIndex, int threads)
+            : m_maxIterations(maxIterations), m_remaining(maxIterations), m_threadIndex(threadIndex), m_threads(threads)
+        {
+        }
+
+        /**
+         * @brief 循环条件：第一次调用时开始计时，次数用完时停止计时并返回false
+         * 循环之前的代码是准备工作，不计入时间
+         */
+        bool keepRunning()
+        {
+            if (!m_started)
+            {
+                m_started = true;
+                resumeTiming();
+            }
+            if (m_remaining > 0 && m_error.empty())
+            {
+                --m_remaining;
+                return true;
+            }
+            if (!m_stopped)
+            {
+                m_stopped = true;
+                pauseTiming();
+            }
+            return false;
+        }
+
+        /**
+         * @brief 暂停计时，用于循环中不需要测量的部分
+         */
+        void pauseTiming()
+        {
+            m_elapsed += Clock::now() - m_start;
+            m_cpuNanos += threadCpuNanos() - m_cpuStart;
+        }
+
+        /**
+         * @brief 恢复计时
+         */
+        void resumeTiming()
+        {
+            m_start = Clock::now();
+            m_cpuStart = threadCpuNanos();
+        }
+
+        /**
+         * @brief 已经执行的循环次数
+         */
+        size_t iterations() const { return m_maxIterations - m_remaining; }
+
+        int threadIndex() const { return m_threadIndex; }
+        int threads() const { return m_threads; }
+
+        /**
+         * @brief 处理的条目数，用于计算items_per_second
+         */
+        void setItemsProcessed(uint64_t items) { m_items = items; }
+
+        /**
+         * @brief 处理的字节数，用于计算bytes_per_second
+         */
+        void setBytesProcessed(uint64_t bytes) { m_bytes = bytes; }
+
+        /**
+         * @brief 运行失败（例如数据库不可用），结果中标记error_occurred，keepRunning立即返回false
+         */
+        void skipWithError(const std::string &message) { m_error = message; }
+
+        /**
+         * @brief 附加在结果中的说明，例如"pool_size:8"
+         */
+        void setLabel(const std::string &label) { m_label = label; }
+
+    private:
+        friend class Runner;
+
+        const size_t m_maxIterations;
+        size_t m_remaining;
+        const int m_threadIndex;
+        const int m_threads;
+        bool m_started = false;
+        bool m_stopped = false;
+        Clock::time_point m_start;
+        Clock::duration m_elapsed{0};
+        double m_cpuStart = 0;
+        double m_cpuNanos = 0;          // 计时期间这个线程使用的CPU时间
+        uint64_t m_items = 0;
+        uint64_t m_bytes = 0;
+        std::string m_error;
+        std::string m_label;
+    };
+
+    using Function = std::function<void(State &)>;
+
+    /**
+     * @brief 一次运行（或者一个汇总）的结果，字段和google-benchmark的JSON输出对应
+     */
+    struct Result
+    {
+        std::string name;
+        std::string runName;            // 不带汇总后缀的名字
+        std::string runType = "iteration";  // iteration或者aggregate
+        std::string aggregateName;      // mean、median、stddev
+        int repetitions = 1;
+        int repetitionIndex = 0;
+        int threads = 1;
+        uint64_t iterations = 0;        // 所有线程的循环次数之和
+        double realTime = 0;            // 每次循环的时间（纳秒）
+        double cpuTime = 0;             // 每次循环使用的CPU时间（纳秒）
+        double itemsPerSecond = 0;
+        double bytesPerSecond = 0;
+        std::string label;
+        std::string error;
+    };
+
+    /**
+     * @brief 注册、运行基准测试并输出结果
+     */
+    class Runner
+    {
+    public:
+        Runner(int argc, char **argv)
+        {
+            for (int i = 1; i < argc; ++i)
+            {
+                std::string arg = argv[i];
+                if (!parseFlag(arg, "--benchmark_filter=", m_filter) &&
+                    !parseFlag(arg, "--benchmark_format=", m_format) &&
+                    !parseFlag(arg, "--benchmark_out=", m_outFile))
+                {
+                    std::string value;
+                    if (parseFlag(arg, "--benchmark_min_time=", value))
+                        m_minTime = std::max(0.01, std::atof(value.c_str()));
+                    else if (parseFlag(arg, "--benchmark_repetitions=", value))
+                        m_repetitions = std::max(1, std::atoi(value.c_str()));
+                    else
+                        std::cerr << "忽略未知的参数：" << arg << std::endl;
+                }
+            }
+        }
+
+        /**
+         * @brief 注册一个基准测试
+         * @param threads 同时运行的线程数，名字自动加上"/threads:n"后缀
+         */
+        void add(const std::string &name, Function function, int threads = 1)
+        {
+            std::string fullName = threads > 1 ? name + "/threads:" + std::to_string(threads) : name;
+            m_benchmarks.push_back({fullName, std::move(function), threads});
+        }
+
+        /**
+         * @brief 运行所有匹配的基准测试
+         * @return 进程退出码，结果文件无法写入时返回1；单个基准测试的失败只记录在结果中
+         */
+        int run()
+        {
+            std::regex filter(m_filter.empty() ? "." : m_filter);
+            std::vector<Result> results;
+            bool console = m_format != "json";
+            if (console)
+                printHeader();
+            for (const Benchmark &benchmark : m_benchmarks)
+            {
+                if (!std::regex_search(benchmark.name, filter))
+                    continue;
+                std::vector<Result> runs;
+                for (int r = 0; r < m_repetitions; ++r)
+                {
+                    Result result = runOnce(benchmark);
+                    result.repetitions = m_repetitions;
+                    result.repetitionIndex = r;
+                    if (console)
+                        printResult(result);
+                    runs.push_back(result);
+                    if (!result.error.empty())
+                        break;
+                }
+                results.insert(results.end(), runs.begin(), runs.end());
+                if (m_repetitions > 1 && runs.back().error.empty())
+                {
+                    for (const Result &aggregate : aggregates(runs))
+                    {
+                        if (console)
+                            printResult(aggregate);
+                        results.push_back(aggregate);
+                    }
+                }
+            }
+
+            if (!console)
+                writeJson(std::cout, results);
+            if (!m_outFile.empty())
+            {
+                std::ofstream out(m_outFile);
+                if (!out)
+                {
+                    std::cerr << "无法写入结果文件：" << m_outFile << std::endl;
+                    return 1;
+                }
+                writeJson(out, results);
+            }
+            return 0;
+        }
+
+    private:
+        struct Benchmark
+        {
+            std::string name;
+            Function function;
+            int threads;
+        };
+
+        static bool parseFlag(const std::string &arg, const std::string &prefix, std::string &value)
+        {
+            if (arg.compare(0, prefix.size(), prefix) != 0)
+                return false;
+            value = arg.substr(prefix.size());
+            return true;
+        }
+
+        /**
+         * @brief 基准测试函数抛出的异常记录为这次运行的错误
+         */
+        static void invoke(const Benchmark &benchmark, State &state)
+        {
+            try
+            {
+                benchmark.function(state);
+            }
+            catch (const std::exception &e)
+            {
+                state.skipWithError(e.what());
+            }
+        }
+
+        /**
+         * @brief 所有线程执行给定的循环次数，线程同时开始
+         */
+        Result runIterations(const Benchmark &benchmark, size_t iterations)
+        {
+            std::vector<State> states;
+            for (int t = 0; t < benchmark.threads; ++t)
+                states.emplace_back(iterations, t, benchmark.threads);
+
+            if (benchmark.threads == 1)
+            {
+                invoke(benchmark, states[0]);
+            }
+            else
+            {
+                std::mutex mutex;
+                std::condition_variable ready;
+                int waiting = 0;
+                std::vector<std::thread> threads;
+                for (int t = 0; t < benchmark.threads; ++t)
+                {
+                    threads.emplace_back([&, t] {
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            if (++waiting == benchmark.threads)
+                                ready.notify_all();
+                            else
+                                ready.wait(lock, [&] { return waiting == benchmark.threads; });
+                        }
+                        invoke(benchmark, states[t]);
+                    });
+                }
+                for (auto &thread : threads)
+                    thread.join();
+            }
+
+            // 每个线程的耗时取平均，每次循环的时间是单个线程看到的延迟
+            Result result;
+            result.name = result.runName = benchmark.name;
+            result.threads = benchmark.threads;
+            double elapsedNanos = 0;
+            double cpuNanos = 0;
+            uint64_t items = 0;
+            uint64_t bytes = 0;
+            for (const State &state : states)
+            {
+                if (!state.m_error.empty() && result.error.empty())
+                    result.error = state.m_error;
+                if (!state.m_label.empty())
+                    result.label = state.m_label;
+                result.iterations += state.iterations();
+                elapsedNanos += std::chrono::duration<double, std::nano>(state.m_elapsed).count();
+                cpuNanos += state.m_cpuNanos;
+                items += state.m_items;
+                bytes += state.m_bytes;
+            }
+            double meanElapsed = elapsedNanos / benchmark.threads;
+            if (result.iterations > 0)
+            {
+                result.realTime = elapsedNanos / result.iterations;
+                result.cpuTime = cpuNanos / result.iterations;
+            }
+            if (meanElapsed > 0)
+            {
+                result.itemsPerSecond = items * 1e9 / meanElapsed;
+                result.bytesPerSecond = bytes * 1e9 / meanElapsed;
+            }
+            m_lastElapsed = meanElapsed / 1e9;
+            return result;
+        }
+
+        /**
+         * @brief 循环次数从1开始增加，直到一次运行持续m_minTime秒
+         */
+        Result runOnce(const Benchmark &benchmark)
+        {
+            size_t iterations = 1;
+            while (true)
+            {
+                Result result = runIterations(benchmark, iterations);
+                if (!result.error.empty() || m_lastElapsed >= m_minTime || iterations >= maxIterations())
+                    return result;
+                // 按照目前的速度估计需要的次数，多估计40%，每次最多增加10倍
+                double multiplier = m_lastElapsed > 0 ? m_minTime * 1.4 / m_lastElapsed : 10.0;
+                multiplier = std::min(10.0, std::max(multiplier, 2.0));
+                iterations = std::min(maxIterations(), static_cast<size_t>(iterations * multiplier));
+            }
+        }
+
+        static std::vector<Result> aggregates(const std::vector<Result> &runs)
+        {
+            auto make = [&runs](const std::string &name, double (*reduce)(std::vector<double>)) {
+                Result result = runs.front();
+                result.name = result.runName + "_" + name;
+                result.runType = "aggregate";
+                result.aggregateName = name;
+                std::vector<double> times, cpuTimes, items, bytes;
+                for (const Result &run : runs)
+                {
+                    times.push_back(run.realTime);
+                    cpuTimes.push_back(run.cpuTime);
+                    items.push_back(run.itemsPerSecond);
+                    bytes.push_back(run.bytesPerSecond);
+                }
+                result.realTime = reduce(times);
+                result.cpuTime = reduce(cpuTimes);
+                result.itemsPerSecond = reduce(items);
+                result.bytesPerSecond = reduce(bytes);
+                return result;
+            };
+            return {make("mean", mean), make("median", median), make("stddev", stddev)};
+        }
+
+        static double mean(std::vector<double> values)
+        {
+            double sum = 0;
+            for (double value : values)
+                sum += value;
+            return sum / values.size();
+        }
+
+        static double median(std::vector<double> values)
+        {
+            std::sort(values.begin(), values.end());
+            size_t mid = values.size() / 2;
+            return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+        }
+
+        static double stddev(std::vector<double> values)
+        {
+            if (values.size() < 2)
+                return 0;
+            double m = mean(values);
+            double sum = 0;
+            for (double value : values)
+                sum += (value - m) * (value - m);
+            return std::sqrt(sum / (values.size() - 1));
+        }
+
+        // =============================
+        // 输出
+        // =============================
+
+        static std::string humanRate(double perSecond, const char *unit)
+        {
+            static const char *prefixes[] = {"", "k", "M", "G", "T"};
+            int p = 0;
+            while (perSecond >= 1000.0 && p < 4)
+            {
+                perSecond /= 1000.0;
+                ++p;
+            }
+            std::ostringstream oss;
+            oss << std::fixed << std::setprecision(2) << perSecond << prefixes[p] << unit;
+            return oss.str();
+        }
+
+        void printHeader() const
+        {
+            std::cout << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(14) << "Time"
+                      << std::setw(14) << "CPU" << std::setw(14) << "Iterations" << "  UserCounters..." << '\n'
+                      << std::string(110, '-') << std::endl;
+        }
+
+        static void printResult(const Result &result)
+        {
+            std::cout << std::left << std::setw(48) << result.name << std::right;
+            if (!result.error.empty())
+            {
+                std::cout << "  ERROR: " << result.error << std::endl;
+                return;
+            }
+            std::ostringstream time, cpu;
+            time << std::fixed << std::setprecision(1) << result.realTime << " ns";
+            cpu << std::fixed << std::setprecision(1) << result.cpuTime << " ns";
+            std::cout << std::setw(14) << time.str() << std::setw(14) << cpu.str() << std::setw(14) << result.iterations;
+            if (result.bytesPerSecond > 0)
+                std::cout << "  " << humanRate(result.bytesPerSecond, "B/s");
+            if (result.itemsPerSecond > 0)
+                std::cout << "  " << humanRate(result.itemsPerSecond, " items/s");
+            if (!result.label.empty())
+                std::cout << "  " << result.label;
+            std::cout << std::endl;
+        }
+
+        static std::string jsonString(const std::string &value)
+        {
+            std::string out = "\"";
+            for (char c : value)
+            {
+                switch (c)
+                {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        char buffer[8];
+                        snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                        out += buffer;
+                    }
+                    else
+                    {
+                        out += c;
+                    }
+                }
+            }
+            return out + "\"";
+        }
+
+        void writeJson(std::ostream &out, const std::vector<Result> &results) const
+        {
+            char date[32] = "";
+            char host[256] = "";
+            std::time_t now = std::time(nullptr);
+            std::tm tm;
+            localtime_r(&now, &tm);
+            std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+            gethostname(host, sizeof(host) - 1);
+
+            out << "{\n  \"context\": {\n"
+                << "    \"date\": " << jsonString(date) << ",\n"
+                << "    \"host_name\": " << jsonString(host) << ",\n"
+                << "    \"executable\": \"bench_pool\",\n"
+                << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+                << "    \"mysql_pool_version\": " << jsonString(POOL_VERSION) << ",\n"
+#ifdef NDEBUG
+                << "    \"library_build_type\": \"release\"\n"
+#else
+                << "    \"library_build_type\": \"debug\"\n"
+#endif
+                << "  },\n  \"benchmarks\": [";
+            out << std::setprecision(10);
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                const Result &result = results[i];
+                out << (i > 0 ? "," : "") << "\n    {\n"
+                    << "      \"name\": " << jsonString(result.name) << ",\n"
+                    << "      \"run_name\": " << jsonString(result.runName) << ",\n"
+                    << "      \"run_type\": " << jsonString(result.runType) << ",\n"
+                    << "      \"repetitions\": " << result.repetitions << ",\n"
+                    << "      \"repetition_index\": " << result.repetitionIndex << ",\n"
+                    << "      \"threads\": " << result.threads << ",\n";
+                if (!result.aggregateName.empty())
+                    out << "      \"aggregate_name\": " << jsonString(result.aggregateName) << ",\n";
+                if (!result.error.empty())
+                    out << "      \"error_occurred\": true,\n"
+                        << "      \"error_message\": " << jsonString(result.error) << ",\n";
+                if (!result.label.empty())
+                    out << "      \"label\": " << jsonString(result.label) << ",\n";
+                if (result.bytesPerSecond > 0)
+                    out << "      \"bytes_per_second\": " << result.bytesPerSecond << ",\n";
+                if (result.itemsPerSecond > 0)
+                    out << "      \"items_per_second\": " << result.itemsPerSecond << ",\n";
+                out << "      \"iterations\": " << result.iterations << ",\n"
+                    << "      \"real_time\": " << result.realTime << ",\n"
+                    << "      \"cpu_time\": " << result.cpuTime << ",\n"
+                    << "      \"time_unit\": \"ns\"\n    }";
+            }
+            out << "\n  ]\n}\n";
+        }
+
+        static size_t maxIterations() { return 1000000000; }
+
+        std::vector<Benchmark> m_benchmarks;
+        std::string m_filter;
+        std::string m_format = "console";
+        std::string m_outFile;
+        double m_minTime = 0.5;
+        int m_repetitions = 1;
+        double m_lastElapsed = 0;   // 上一次runIterations的耗时（秒）
+    };
+}   // namespace Bench
+
+#endif  // BENCH_HARNESS_H
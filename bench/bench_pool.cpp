@@ -0,0 +1,283 @@
+#include <string>
+#include <memory>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include "bench_harness.h"
+#include "utils.h"
+#include "logger.h"
+#include "connection.h"
+#include "connection_pool.h"
+#include "fake_mysql_server.h"
+
+/**
+ * @brief 连接池的微基准测试，结果用于比较不同版本之间的性能变化
+ *
+ * 不需要数据库的部分（字符串转义、随机字符串、日志）总是运行；
+ * QueryResult、Connection和连接池的部分默认连接进程内的FakeMySQLServer，不需要真实的MySQL，
+ * MYSQL_POOL_BENCH_LATENCY_US设置模拟服务器每个命令的延迟（微秒，默认0）；
+ * 设置了MYSQL_POOL_BENCH_HOST时改为连接真实的MySQL，连接失败时这些基准测试被标记为error：
+ * MYSQL_POOL_BENCH_HOST、MYSQL_POOL_BENCH_PORT（3306）、MYSQL_POOL_BENCH_USER（admin）、
+ * MYSQL_POOL_BENCH_PASSWORD（123456）、MYSQL_POOL_BENCH_DATABASE（testdb）
+ *
+ * 运行：./bin/bench_pool --benchmark_out=bench.json，或者cmake --build build --target bench
+ */
+
+namespace
+{
+    std::string envOr(const char *name, const std::string &defaultValue)
+    {
+        const char *value = std::getenv(name);
+        return value && *value ? value : defaultValue;
+    }
+
+    /**
+     * @brief 基准测试使用的数据库
+     */
+    struct BenchServer
+    {
+        std::string host = envOr("MYSQL_POOL_BENCH_HOST", "");
+        std::string user = envOr("MYSQL_POOL_BENCH_USER", "admin");
+        std::string password = envOr("MYSQL_POOL_BENCH_PASSWORD", "123456");
+        std::string database = envOr("MYSQL_POOL_BENCH_DATABASE", "testdb");
+        unsigned int port = static_cast<unsigned int>(std::atoi(envOr("MYSQL_POOL_BENCH_PORT", "3306").c_str()));
+    };
+
+    // 1000行 × 4列的结果集，覆盖整数、字符串、浮点数
+    const char *kResultSql =
+        "WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < 1000) "
+        "SELECT n AS id, CONCAT('user_', n) AS name, n % 90 AS age, n / 7 AS score FROM seq";
+
+    const int kPoolSize = 8;
+
+    /**
+     * @brief 模拟服务器的脚本：kResultSql返回和MySQL相同形状的结果集
+     */
+    void scriptFakeServer(FakeMySQLServer &fake)
+    {
+        std::vector<FakeMySQLServer::Row> rows;
+        for (int n = 1; n <= 1000; ++n)
+        {
+            rows.push_back({std::to_string(n), "user_" + std::to_string(n), std::to_string(n % 90),
+                            std::to_string(n / 7.0)});
+        }
+        fake.addResponse(kResultSql, FakeMySQLServer::Response::resultSet({"id", "name", "age", "score"}, std::move(rows)));
+        fake.setCommandLatency(std::chrono::microseconds(std::atoi(envOr("MYSQL_POOL_BENCH_LATENCY_US", "0").c_str())));
+    }
+
+    // =============================
+    // 不需要数据库的基准测试
+    // =============================
+
+    void benchEscape(Bench::State &state, const std::string &input)
+    {
+        while (state.keepRunning())
+            Bench::doNotOptimize(Utils::escapeMySQLString(input));
+        state.setBytesProcessed(state.iterations() * input.size());
+    }
+
+    /**
+     * @brief 长度为length、每隔period个字符有一个需要转义的字符的输入
+     */
+    std::string makeEscapeInput(size_t length, size_t period)
+    {
+        static const char special[] = {'\'', '"', '\\', '\n', '\0'};
+        std::string input = Utils::generateRandomString(length);
+        for (size_t i = period - 1; period > 0 && i < length; i += period)
+            input[i] = special[(i / period) % sizeof(special)];
+        return input;
+    }
+
+    void benchRandomString(Bench::State &state, size_t length)
+    {
+        while (state.keepRunning())
+            Bench::doNotOptimize(Utils::generateRandomString(length));
+        state.setItemsProcessed(state.iterations());
+        state.setBytesProcessed(state.iterations() * length);
+    }
+
+    void benchLoggerInfo(Bench::State &state)
+    {
+        const std::string message = "bench thread " + std::to_string(state.threadIndex()) + " acquired connection";
+        while (state.keepRunning())
+            LOG_INFO(message);
+        state.setItemsProcessed(state.iterations());
+    }
+
+    void benchLoggerFiltered(Bench::State &state)
+    {
+        const std::string message = "filtered debug message";
+        while (state.keepRunning())
+            LOG_DEBUG(message);
+        state.setItemsProcessed(state.iterations());
+    }
+
+    // =============================
+    // 需要数据库的基准测试
+    // =============================
+
+    /**
+     * @brief 每次循环遍历一遍结果集，读取每一行的所有列
+     * @param byName true按照列名读取，false按照下标读取
+     */
+    void benchResultAccess(Bench::State &state, const QueryResultPtr &result, bool byName)
+    {
+        if (!result)
+        {
+            state.skipWithError("MySQL server not available");
+            return;
+        }
+        uint64_t rows = 0;
+        while (state.keepRunning())
+        {
+            result->reset();
+            while (result->next())
+            {
+                if (byName)
+                {
+                    Bench::doNotOptimize(result->getLong("id"));
+                    Bench::doNotOptimize(result->getString("name"));
+                    Bench::doNotOptimize(result->getInt("age"));
+                    Bench::doNotOptimize(result->getDouble("score"));
+                }
+                else
+                {
+                    Bench::doNotOptimize(result->getLong(0));
+                    Bench::doNotOptimize(result->getString(1));
+                    Bench::doNotOptimize(result->getInt(2));
+                    Bench::doNotOptimize(result->getDouble(3));
+                }
+                ++rows;
+            }
+        }
+        state.setItemsProcessed(rows);
+    }
+
+    /**
+     * @brief 一个连接上连续执行查询，测量单次往返的延迟
+     */
+    void benchConnectionQuery(Bench::State &state, const ConnectionPtr &conn, const std::string &sql)
+    {
+        if (!conn)
+        {
+            state.skipWithError("MySQL server not available");
+            return;
+        }
+        while (state.keepRunning())
+            Bench::doNotOptimize(conn->executeQuery(sql));
+        state.setItemsProcessed(state.iterations());
+    }
+
+    /**
+     * @brief 借出连接、执行一次查询、归还，测量端到端的吞吐量
+     */
+    void benchPoolQuery(Bench::State &state, const std::shared_ptr<ConnectionPool> &pool)
+    {
+        if (!pool)
+        {
+            state.skipWithError("MySQL server not available");
+            return;
+        }
+        uint64_t failed = 0;
+        while (state.keepRunning())
+        {
+            ConnectionPtr conn = pool->getConnection();
+            if (conn)
+                Bench::doNotOptimize(conn->executeQuery("SELECT 1"));
+            else
+                ++failed;
+        }
+        state.setItemsProcessed(state.iterations() - failed);
+        state.setLabel("pool_size:" + std::to_string(kPoolSize) + " failed:" + std::to_string(failed));
+    }
+
+    /**
+     * @brief 借出并立即归还连接，线程数超过连接数时测量的是等待和唤醒的开销
+     */
+    void benchAcquireRelease(Bench::State &state, const std::shared_ptr<ConnectionPool> &pool)
+    {
+        if (!pool)
+        {
+            state.skipWithError("MySQL server not available");
+            return;
+        }
+        uint64_t failed = 0;
+        while (state.keepRunning())
+        {
+            ConnectionPtr conn = pool->getConnection();
+            if (!conn)
+                ++failed;
+            Bench::doNotOptimize(conn.get());
+        }
+        state.setItemsProcessed(state.iterations());
+        state.setLabel("pool_size:" + std::to_string(kPoolSize) + " failed:" + std::to_string(failed));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Logger::init在标准输出打印一行提示，转到标准错误，避免混入--benchmark_format=json的结果
+    std::streambuf *stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    Logger::getInstance().init("./bench_pool.log", LogLevel::INFO, false);
+    std::cout.rdbuf(stdoutBuffer);
+
+    BenchServer server;
+    std::unique_ptr<FakeMySQLServer> fake;
+    ConnectionPtr conn;
+    QueryResultPtr result;
+    std::shared_ptr<ConnectionPool> pool;
+    try
+    {
+        if (server.host.empty())
+        {
+            fake.reset(new FakeMySQLServer());
+            scriptFakeServer(*fake);
+            fake->start();
+            server.host = "127.0.0.1";
+            server.port = fake->port();
+            std::cerr << "Using embedded FakeMySQLServer on port " << server.port << std::endl;
+        }
+        conn = std::make_shared<Connection>(server.host, server.user, server.password, server.database, server.port);
+        if (!conn->connect())
+            throw std::runtime_error("cannot connect to " + server.user + "@" + server.host + ":" + std::to_string(server.port));
+        result = conn->executeQuery(kResultSql);
+        PoolConfig config{server.host, server.user, server.password, server.database, server.port};
+        config.setConnectionLimits(kPoolSize, kPoolSize, kPoolSize);
+        config.setTimeouts(1000, 300000, 30000);
+        pool = std::make_shared<ConnectionPool>(config);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "MySQL server not available, skipping result and pool benchmarks: " << e.what() << std::endl;
+        conn.reset();
+        result.reset();
+        pool.reset();
+    }
+
+    Bench::Runner runner(argc, argv);
+
+    const std::string clean = Utils::generateRandomString(64);
+    const std::string mixed = makeEscapeInput(1024, 10);
+    runner.add("escape/clean:64", [&clean](Bench::State &state) { benchEscape(state, clean); });
+    runner.add("escape/mixed:1024", [&mixed](Bench::State &state) { benchEscape(state, mixed); });
+
+    runner.add("random_string/16", [](Bench::State &state) { benchRandomString(state, 16); });
+    runner.add("random_string/256", [](Bench::State &state) { benchRandomString(state, 256); });
+
+    for (int threads : {1, 4, 8})
+        runner.add("logger/info", benchLoggerInfo, threads);
+    runner.add("logger/filtered", benchLoggerFiltered);
+
+    runner.add("query_result/by_index", [&result](Bench::State &state) { benchResultAccess(state, result, false); });
+    runner.add("query_result/by_name", [&result](Bench::State &state) { benchResultAccess(state, result, true); });
+
+    runner.add("connection/query", [&conn](Bench::State &state) { benchConnectionQuery(state, conn, "SELECT 1"); });
+    runner.add("connection/query_1000_rows", [&conn](Bench::State &state) { benchConnectionQuery(state, conn, kResultSql); });
+
+    for (int threads : {1, 4, 16})
+        runner.add("pool/acquire_release", [&pool](Bench::State &state) { benchAcquireRelease(state, pool); }, threads);
+    for (int threads : {1, 4, 16})
+        runner.add("pool/query", [&pool](Bench::State &state) { benchPoolQuery(state, pool); }, threads);
+
+    return runner.run();
+}
@@ -0,0 +1,481 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include "logger.h"
+#include "connection_pool.h"
+#include "pool_metrics.h"
+#include "fake_mysql_server.h"
+
+#ifndef POOL_VERSION
+#define POOL_VERSION "unknown"
+#endif
+
+/**
+ * @brief 故障恢复测试：在FakeMySQLServer上注入故障，测量故障期间的错误率和故障解除之后的恢复时间
+ *
+ * 每个场景使用两个数据库实例（两个模拟服务器），多个线程不断地借出连接、执行SELECT 1、归还：
+ * 1）基线阶段：没有故障，得到正常的吞吐量
+ * 2）故障阶段：注入故障
+ * 3）恢复阶段：解除故障，直到恢复或者超过上限
+ * 按照固定的时间分段统计成功和失败的次数，恢复时间是从解除故障到第一个"连续3个分段没有错误、
+ * 成功次数不低于基线的80%"的分段开始的时间，没有恢复时为-1
+ *
+ * 场景：
+ * drop_mid_query      两个实例都以5%的概率在查询中途断开连接
+ * restart_slow_handshake  两个实例断开所有连接（重启），之后的握手延迟200毫秒
+ * deadlock            两个实例都以10%的概率返回ER_LOCK_DEADLOCK
+ * blackhole_instance  第一个实例变成黑洞，不响应任何数据
+ *
+ * 命令行参数：
+ * --scenario=<名字>    只运行一个场景
+ * --threads=<n>        工作线程数，默认16
+ * --baseline_ms=<n>    基线阶段的时间，默认1000
+ * --fault_ms=<n>       故障阶段的时间，默认2000
+ * --recovery_ms=<n>    恢复阶段的上限，默认10000
+ * --out=<文件>         JSON结果同时写入文件
+ *
+ * 结果以JSON输出到标准输出，可读的摘要输出到标准错误
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int kInstanceCount = 2;
+    const int kPoolSize = 8;
+    const std::chrono::milliseconds kWindow(50);       // 统计分段的长度
+    const int kStableWindows = 3;                       // 判断已经恢复需要的连续分段数
+    const double kRecoveredRatio = 0.8;                 // 恢复之后的吞吐量至少是基线的80%
+
+    struct Options
+    {
+        std::string scenario;
+        int threads = 16;
+        int baselineMs = 1000;
+        int faultMs = 2000;
+        int recoveryMs = 10000;
+        std::string outFile;
+    };
+
+    /**
+     * @brief 一个故障场景：inject注入故障，clear解除故障
+     */
+    struct Scenario
+    {
+        std::string name;
+        std::string description;
+        std::function<void(std::vector<std::unique_ptr<FakeMySQLServer>> &)> inject;
+        std::function<void(std::vector<std::unique_ptr<FakeMySQLServer>> &)> clear;
+    };
+
+    void clearAll(std::vector<std::unique_ptr<FakeMySQLServer>> &servers)
+    {
+        for (auto &server : servers)
+            server->setFaults(FakeMySQLServer::Faults());
+    }
+
+    std::vector<Scenario> makeScenarios()
+    {
+        std::vector<Scenario> scenarios;
+        scenarios.push_back({"drop_mid_query", "all instances drop 5% of queries without replying (CR_SERVER_LOST)",
+                             [](std::vector<std::unique_ptr<FakeMySQLServer>> &servers) {
+                                 FakeMySQLServer::Faults faults;
+                                 faults.dropRate = 0.05;
+                                 for (auto &server : servers)
+                                     server->setFaults(faults);
+                             },
+                             clearAll});
+        scenarios.push_back({"restart_slow_handshake", "all instances drop every connection, then delay handshakes by 200ms",
+                             [](std::vector<std::unique_ptr<FakeMySQLServer>> &servers) {
+                                 FakeMySQLServer::Faults faults;
+                                 faults.handshakeDelay = std::chrono::milliseconds(200);
+                                 for (auto &server : servers)
+                                 {
+                                     server->setFaults(faults);
+                                     server->disconnectAll();
+                                 }
+                             },
+                             clearAll});
+        scenarios.push_back({"deadlock", "all instances fail 10% of queries with ER_LOCK_DEADLOCK (1213)",
+                             [](std::vector<std::unique_ptr<FakeMySQLServer>> &servers) {
+                                 FakeMySQLServer::Faults faults;
+                                 faults.deadlockRate = 0.1;
+                                 for (auto &server : servers)
+                                     server->setFaults(faults);
+                             },
+                             clearAll});
+        scenarios.push_back({"blackhole_instance", "the first instance stops answering anything until the fault is cleared",
+                             [](std::vector<std::unique_ptr<FakeMySQLServer>> &servers) {
+                                 FakeMySQLServer::Faults faults;
+                                 faults.blackhole = true;
+                                 servers.front()->setFaults(faults);
+                             },
+                             clearAll});
+        return scenarios;
+    }
+
+    /**
+     * @brief 按照时间分段统计成功和失败的次数，可以在多个线程中并发记录
+     */
+    class Timeline
+    {
+    public:
+        Timeline(Clock::time_point start, size_t windowCount)
+            : m_start(start)
+            , m_windowCount(windowCount)
+            , m_ok(new std::atomic<uint64_t>[windowCount])
+            , m_errors(new std::atomic<uint64_t>[windowCount])
+        {
+            for (size_t i = 0; i < windowCount; ++i)
+            {
+                m_ok[i].store(0, std::memory_order_relaxed);
+                m_errors[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        size_t indexOf(Clock::time_point time) const
+        {
+            auto offset = std::chrono::duration_cast<std::chrono::milliseconds>(time - m_start);
+            size_t index = static_cast<size_t>(std::max<int64_t>(0, offset.count() / kWindow.count()));
+            return std::min(index, m_windowCount - 1);
+        }
+
+        void record(Clock::time_point time, bool ok)
+        {
+            (ok ? m_ok : m_errors)[indexOf(time)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t ok(size_t index) const { return m_ok[index].load(std::memory_order_relaxed); }
+        uint64_t errors(size_t index) const { return m_errors[index].load(std::memory_order_relaxed); }
+
+        Clock::time_point windowStart(size_t index) const { return m_start + kWindow * index; }
+
+    private:
+        const Clock::time_point m_start;
+        const size_t m_windowCount;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_ok;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_errors;
+    };
+
+    /**
+     * @brief 一个阶段的统计
+     */
+    struct PhaseStats
+    {
+        uint64_t ok = 0;
+        uint64_t errors = 0;
+        double seconds = 0;
+        PoolMetrics::HistogramSnapshot latency;     // 每次操作的延迟（微秒），包括借出连接
+
+        double opsPerSecond() const { return seconds > 0 ? ok / seconds : 0; }
+        double errorRate() const { return ok + errors > 0 ? static_cast<double>(errors) / (ok + errors) : 0; }
+    };
+
+    struct ScenarioResult
+    {
+        std::string name;
+        std::string description;
+        PhaseStats baseline;
+        PhaseStats fault;
+        PhaseStats recovery;
+        double timeToRecoverMs = -1;
+        std::map<unsigned int, uint64_t> faultErrors;   // 故障和恢复阶段的mysql_errno分布
+        uint64_t reconnects = 0;
+        uint64_t connectFailures = 0;
+        uint64_t acquireTimeouts = 0;
+        uint64_t injectedFaults = 0;
+    };
+
+    enum Phase
+    {
+        BASELINE = 0,
+        FAULT,
+        RECOVERY,
+        PHASE_COUNT
+    };
+
+    /**
+     * @brief 在[from, to)分段中统计
+     */
+    void summarize(const Timeline &timeline, size_t from, size_t to, PhaseStats &stats)
+    {
+        for (size_t i = from; i < to; ++i)
+        {
+            stats.ok += timeline.ok(i);
+            stats.errors += timeline.errors(i);
+        }
+        stats.seconds = std::chrono::duration<double>(kWindow * (to - from)).count();
+    }
+
+    ScenarioResult runScenario(const Scenario &scenario, const Options &options)
+    {
+        ScenarioResult result;
+        result.name = scenario.name;
+        result.description = scenario.description;
+
+        std::vector<std::unique_ptr<FakeMySQLServer>> servers;
+        PoolConfig config;
+        for (int i = 0; i < kInstanceCount; ++i)
+        {
+            servers.emplace_back(new FakeMySQLServer());
+            servers.back()->start();
+            config.addDatabase(DBConfig("127.0.0.1", "bench", "bench", "testdb", servers.back()->port()));
+        }
+        config.setConnectionLimits(kPoolSize, kPoolSize, kPoolSize);
+        config.setTimeouts(1000, 300000, 30000);
+        ConnectionPool pool(config);
+
+        // 各阶段的延迟直方图，复用连接池的PoolMetrics
+        PoolMetrics phaseMetrics[PHASE_COUNT];
+        std::atomic<int> phase{BASELINE};
+        std::atomic<bool> stop{false};
+
+        size_t windowCount = static_cast<size_t>((options.baselineMs + options.faultMs + options.recoveryMs) / kWindow.count() + 16);
+        Clock::time_point start = Clock::now();
+        Timeline timeline(start, windowCount);
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < options.threads; ++t)
+        {
+            workers.emplace_back([&] {
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    Clock::time_point begin = Clock::now();
+                    bool ok = false;
+                    try
+                    {
+                        ConnectionPtr conn = pool.getConnection();
+                        if (conn)
+                        {
+                            conn->executeQuery("SELECT 1");
+                            ok = true;
+                        }
+                    }
+                    catch (const std::exception &)
+                    {
+                        // 错误码由连接池的PoolMetrics统计
+                    }
+                    Clock::time_point end = Clock::now();
+                    timeline.record(end, ok);
+                    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+                    phaseMetrics[phase.load(std::memory_order_relaxed)].record(PoolMetrics::QUERY, micros);
+                }
+            });
+        }
+
+        // 基线
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.baselineMs));
+        PoolMetrics::Snapshot before = pool.getMetrics()->snapshot();
+        Clock::time_point faultStart = Clock::now();
+        phase = FAULT;
+        scenario.inject(servers);
+
+        // 故障
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.faultMs));
+        Clock::time_point faultEnd = Clock::now();
+        phase = RECOVERY;
+        scenario.clear(servers);
+
+        // 恢复：等待完整的分段，找到第一个连续kStableWindows个分段都正常的位置
+        size_t baselineFrom = 1;    // 第一个分段包含线程启动，不计入基线
+        size_t baselineTo = timeline.indexOf(faultStart);
+        PhaseStats baselineWindows;
+        summarize(timeline, baselineFrom, std::max(baselineTo, baselineFrom + 1), baselineWindows);
+        double baselinePerWindow = static_cast<double>(baselineWindows.ok) / std::max<size_t>(1, baselineTo - baselineFrom);
+
+        size_t recoveryFrom = timeline.indexOf(faultEnd);
+        size_t recoveredAt = 0;
+        bool recovered = false;
+        Clock::time_point deadline = faultEnd + std::chrono::milliseconds(options.recoveryMs);
+        while (!recovered && Clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(kWindow);
+            size_t completed = timeline.indexOf(Clock::now());  // 之前的分段都已经结束
+            for (size_t i = recoveryFrom; i + kStableWindows <= completed; ++i)
+            {
+                bool stable = true;
+                for (size_t k = i; k < i + kStableWindows && stable; ++k)
+                    stable = timeline.errors(k) == 0 && timeline.ok(k) >= baselinePerWindow * kRecoveredRatio;
+                if (stable)
+                {
+                    recovered = true;
+                    recoveredAt = i;
+                    break;
+                }
+            }
+        }
+        Clock::time_point recoveryEnd = Clock::now();
+        stop = true;
+        for (auto &worker : workers)
+            worker.join();
+        PoolMetrics::Snapshot after = pool.getMetrics()->snapshot();
+
+        // 故障开始和结束所在的分段同时包含两个阶段，按照分段归入后一个阶段
+        summarize(timeline, baselineFrom, baselineTo, result.baseline);
+        summarize(timeline, baselineTo, recoveryFrom, result.fault);
+        summarize(timeline, recoveryFrom, timeline.indexOf(recoveryEnd), result.recovery);
+        result.baseline.latency = phaseMetrics[BASELINE].snapshot().histograms[PoolMetrics::QUERY];
+        result.fault.latency = phaseMetrics[FAULT].snapshot().histograms[PoolMetrics::QUERY];
+        result.recovery.latency = phaseMetrics[RECOVERY].snapshot().histograms[PoolMetrics::QUERY];
+        if (recovered)
+        {
+            auto offset = timeline.windowStart(recoveredAt) - faultEnd;
+            result.timeToRecoverMs = std::max(0.0, std::chrono::duration<double, std::milli>(offset).count());
+        }
+
+        for (const auto &error : after.errors)
+        {
+            auto it = before.errors.find(error.first);
+            uint64_t previous = it == before.errors.end() ? 0 : it->second;
+            if (error.second > previous)
+                result.faultErrors[error.first] = error.second - previous;
+        }
+        result.reconnects = after.counters[PoolMetrics::RECONNECT] - before.counters[PoolMetrics::RECONNECT];
+        result.connectFailures = after.counters[PoolMetrics::CONNECT_FAILURE] - before.counters[PoolMetrics::CONNECT_FAILURE];
+        result.acquireTimeouts = after.counters[PoolMetrics::ACQUIRE_TIMEOUT] - before.counters[PoolMetrics::ACQUIRE_TIMEOUT];
+        for (auto &server : servers)
+            result.injectedFaults += server->getInjectedFaultCount();
+        return result;
+    }
+
+    // =============================
+    // 输出
+    // =============================
+
+    void writePhase(std::ostream &out, const char *name, const PhaseStats &stats, bool last)
+    {
+        out << "      \"" << name << "\": {\"ops_per_second\": " << stats.opsPerSecond()
+            << ", \"ok\": " << stats.ok << ", \"errors\": " << stats.errors
+            << ", \"error_rate\": " << stats.errorRate()
+            << ", \"p50_us\": " << stats.latency.p50 << ", \"p99_us\": " << stats.latency.p99
+            << ", \"max_us\": " << stats.latency.max << "}" << (last ? "\n" : ",\n");
+    }
+
+    void writeJson(std::ostream &out, const Options &options, const std::vector<ScenarioResult> &results)
+    {
+        char date[32] = "";
+        char host[256] = "";
+        std::time_t now = std::time(nullptr);
+        std::tm tm;
+        localtime_r(&now, &tm);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+        gethostname(host, sizeof(host) - 1);
+
+        out << std::setprecision(6);
+        out << "{\n  \"context\": {\n"
+            << "    \"date\": \"" << date << "\",\n"
+            << "    \"host_name\": \"" << host << "\",\n"
+            << "    \"executable\": \"bench_recovery\",\n"
+            << "    \"mysql_pool_version\": \"" << POOL_VERSION << "\",\n"
+            << "    \"threads\": " << options.threads << ",\n"
+            << "    \"instances\": " << kInstanceCount << ",\n"
+            << "    \"pool_size\": " << kPoolSize << ",\n"
+            << "    \"window_ms\": " << kWindow.count() << ",\n"
+            << "    \"baseline_ms\": " << options.baselineMs << ",\n"
+            << "    \"fault_ms\": " << options.faultMs << "\n"
+            << "  },\n  \"scenarios\": [";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const ScenarioResult &result = results[i];
+            out << (i > 0 ? "," : "") << "\n    {\n"
+                << "      \"name\": \"" << result.name << "\",\n"
+                << "      \"description\": \"" << result.description << "\",\n"
+                << "      \"time_to_recover_ms\": " << result.timeToRecoverMs << ",\n"
+                << "      \"injected_faults\": " << result.injectedFaults << ",\n"
+                << "      \"reconnects\": " << result.reconnects << ",\n"
+                << "      \"connect_failures\": " << result.connectFailures << ",\n"
+                << "      \"acquire_timeouts\": " << result.acquireTimeouts << ",\n"
+                << "      \"errors_by_errno\": {";
+            bool first = true;
+            for (const auto &error : result.faultErrors)
+            {
+                out << (first ? "" : ", ") << "\"" << error.first << "\": " << error.second;
+                first = false;
+            }
+            out << "},\n";
+            writePhase(out, "baseline", result.baseline, false);
+            writePhase(out, "fault", result.fault, false);
+            writePhase(out, "recovery", result.recovery, true);
+            out << "    }";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    void printSummary(const ScenarioResult &result)
+    {
+        std::cerr << std::left << std::setw(26) << result.name << std::right << std::fixed << std::setprecision(0)
+                  << " baseline " << std::setw(8) << result.baseline.opsPerSecond() << " ops/s"
+                  << " | fault " << std::setw(8) << result.fault.opsPerSecond() << " ops/s, errors "
+                  << std::setprecision(2) << result.fault.errorRate() * 100 << "%, p99 " << result.fault.latency.p99 << "us"
+                  << " | recover " << std::setprecision(0) << result.timeToRecoverMs << "ms" << std::endl;
+    }
+
+    bool parseFlag(const std::string &arg, const std::string &prefix, std::string &value)
+    {
+        if (arg.compare(0, prefix.size(), prefix) != 0)
+            return false;
+        value = arg.substr(prefix.size());
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseFlag(arg, "--scenario=", options.scenario) || parseFlag(arg, "--out=", options.outFile))
+            continue;
+        if (parseFlag(arg, "--threads=", value))
+            options.threads = std::max(1, std::atoi(value.c_str()));
+        else if (parseFlag(arg, "--baseline_ms=", value))
+            options.baselineMs = std::max(200, std::atoi(value.c_str()));
+        else if (parseFlag(arg, "--fault_ms=", value))
+            options.faultMs = std::max(100, std::atoi(value.c_str()));
+        else if (parseFlag(arg, "--recovery_ms=", value))
+            options.recoveryMs = std::max(200, std::atoi(value.c_str()));
+        else
+            std::cerr << "忽略未知的参数：" << arg << std::endl;
+    }
+
+    // Logger::init在标准输出打印一行提示，转到标准错误，避免混入JSON结果
+    std::streambuf *stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    Logger::getInstance().init("./bench_recovery.log", LogLevel::WARNING, false);
+    std::cout.rdbuf(stdoutBuffer);
+
+    std::vector<ScenarioResult> results;
+    for (const Scenario &scenario : makeScenarios())
+    {
+        if (!options.scenario.empty() && options.scenario != scenario.name)
+            continue;
+        results.push_back(runScenario(scenario, options));
+        printSummary(results.back());
+    }
+
+    writeJson(std::cout, options, results);
+    if (!options.outFile.empty())
+    {
+        std::ofstream out(options.outFile);
+        if (!out)
+        {
+            std::cerr << "无法写入结果文件：" << options.outFile << std::endl;
+            return 1;
+        }
+        writeJson(out, options, results);
+    }
+    return 0;
+}
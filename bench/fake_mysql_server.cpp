@@ -0,0 +1,1085 @@
+#include "fake_mysql_server.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <random>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * @brief MySQL协议模拟服务器的实现，协议格式见MySQL源码文档的Client/Server Protocol部分
+ */
+
+namespace
+{
+    // 能力标志
+    const uint32_t CLIENT_LONG_PASSWORD = 1u << 0;
+    const uint32_t CLIENT_FOUND_ROWS = 1u << 1;
+    const uint32_t CLIENT_LONG_FLAG = 1u << 2;
+    const uint32_t CLIENT_CONNECT_WITH_DB = 1u << 3;
+    const uint32_t CLIENT_LOCAL_FILES = 1u << 7;
+    const uint32_t CLIENT_PROTOCOL_41 = 1u << 9;
+    const uint32_t CLIENT_TRANSACTIONS = 1u << 13;
+    const uint32_t CLIENT_SECURE_CONNECTION = 1u << 15;
+    const uint32_t CLIENT_MULTI_RESULTS = 1u << 17;
+    const uint32_t CLIENT_PS_MULTI_RESULTS = 1u << 18;
+    const uint32_t CLIENT_PLUGIN_AUTH = 1u << 19;
+    const uint32_t CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA = 1u << 21;
+
+    // 不声明CLIENT_SSL、CLIENT_DEPRECATE_EOF、CLIENT_QUERY_ATTRIBUTES，客户端使用最简单的格式
+    const uint32_t kServerCapabilities = CLIENT_LONG_PASSWORD | CLIENT_FOUND_ROWS | CLIENT_LONG_FLAG |
+                                         CLIENT_CONNECT_WITH_DB | CLIENT_LOCAL_FILES | CLIENT_PROTOCOL_41 |
+                                         CLIENT_TRANSACTIONS | CLIENT_SECURE_CONNECTION | CLIENT_MULTI_RESULTS |
+                                         CLIENT_PS_MULTI_RESULTS | CLIENT_PLUGIN_AUTH |
+                                         CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA;
+
+    // 命令
+    const uint8_t COM_QUIT = 0x01;
+    const uint8_t COM_INIT_DB = 0x02;
+    const uint8_t COM_QUERY = 0x03;
+    const uint8_t COM_STATISTICS = 0x09;
+    const uint8_t COM_PING = 0x0e;
+    const uint8_t COM_CHANGE_USER = 0x11;
+    const uint8_t COM_STMT_PREPARE = 0x16;
+    const uint8_t COM_STMT_EXECUTE = 0x17;
+    const uint8_t COM_STMT_SEND_LONG_DATA = 0x18;
+    const uint8_t COM_STMT_CLOSE = 0x19;
+    const uint8_t COM_STMT_RESET = 0x1a;
+    const uint8_t COM_SET_OPTION = 0x1b;
+    const uint8_t COM_RESET_CONNECTION = 0x1f;
+
+    // 列类型和标志
+    const uint8_t MYSQL_TYPE_DOUBLE = 5;
+    const uint8_t MYSQL_TYPE_LONGLONG = 8;
+    const uint8_t MYSQL_TYPE_VAR_STRING = 253;
+    const uint16_t BINARY_FLAG = 128;
+    const uint16_t NUM_FLAG = 32768;
+
+    const uint16_t SERVER_STATUS_AUTOCOMMIT = 0x0002;
+    const uint8_t kCharsetUtf8mb4 = 45;     // utf8mb4_general_ci，5.7和8.0的客户端都认识
+    const uint8_t kCharsetBinary = 63;
+    const size_t kMaxPacketPayload = 0xffffff;
+    const char *kServerVersion = "8.0.36-fake";
+    const char *kAuthPlugin = "caching_sha2_password";
+
+    const unsigned int ER_UNKNOWN_COM_ERROR = 1047;
+    const unsigned int ER_LOCK_DEADLOCK = 1213;
+    const unsigned int ER_UNKNOWN_STMT_HANDLER = 1243;
+
+    /**
+     * @brief 构造一个包的负载
+     */
+    class PacketWriter
+    {
+    public:
+        PacketWriter &u8(uint8_t value)
+        {
+            m_data.push_back(static_cast<char>(value));
+            return *this;
+        }
+        PacketWriter &u16(uint16_t value) { return u8(value & 0xff).u8(value >> 8); }
+        PacketWriter &u32(uint32_t value) { return u16(value & 0xffff).u16(value >> 16); }
+
+        /**
+         * @brief 长度编码的整数
+         */
+        PacketWriter &lenenc(uint64_t value)
+        {
+            if (value < 251)
+                return u8(static_cast<uint8_t>(value));
+            if (value < (1u << 16))
+                return u8(0xfc).u16(static_cast<uint16_t>(value));
+            if (value < (1u << 24))
+                return u8(0xfd).u16(value & 0xffff).u8(static_cast<uint8_t>(value >> 16));
+            u8(0xfe);
+            for (int i = 0; i < 8; ++i)
+                u8(static_cast<uint8_t>(value >> (8 * i)));
+            return *this;
+        }
+
+        PacketWriter &bytes(const std::string &value)
+        {
+            m_data += value;
+            return *this;
+        }
+        PacketWriter &zeros(size_t count)
+        {
+            m_data.append(count, '\0');
+            return *this;
+        }
+        PacketWriter &nulString(const std::string &value) { return bytes(value).u8(0); }
+        PacketWriter &lenencString(const std::string &value) { return lenenc(value.size()).bytes(value); }
+
+        const std::string &data() const { return m_data; }
+
+    private:
+        std::string m_data;
+    };
+
+    /**
+     * @brief 读取包的负载
+     */
+    class PacketReader
+    {
+    public:
+        PacketReader(const std::string &data, size_t pos = 0) : m_data(data), m_pos(pos) {}
+
+        bool u8(uint8_t &value)
+        {
+            if (m_pos + 1 > m_data.size())
+                return false;
+            value = static_cast<uint8_t>(m_data[m_pos++]);
+            return true;
+        }
+
+        bool u32(uint32_t &value)
+        {
+            if (m_pos + 4 > m_data.size())
+                return false;
+            value = 0;
+            for (int i = 0; i < 4; ++i)
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(m_data[m_pos + i])) << (8 * i);
+            m_pos += 4;
+            return true;
+        }
+
+        bool lenenc(uint64_t &value)
+        {
+            uint8_t first;
+            if (!u8(first))
+                return false;
+            size_t width = first < 251 ? 0 : first == 0xfc ? 2 : first == 0xfd ? 3 : first == 0xfe ? 8 : 9;
+            if (width == 0)
+            {
+                value = first;
+                return true;
+            }
+            if (width == 9 || m_pos + width > m_data.size())
+                return false;
+            value = 0;
+            for (size_t i = 0; i < width; ++i)
+                value |= static_cast<uint64_t>(static_cast<uint8_t>(m_data[m_pos + i])) << (8 * i);
+            m_pos += width;
+            return true;
+        }
+
+        bool skip(size_t count)
+        {
+            if (m_pos + count > m_data.size())
+                return false;
+            m_pos += count;
+            return true;
+        }
+
+        bool fixedString(size_t length, std::string &value)
+        {
+            if (m_pos + length > m_data.size())
+                return false;
+            value = m_data.substr(m_pos, length);
+            m_pos += length;
+            return true;
+        }
+
+        bool nulString(std::string &value)
+        {
+            size_t end = m_data.find('\0', m_pos);
+            if (end == std::string::npos)
+                end = m_data.size();    // 最后一个字段可以没有结尾的0
+            value = m_data.substr(m_pos, end - m_pos);
+            m_pos = std::min(end + 1, m_data.size());
+            return true;
+        }
+
+        bool atEnd() const { return m_pos >= m_data.size(); }
+
+    private:
+        const std::string &m_data;
+        size_t m_pos;
+    };
+
+    bool writeAll(int fd, const char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t n = ::recv(fd, data, length, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 读取一个逻辑包，合并超过16MB被拆分的包
+     * @param sequence 最后一个物理包的序号
+     */
+    bool readPacket(int fd, std::string &payload, uint8_t &sequence)
+    {
+        payload.clear();
+        while (true)
+        {
+            unsigned char header[4];
+            if (!readAll(fd, reinterpret_cast<char *>(header), sizeof(header)))
+                return false;
+            size_t length = header[0] | (header[1] << 8) | (header[2] << 16);
+            sequence = header[3];
+            size_t offset = payload.size();
+            payload.resize(offset + length);
+            if (length > 0 && !readAll(fd, &payload[offset], length))
+                return false;
+            if (length < kMaxPacketPayload)
+                return true;
+        }
+    }
+
+    /**
+     * @brief 把一个逻辑包追加到输出缓冲区，超过16MB时拆分，sequence递增
+     * 一个响应的所有包先写入缓冲区，最后一次发送，结果集不会变成几千次系统调用
+     */
+    void appendPacket(std::string &out, const std::string &payload, uint8_t &sequence)
+    {
+        size_t offset = 0;
+        while (true)
+        {
+            size_t length = std::min(payload.size() - offset, kMaxPacketPayload);
+            out.push_back(static_cast<char>(length & 0xff));
+            out.push_back(static_cast<char>((length >> 8) & 0xff));
+            out.push_back(static_cast<char>((length >> 16) & 0xff));
+            out.push_back(static_cast<char>(sequence++));
+            out.append(payload, offset, length);
+            offset += length;
+            if (length < kMaxPacketPayload)
+                return;
+        }
+    }
+
+    std::string okPacket(uint64_t affectedRows = 0, uint64_t insertId = 0)
+    {
+        PacketWriter w;
+        w.u8(0x00).lenenc(affectedRows).lenenc(insertId).u16(SERVER_STATUS_AUTOCOMMIT).u16(0);
+        return w.data();
+    }
+
+    std::string eofPacket()
+    {
+        PacketWriter w;
+        w.u8(0xfe).u16(0).u16(SERVER_STATUS_AUTOCOMMIT);
+        return w.data();
+    }
+
+    std::string errorPacket(unsigned int code, const std::string &sqlState, const std::string &message)
+    {
+        PacketWriter w;
+        std::string state = sqlState;
+        state.resize(5, '0');
+        w.u8(0xff).u16(static_cast<uint16_t>(code)).u8('#').bytes(state).bytes(message);
+        return w.data();
+    }
+
+    bool isInteger(const std::string &value)
+    {
+        size_t i = !value.empty() && (value[0] == '-' || value[0] == '+') ? 1 : 0;
+        if (i >= value.size())
+            return false;
+        for (; i < value.size(); ++i)
+        {
+            if (!std::isdigit(static_cast<unsigned char>(value[i])))
+                return false;
+        }
+        return true;
+    }
+
+    bool isDecimal(const std::string &value)
+    {
+        char *end = nullptr;
+        std::strtod(value.c_str(), &end);
+        return !value.empty() && end == value.c_str() + value.size();
+    }
+
+    /**
+     * @brief 列的类型：由第一个非NULL值推断，预处理语句统一使用字符串类型
+     */
+    uint8_t columnType(const FakeMySQLServer::Response &response, size_t column, bool binaryProtocol)
+    {
+        if (binaryProtocol)
+            return MYSQL_TYPE_VAR_STRING;
+        for (const FakeMySQLServer::Row &row : response.rows)
+        {
+            if (column >= row.size() || row[column].isNull)
+                continue;
+            if (isInteger(row[column].value))
+                return MYSQL_TYPE_LONGLONG;
+            if (isDecimal(row[column].value))
+                return MYSQL_TYPE_DOUBLE;
+            return MYSQL_TYPE_VAR_STRING;
+        }
+        return MYSQL_TYPE_VAR_STRING;
+    }
+
+    std::string columnDefinition(const std::string &name, uint8_t type)
+    {
+        bool numeric = type != MYSQL_TYPE_VAR_STRING;
+        PacketWriter w;
+        w.lenencString("def").lenencString("").lenencString("").lenencString("")
+            .lenencString(name).lenencString(name)
+            .lenenc(0x0c)
+            .u16(numeric ? kCharsetBinary : kCharsetUtf8mb4)
+            .u32(numeric ? 20 : 1020)
+            .u8(type)
+            .u16(numeric ? (NUM_FLAG | BINARY_FLAG) : 0)
+            .u8(type == MYSQL_TYPE_DOUBLE ? 31 : 0)     // 31表示小数位数不固定
+            .u16(0);
+        return w.data();
+    }
+
+    /**
+     * @brief 列数、列定义和EOF
+     */
+    void appendColumns(std::string &out, const FakeMySQLServer::Response &response, bool binaryProtocol, uint8_t &sequence)
+    {
+        appendPacket(out, PacketWriter().lenenc(response.columns.size()).data(), sequence);
+        for (size_t c = 0; c < response.columns.size(); ++c)
+            appendPacket(out, columnDefinition(response.columns[c], columnType(response, c, binaryProtocol)), sequence);
+        appendPacket(out, eofPacket(), sequence);
+    }
+
+    void appendResultSet(std::string &out, const FakeMySQLServer::Response &response, bool binaryProtocol, uint8_t &sequence)
+    {
+        appendColumns(out, response, binaryProtocol, sequence);
+        size_t columnCount = response.columns.size();
+        for (const FakeMySQLServer::Row &row : response.rows)
+        {
+            PacketWriter w;
+            if (binaryProtocol)
+            {
+                // 二进制协议的行：0x00，NULL位图（从第2位开始），非NULL的值
+                std::string nullBitmap((columnCount + 7 + 2) / 8, '\0');
+                for (size_t c = 0; c < columnCount; ++c)
+                {
+                    if (c >= row.size() || row[c].isNull)
+                        nullBitmap[(c + 2) / 8] |= static_cast<char>(1 << ((c + 2) % 8));
+                }
+                w.u8(0x00).bytes(nullBitmap);
+                for (size_t c = 0; c < columnCount; ++c)
+                {
+                    if (c < row.size() && !row[c].isNull)
+                        w.lenencString(row[c].value);
+                }
+            }
+            else
+            {
+                // 文本协议的行：每个值是长度编码的字符串，NULL是0xfb
+                for (size_t c = 0; c < columnCount; ++c)
+                {
+                    if (c >= row.size() || row[c].isNull)
+                        w.u8(0xfb);
+                    else
+                        w.lenencString(row[c].value);
+                }
+            }
+            appendPacket(out, w.data(), sequence);
+        }
+        appendPacket(out, eofPacket(), sequence);
+    }
+
+    void appendResponse(std::string &out, const FakeMySQLServer::Response &response, bool binaryProtocol, uint8_t &sequence)
+    {
+        switch (response.kind)
+        {
+        case FakeMySQLServer::Response::RESULT_SET:
+            appendResultSet(out, response, binaryProtocol, sequence);
+            break;
+        case FakeMySQLServer::Response::ERROR:
+            appendPacket(out, errorPacket(response.errorCode, response.sqlState, response.errorMessage), sequence);
+            break;
+        default:
+            appendPacket(out, okPacket(response.affectedRows, response.insertId), sequence);
+            break;
+        }
+    }
+
+    /**
+     * @brief 跳过开头的空白和左括号之后，SQL是否以关键字开头（忽略大小写）
+     */
+    bool startsWithKeyword(const std::string &sql, const char *keyword)
+    {
+        size_t i = 0;
+        while (i < sql.size() && (std::isspace(static_cast<unsigned char>(sql[i])) || sql[i] == '('))
+            ++i;
+        size_t length = std::strlen(keyword);
+        if (sql.size() - i < length)
+            return false;
+        for (size_t k = 0; k < length; ++k)
+        {
+            if (std::toupper(static_cast<unsigned char>(sql[i + k])) != keyword[k])
+                return false;
+        }
+        return sql.size() - i == length || !std::isalnum(static_cast<unsigned char>(sql[i + length]));
+    }
+
+    /**
+     * @brief LOAD DATA LOCAL INFILE 'file' ...中的文件名，不是这种语句时返回false
+     */
+    bool parseLocalInfile(const std::string &sql, std::string &fileName)
+    {
+        static const std::regex pattern(R"(^\s*LOAD\s+DATA\s+(LOW_PRIORITY\s+|CONCURRENT\s+)?LOCAL\s+INFILE\s+'((?:[^'\\]|\\.)*)')",
+                                        std::regex::ECMAScript | std::regex::icase);
+        std::smatch match;
+        if (!std::regex_search(sql, match, pattern))
+            return false;
+        fileName = match[2].str();
+        return true;
+    }
+
+    /**
+     * @brief 以probability的概率返回true
+     */
+    bool roll(double probability)
+    {
+        if (probability <= 0)
+            return false;
+        static thread_local std::mt19937_64 rng{std::random_device{}()};
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < probability;
+    }
+
+    /**
+     * @brief 预处理语句的参数个数：引号和注释之外的?
+     */
+    uint16_t countParameters(const std::string &sql)
+    {
+        uint16_t count = 0;
+        char quote = 0;
+        for (size_t i = 0; i < sql.size(); ++i)
+        {
+            char c = sql[i];
+            if (quote)
+            {
+                if (c == '\\' && quote != '`')
+                    ++i;
+                else if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '\'' || c == '"' || c == '`')
+            {
+                quote = c;
+            }
+            else if (c == '?')
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+}
+
+/**
+ * @brief 一个客户端连接的状态，只由它的连接线程访问
+ */
+struct FakeMySQLServer::Session
+{
+    /**
+     * @brief 预处理语句
+     */
+    struct Statement
+    {
+        std::string sql;
+        uint16_t parameters;
+    };
+
+    int fd;
+    uint32_t connectionId;
+    std::string out;        // 待发送的响应
+    std::unordered_map<uint32_t, Statement> statements;
+    uint32_t nextStatementId = 1;
+
+    bool flush()
+    {
+        bool ok = writeAll(fd, out.data(), out.size());
+        out.clear();
+        return ok;
+    }
+};
+
+// =============================
+// Response
+// =============================
+
+FakeMySQLServer::Response FakeMySQLServer::Response::ok(uint64_t affectedRows, uint64_t insertId)
+{
+    Response response;
+    response.kind = OK;
+    response.affectedRows = affectedRows;
+    response.insertId = insertId;
+    return response;
+}
+
+FakeMySQLServer::Response FakeMySQLServer::Response::resultSet(std::vector<std::string> columns, std::vector<Row> rows)
+{
+    Response response;
+    response.kind = RESULT_SET;
+    response.columns = std::move(columns);
+    response.rows = std::move(rows);
+    return response;
+}
+
+FakeMySQLServer::Response FakeMySQLServer::Response::error(unsigned int errorCode, const std::string &message, const std::string &sqlState)
+{
+    Response response;
+    response.kind = ERROR;
+    response.errorCode = errorCode;
+    response.errorMessage = message;
+    response.sqlState = sqlState;
+    return response;
+}
+
+// =============================
+// 构造函数、启动和停止
+// =============================
+
+FakeMySQLServer::FakeMySQLServer(const std::string &address, unsigned short port)
+    : m_address(address)
+    , m_port(port)
+    , m_listenFd(-1)
+    , m_running(false)
+    , m_script(std::make_shared<Script>())
+    , m_commandLatency(0)
+    , m_faultsActive(false)
+    , m_sessionThreads(0)
+    , m_nextConnectionId(1)
+    , m_connectionCount(0)
+    , m_commandCount(0)
+    , m_injectedFaults(0)
+{
+}
+
+FakeMySQLServer::~FakeMySQLServer()
+{
+    stop();
+}
+
+void FakeMySQLServer::start()
+{
+    if (m_running)
+        return;
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error(std::string("FakeMySQLServer: socket failed: ") + std::strerror(errno));
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_port);
+    if (::inet_pton(AF_INET, m_address.c_str(), &addr.sin_addr) != 1)
+    {
+        ::close(fd);
+        throw std::runtime_error("FakeMySQLServer: invalid address " + m_address);
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 128) != 0)
+    {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("FakeMySQLServer: cannot listen on " + m_address + ":" + std::to_string(m_port) + ": " + error);
+    }
+    socklen_t length = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &length);
+    m_port = ntohs(addr.sin_port);
+
+    m_listenFd = fd;
+    m_running = true;
+    m_acceptThread = std::thread(&FakeMySQLServer::acceptLoop, this);
+}
+
+void FakeMySQLServer::stop()
+{
+    if (!m_running.exchange(false))
+        return;
+
+    // shutdown唤醒阻塞在accept和recv上的线程
+    ::shutdown(m_listenFd, SHUT_RDWR);
+    if (m_acceptThread.joinable())
+        m_acceptThread.join();
+    ::close(m_listenFd);
+    m_listenFd = -1;
+
+    std::unique_lock<std::mutex> lock(m_sessionMutex);
+    for (int fd : m_sessionFds)
+        ::shutdown(fd, SHUT_RDWR);
+    m_sessionsDone.wait(lock, [this] { return m_sessionThreads == 0; });
+}
+
+size_t FakeMySQLServer::getActiveSessionCount() const
+{
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    return m_sessionFds.size();
+}
+
+void FakeMySQLServer::acceptLoop()
+{
+    while (m_running)
+    {
+        int fd = ::accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;      // stop()关闭了监听socket
+        }
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        m_connectionCount.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(m_sessionMutex);
+            if (!m_running)
+            {
+                ::close(fd);
+                break;
+            }
+            m_sessionFds.insert(fd);
+            ++m_sessionThreads;
+        }
+        uint32_t connectionId = m_nextConnectionId.fetch_add(1, std::memory_order_relaxed);
+        // 连接线程退出时自己清理，stop()等待所有连接线程退出
+        std::thread(&FakeMySQLServer::serve, this, fd, connectionId).detach();
+    }
+}
+
+void FakeMySQLServer::serve(int fd, uint32_t connectionId)
+{
+    Session session;
+    session.fd = fd;
+    session.connectionId = connectionId;
+
+    if (handshake(session))
+    {
+        std::string packet;
+        uint8_t sequence = 0;
+        while (m_running && readPacket(fd, packet, sequence))
+        {
+            m_commandCount.fetch_add(1, std::memory_order_relaxed);
+            if (!dispatch(session, packet, sequence))
+                break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    m_sessionFds.erase(fd);
+    ::close(fd);
+    if (--m_sessionThreads == 0)
+        m_sessionsDone.notify_all();
+}
+
+// =============================
+// 脚本
+// =============================
+
+std::shared_ptr<FakeMySQLServer::Script> FakeMySQLServer::copyScript() const
+{
+    std::lock_guard<std::mutex> lock(m_scriptMutex);
+    return std::make_shared<Script>(*m_script);
+}
+
+void FakeMySQLServer::addResponse(const std::string &sql, Response response)
+{
+    std::shared_ptr<Script> script = copyScript();
+    script->exact[sql] = std::make_shared<const Response>(std::move(response));
+    std::lock_guard<std::mutex> lock(m_scriptMutex);
+    m_script = script;
+}
+
+void FakeMySQLServer::addPatternResponse(const std::string &pattern, Response response)
+{
+    std::regex regex(pattern, std::regex::ECMAScript | std::regex::icase);
+    std::shared_ptr<Script> script = copyScript();
+    script->patterns.emplace_back(std::move(regex), std::make_shared<const Response>(std::move(response)));
+    std::lock_guard<std::mutex> lock(m_scriptMutex);
+    m_script = script;
+}
+
+void FakeMySQLServer::clearResponses()
+{
+    std::lock_guard<std::mutex> lock(m_scriptMutex);
+    m_script = std::make_shared<Script>();
+}
+
+void FakeMySQLServer::setDefaultHandler(Handler handler)
+{
+    std::shared_ptr<Script> script = copyScript();
+    script->handler = std::move(handler);
+    std::lock_guard<std::mutex> lock(m_scriptMutex);
+    m_script = script;
+}
+
+FakeMySQLServer::ResponsePtr FakeMySQLServer::resolve(const std::string &sql) const
+{
+    ScriptPtr script;
+    {
+        std::lock_guard<std::mutex> lock(m_scriptMutex);
+        script = m_script;
+    }
+
+    ResponsePtr response;
+    auto it = script->exact.find(sql);
+    if (it != script->exact.end())
+    {
+        response = it->second;
+    }
+    else
+    {
+        for (const auto &pattern : script->patterns)
+        {
+            if (std::regex_search(sql, pattern.first))
+            {
+                response = pattern.second;
+                break;
+            }
+        }
+    }
+    if (!response && script->handler)
+        response = std::make_shared<const Response>(script->handler(sql));
+    if (!response)
+    {
+        static const ResponsePtr selectOne = std::make_shared<const Response>(Response::resultSet({"1"}, {{"1"}}));
+        static const ResponsePtr ok = std::make_shared<const Response>(Response::ok());
+        response = startsWithKeyword(sql, "SELECT") ? selectOne : ok;
+    }
+    if (response->latency.count() > 0)
+        std::this_thread::sleep_for(response->latency);
+    return response;
+}
+
+void FakeMySQLServer::sleepCommandLatency() const
+{
+    int64_t latency = m_commandLatency.load(std::memory_order_relaxed);
+    if (latency > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(latency));
+}
+
+// =============================
+// 故障注入
+// =============================
+
+void FakeMySQLServer::setFaults(const Faults &faults)
+{
+    std::lock_guard<std::mutex> lock(m_faultMutex);
+    m_faults = faults;
+    m_faultsActive.store(faults.any(), std::memory_order_release);
+}
+
+FakeMySQLServer::Faults FakeMySQLServer::getFaults() const
+{
+    std::lock_guard<std::mutex> lock(m_faultMutex);
+    return m_faults;
+}
+
+void FakeMySQLServer::disconnectAll()
+{
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    for (int fd : m_sessionFds)
+        ::shutdown(fd, SHUT_RDWR);
+}
+
+void FakeMySQLServer::waitWhileBlackhole() const
+{
+    while (m_running && m_faultsActive.load(std::memory_order_acquire) && getFaults().blackhole)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+bool FakeMySQLServer::injectQueryFault(Session &session, uint8_t sequence, bool canDeadlock, bool &closeSession)
+{
+    closeSession = false;
+    if (!m_faultsActive.load(std::memory_order_acquire))
+        return false;
+    Faults faults = getFaults();
+    if (roll(faults.dropRate))
+    {
+        m_injectedFaults.fetch_add(1, std::memory_order_relaxed);
+        closeSession = true;
+        return true;
+    }
+    if (canDeadlock && roll(faults.deadlockRate))
+    {
+        m_injectedFaults.fetch_add(1, std::memory_order_relaxed);
+        appendPacket(session.out, errorPacket(ER_LOCK_DEADLOCK, "40001", "Deadlock found when trying to get lock; try restarting transaction"),
+                     sequence);
+        return true;
+    }
+    return false;
+}
+
+// =============================
+// 握手
+// =============================
+
+bool FakeMySQLServer::handshake(Session &session)
+{
+    if (m_faultsActive.load(std::memory_order_acquire))
+    {
+        waitWhileBlackhole();
+        std::chrono::microseconds delay = getFaults().handshakeDelay;
+        if (delay.count() > 0)
+            std::this_thread::sleep_for(delay);
+    }
+
+    // 认证数据：20个可打印字符，真实服务器同样避免0和'$'
+    static thread_local std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string scramble(20, 'a');
+    for (char &c : scramble)
+        c = static_cast<char>(letter(rng));
+
+    PacketWriter greeting;
+    greeting.u8(10)
+        .nulString(kServerVersion)
+        .u32(session.connectionId)
+        .bytes(scramble.substr(0, 8))
+        .u8(0)
+        .u16(kServerCapabilities & 0xffff)
+        .u8(kCharsetUtf8mb4)
+        .u16(SERVER_STATUS_AUTOCOMMIT)
+        .u16(kServerCapabilities >> 16)
+        .u8(static_cast<uint8_t>(scramble.size() + 1))
+        .zeros(10)
+        .bytes(scramble.substr(8))
+        .u8(0)
+        .nulString(kAuthPlugin);
+    uint8_t sequence = 0;
+    appendPacket(session.out, greeting.data(), sequence);
+    if (!session.flush())
+        return false;
+
+    // HandshakeResponse41
+    std::string packet;
+    if (!readPacket(session.fd, packet, sequence))
+        return false;
+    PacketReader reader(packet);
+    uint32_t capabilities = 0;
+    std::string user, authResponse, database, plugin;
+    bool parsed = reader.u32(capabilities) && (capabilities & CLIENT_PROTOCOL_41) && reader.skip(4 + 1 + 23) &&
+                  reader.nulString(user);
+    if (parsed)
+    {
+        uint64_t authLength = 0;
+        if (capabilities & CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA)
+        {
+            parsed = reader.lenenc(authLength) && reader.fixedString(static_cast<size_t>(authLength), authResponse);
+        }
+        else
+        {
+            uint8_t length = 0;
+            parsed = reader.u8(length) && reader.fixedString(length, authResponse);
+        }
+    }
+    if (parsed && (capabilities & CLIENT_CONNECT_WITH_DB) && !reader.atEnd())
+        reader.nulString(database);
+    if (parsed && (capabilities & CLIENT_PLUGIN_AUTH) && !reader.atEnd())
+        reader.nulString(plugin);
+    ++sequence;
+    if (!parsed)
+    {
+        appendPacket(session.out, errorPacket(1043, "08S01", "Bad handshake"), sequence);
+        session.flush();
+        return false;
+    }
+
+    // 不校验密码：caching_sha2_password回复快速认证成功（0x01 0x03），空密码和其他插件直接OK
+    bool emptyPassword = authResponse.empty() || authResponse == std::string(1, '\0');
+    if (plugin == kAuthPlugin && !emptyPassword)
+        appendPacket(session.out, std::string("\x01\x03", 2), sequence);
+    appendPacket(session.out, okPacket(), sequence);
+    return session.flush();
+}
+
+// =============================
+// 命令
+// =============================
+
+bool FakeMySQLServer::dispatch(Session &session, const std::string &packet, uint8_t sequence)
+{
+    if (packet.empty())
+        return false;
+    uint8_t command = static_cast<uint8_t>(packet[0]);
+    ++sequence;
+    if (m_faultsActive.load(std::memory_order_acquire))
+        waitWhileBlackhole();
+
+    // 没有响应的命令
+    switch (command)
+    {
+    case COM_QUIT:
+        return false;
+    case COM_STMT_CLOSE:
+    {
+        uint32_t statementId = 0;
+        PacketReader reader(packet, 1);
+        if (reader.u32(statementId))
+            session.statements.erase(statementId);
+        return true;
+    }
+    case COM_STMT_SEND_LONG_DATA:
+        return true;
+    default:
+        break;
+    }
+
+    sleepCommandLatency();
+    if (command == COM_QUERY || command == COM_STMT_EXECUTE)
+    {
+        // SET NAMES等会话设置不会发生死锁，否则客户端在建立连接时就会失败
+        bool canDeadlock = command == COM_STMT_EXECUTE || !startsWithKeyword(packet.substr(1), "SET");
+        bool closeSession = false;
+        if (injectQueryFault(session, sequence, canDeadlock, closeSession))
+            return !closeSession && session.flush();
+    }
+    switch (command)
+    {
+    case COM_QUERY:
+        handleQuery(session, packet.substr(1), sequence);
+        break;
+    case COM_STMT_PREPARE:
+        handlePrepare(session, packet.substr(1), sequence);
+        break;
+    case COM_STMT_EXECUTE:
+        handleExecute(session, packet, sequence);
+        break;
+    case COM_RESET_CONNECTION:
+        session.statements.clear();
+        appendPacket(session.out, okPacket(), sequence);
+        break;
+    case COM_INIT_DB:
+    case COM_PING:
+    case COM_CHANGE_USER:
+    case COM_STMT_RESET:
+        appendPacket(session.out, okPacket(), sequence);
+        break;
+    case COM_SET_OPTION:
+        appendPacket(session.out, eofPacket(), sequence);
+        break;
+    case COM_STATISTICS:
+    {
+        std::string stats = "Uptime: 1  Threads: " + std::to_string(getActiveSessionCount()) +
+                            "  Questions: " + std::to_string(getCommandCount());
+        appendPacket(session.out, stats, sequence);
+        break;
+    }
+    default:
+        appendPacket(session.out, errorPacket(ER_UNKNOWN_COM_ERROR, "08S01", "Unknown command"), sequence);
+        break;
+    }
+    return session.flush();
+}
+
+void FakeMySQLServer::handleQuery(Session &session, const std::string &sql, uint8_t sequence)
+{
+    std::string fileName;
+    if (parseLocalInfile(sql, fileName))
+    {
+        handleLocalInfile(session, fileName, sequence);
+        return;
+    }
+    ResponsePtr response = resolve(sql);
+    appendResponse(session.out, *response, false, sequence);
+}
+
+void FakeMySQLServer::handleLocalInfile(Session &session, const std::string &fileName, uint8_t sequence)
+{
+    // 请求客户端发送文件内容，之后客户端发送若干个数据包，以一个空包结束
+    appendPacket(session.out, PacketWriter().u8(0xfb).bytes(fileName).data(), sequence);
+    if (!session.flush())
+        return;
+
+    uint64_t lines = 0;
+    char last = '\n';
+    std::string packet;
+    while (true)
+    {
+        if (!readPacket(session.fd, packet, sequence))
+            return;
+        if (packet.empty())
+            break;
+        for (char c : packet)
+        {
+            if (c == '\n')
+                ++lines;
+        }
+        last = packet.back();
+    }
+    if (last != '\n')
+        ++lines;    // 最后一行没有换行符
+    ++sequence;
+    appendPacket(session.out, okPacket(lines), sequence);
+}
+
+void FakeMySQLServer::handlePrepare(Session &session, const std::string &sql, uint8_t sequence)
+{
+    ResponsePtr response = resolve(sql);
+    if (response->kind == Response::ERROR)
+    {
+        appendResponse(session.out, *response, true, sequence);
+        return;
+    }
+
+    Session::Statement statement{sql, countParameters(sql)};
+    uint32_t statementId = session.nextStatementId++;
+    session.statements[statementId] = statement;
+    uint16_t columns = response->kind == Response::RESULT_SET ? static_cast<uint16_t>(response->columns.size()) : 0;
+
+    PacketWriter ok;
+    ok.u8(0x00).u32(statementId).u16(columns).u16(statement.parameters).u8(0).u16(0);
+    appendPacket(session.out, ok.data(), sequence);
+    if (statement.parameters > 0)
+    {
+        for (uint16_t p = 0; p < statement.parameters; ++p)
+            appendPacket(session.out, columnDefinition("?", MYSQL_TYPE_VAR_STRING), sequence);
+        appendPacket(session.out, eofPacket(), sequence);
+    }
+    if (columns > 0)
+    {
+        for (const std::string &name : response->columns)
+            appendPacket(session.out, columnDefinition(name, MYSQL_TYPE_VAR_STRING), sequence);
+        appendPacket(session.out, eofPacket(), sequence);
+    }
+}
+
+void FakeMySQLServer::handleExecute(Session &session, const std::string &packet, uint8_t sequence)
+{
+    // 参数的值不影响响应，只需要语句编号
+    uint32_t statementId = 0;
+    PacketReader reader(packet, 1);
+    auto it = reader.u32(statementId) ? session.statements.find(statementId) : session.statements.end();
+    if (it == session.statements.end())
+    {
+        appendPacket(session.out, errorPacket(ER_UNKNOWN_STMT_HANDLER, "HY000",
+                                              "Unknown prepared statement handler (" + std::to_string(statementId) + ") given to mysqld_stmt_execute"),
+                     sequence);
+        return;
+    }
+    ResponsePtr response = resolve(it->second.sql);
+    appendResponse(session.out, *response, true, sequence);
+}
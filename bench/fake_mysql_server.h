@@ -0,0 +1,274 @@
+/**
+ * @brief 实现进程内的MySQL协议模拟服务器，用于不依赖真实MySQL的基准测试
+ */
+#ifndef FAKE_MYSQL_SERVER_H
+#define FAKE_MYSQL_SERVER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <regex>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief 说MySQL协议的模拟服务器，libmysqlclient可以直接连接它
+ *
+ * 实现了连接池用到的协议子集：
+ * 1）握手：HandshakeV10 + HandshakeResponse41，不校验用户名和密码；
+ *    caching_sha2_password走快速认证路径，mysql_native_password直接通过；不支持SSL，客户端需要允许非加密连接
+ * 2）命令：COM_QUERY、COM_PING、COM_INIT_DB、COM_RESET_CONNECTION、COM_CHANGE_USER、COM_STATISTICS、COM_SET_OPTION、COM_QUIT，
+ *    预处理语句COM_STMT_PREPARE/EXECUTE/CLOSE/RESET/SEND_LONG_DATA
+ * 3）结果集：COM_QUERY返回文本协议的结果集；预处理语句返回二进制协议的结果集，所有列都以字符串类型返回，由客户端转换
+ * 4）LOAD DATA LOCAL INFILE：接收客户端发送的文件内容，affected rows是文件的行数，用于BulkLoader的基准测试
+ *
+ * 响应是脚本化的，查找顺序：完全相同的SQL -> 按照添加顺序匹配正则表达式 -> 默认处理函数；
+ * 都没有设置时，SELECT返回一行一列的"1"，其他语句返回OK
+ *
+ * 延迟注入：setCommandLatency对每个需要响应的命令生效，模拟网络往返；Response::latency只对匹配的SQL生效，模拟执行时间
+ *
+ * 故障注入（setFaults）：查询中途断开连接、握手延迟、返回ER_LOCK_DEADLOCK、黑洞（不响应任何数据），
+ * 一个DBConfig实例对应一个服务器，只对其中一个设置故障就是单个实例的故障；disconnectAll模拟服务器重启
+ *
+ * 每个客户端连接一个线程，阻塞式读写，适合几十到几百个连接的测试
+ *
+ * 使用示例：
+ * FakeMySQLServer server;
+ * server.addResponse("SELECT id, name FROM users",
+ *                    FakeMySQLServer::Response::resultSet({"id", "name"}, {{"1", "alice"}, {"2", nullptr}}));
+ * server.addPatternResponse("^UPDATE ", FakeMySQLServer::Response::ok(1).withLatency(std::chrono::microseconds(500)));
+ * server.setCommandLatency(std::chrono::microseconds(100));
+ * server.start();
+ * Connection conn("127.0.0.1", "user", "password", "testdb", server.port());
+ */
+class FakeMySQLServer
+{
+public:
+    /**
+     * @brief 结果集中的一个值，nullptr表示NULL
+     */
+    struct Cell
+    {
+        Cell(const char *value) : value(value) {}
+        Cell(std::string value) : value(std::move(value)) {}
+        Cell(std::nullptr_t) : isNull(true) {}
+
+        std::string value;
+        bool isNull = false;
+    };
+    using Row = std::vector<Cell>;
+
+    /**
+     * @brief 一个SQL的响应
+     */
+    struct Response
+    {
+        enum Kind
+        {
+            OK = 0,         // OK包，带affectedRows和insertId
+            RESULT_SET,     // 结果集
+            ERROR           // ERR包
+        };
+
+        Kind kind = OK;
+        std::vector<std::string> columns;   // 列名，列的类型由第一个非NULL值推断：整数、小数或者字符串
+        std::vector<Row> rows;
+        uint64_t affectedRows = 0;
+        uint64_t insertId = 0;
+        unsigned int errorCode = 0;         // mysql_errno
+        std::string sqlState = "HY000";
+        std::string errorMessage;
+        std::chrono::microseconds latency{0};   // 在命令延迟之外，这个SQL额外的执行时间
+
+        static Response ok(uint64_t affectedRows = 0, uint64_t insertId = 0);
+        static Response resultSet(std::vector<std::string> columns, std::vector<Row> rows);
+        static Response error(unsigned int errorCode, const std::string &message, const std::string &sqlState = "HY000");
+
+        /**
+         * @brief 设置执行时间，用于链式调用
+         */
+        Response &withLatency(std::chrono::microseconds value)
+        {
+            latency = value;
+            return *this;
+        }
+    };
+    using ResponsePtr = std::shared_ptr<const Response>;
+
+    /**
+     * @brief 注入的故障，dropRate和deadlockRate只对COM_QUERY和COM_STMT_EXECUTE生效，SET语句不会返回死锁
+     */
+    struct Faults
+    {
+        double dropRate = 0;        // 收到查询之后不响应、直接断开连接的概率，客户端得到CR_SERVER_LOST
+        double deadlockRate = 0;    // 返回ER_LOCK_DEADLOCK（1213，SQLSTATE 40001）的概率
+        std::chrono::microseconds handshakeDelay{0};    // 新连接发送握手包之前等待的时间
+        bool blackhole = false;     // 黑洞：新连接不发送握手包，已有连接不响应命令，直到故障解除；数据不会丢失，只是延迟
+
+        bool any() const { return dropRate > 0 || deadlockRate > 0 || handshakeDelay.count() > 0 || blackhole; }
+    };
+
+    /**
+     * @brief 默认处理函数，没有匹配的脚本时调用，可以在任意连接线程中并发调用
+     */
+    using Handler = std::function<Response(const std::string &sql)>;
+
+    /**
+     * @param address 监听地址，libmysqlclient把"localhost"当作unix socket，客户端需要使用"127.0.0.1"
+     * @param port 监听端口，0表示由系统分配，start之后通过port()得到
+     */
+    explicit FakeMySQLServer(const std::string &address = "127.0.0.1", unsigned short port = 0);
+
+    /**
+     * @brief 析构时停止服务器，断开所有连接
+     */
+    ~FakeMySQLServer();
+
+    FakeMySQLServer(const FakeMySQLServer &) = delete;
+    FakeMySQLServer &operator=(const FakeMySQLServer &) = delete;
+
+    /**
+     * @brief 开始监听，失败时抛出std::runtime_error
+     */
+    void start();
+
+    /**
+     * @brief 停止监听并断开所有连接，等待所有连接线程退出
+     */
+    void stop();
+
+    unsigned short port() const { return m_port; }
+
+    // =============================
+    // 脚本设置，可以在运行中修改，对之后的命令生效
+    // =============================
+
+    /**
+     * @brief SQL完全相同时返回response
+     */
+    void addResponse(const std::string &sql, Response response);
+
+    /**
+     * @brief SQL匹配正则表达式（ECMAScript语法，忽略大小写，regex_search）时返回response
+     */
+    void addPatternResponse(const std::string &pattern, Response response);
+
+    /**
+     * @brief 清除所有脚本和默认处理函数
+     */
+    void clearResponses();
+
+    void setDefaultHandler(Handler handler);
+
+    /**
+     * @brief 每个需要响应的命令在响应之前等待的时间
+     */
+    void setCommandLatency(std::chrono::microseconds latency) { m_commandLatency.store(latency.count(), std::memory_order_relaxed); }
+
+    // =============================
+    // 故障注入
+    // =============================
+
+    /**
+     * @brief 设置故障，对之后的命令和连接立即生效；Faults()清除所有故障
+     */
+    void setFaults(const Faults &faults);
+
+    Faults getFaults() const;
+
+    /**
+     * @brief 断开所有已经建立的连接，模拟服务器重启，监听不受影响
+     */
+    void disconnectAll();
+
+    // =============================
+    // 统计
+    // =============================
+
+    uint64_t getConnectionCount() const { return m_connectionCount.load(std::memory_order_relaxed); }  // 接受的连接总数
+    uint64_t getCommandCount() const { return m_commandCount.load(std::memory_order_relaxed); }        // 处理的命令总数
+    size_t getActiveSessionCount() const;   // 当前的连接数
+    uint64_t getInjectedFaultCount() const { return m_injectedFaults.load(std::memory_order_relaxed); }   // 断开和死锁的次数
+
+private:
+    /**
+     * @brief 脚本的快照，修改时整体替换，连接线程读取时只需要复制shared_ptr
+     */
+    struct Script
+    {
+        std::unordered_map<std::string, ResponsePtr> exact;
+        std::vector<std::pair<std::regex, ResponsePtr>> patterns;
+        Handler handler;
+    };
+    using ScriptPtr = std::shared_ptr<const Script>;
+
+    struct Session;
+
+    void acceptLoop();
+    void serve(int fd, uint32_t connectionId);
+    bool handshake(Session &session);
+    bool dispatch(Session &session, const std::string &packet, uint8_t sequence);
+    void handleQuery(Session &session, const std::string &sql, uint8_t sequence);
+    void handleLocalInfile(Session &session, const std::string &fileName, uint8_t sequence);
+    void handlePrepare(Session &session, const std::string &sql, uint8_t sequence);
+    void handleExecute(Session &session, const std::string &packet, uint8_t sequence);
+
+    /**
+     * @brief 查找SQL的响应，并等待它的执行时间
+     */
+    ResponsePtr resolve(const std::string &sql) const;
+
+    /**
+     * @brief 复制一份当前的脚本用于修改
+     */
+    std::shared_ptr<Script> copyScript() const;
+
+    void sleepCommandLatency() const;
+
+    /**
+     * @brief 黑洞故障期间阻塞，故障解除或者服务器停止时返回
+     */
+    void waitWhileBlackhole() const;
+
+    /**
+     * @brief 对一条查询注入故障
+     * @param canDeadlock 这条查询是否可能返回ER_LOCK_DEADLOCK
+     * @return true表示已经处理（断开时closeSession被设置为true），false表示正常执行
+     */
+    bool injectQueryFault(Session &session, uint8_t sequence, bool canDeadlock, bool &closeSession);
+
+private:
+    const std::string m_address;
+    unsigned short m_port;
+    int m_listenFd;
+    std::thread m_acceptThread;
+    std::atomic<bool> m_running;
+
+    mutable std::mutex m_scriptMutex;   // 保护m_script指针本身
+    ScriptPtr m_script;
+    std::atomic<int64_t> m_commandLatency;  // 微秒
+
+    mutable std::mutex m_faultMutex;    // 保护m_faults
+    Faults m_faults;
+    std::atomic<bool> m_faultsActive;   // 有没有故障，没有故障时命令的处理不需要加锁
+
+    mutable std::mutex m_sessionMutex;  // 保护以下成员
+    std::condition_variable m_sessionsDone;
+    std::unordered_set<int> m_sessionFds;   // 所有连接的socket，停止时关闭
+    size_t m_sessionThreads;            // 还没有退出的连接线程数
+
+    std::atomic<uint32_t> m_nextConnectionId;
+    std::atomic<uint64_t> m_connectionCount;
+    std::atomic<uint64_t> m_commandCount;
+    std::atomic<uint64_t> m_injectedFaults;
+};
+
+#endif  // FAKE_MYSQL_SERVER_H
@@ -0,0 +1,57 @@
+/**
+ * @brief 实现查询结果到Apache Arrow IPC流格式的导出
+ */
+#ifndef ARROW_EXPORT_H
+#define ARROW_EXPORT_H
+
+#include <string>
+#include "columnar_result.h"
+#include "query_result.h"
+
+/**
+ * @brief 不依赖Arrow库的Arrow IPC流格式编码器
+ *
+ * 输出的字节流是标准的Arrow IPC Streaming Format：
+ * Schema消息 -> 若干个RecordBatch消息 -> 结束标记
+ * Python端可以直接使用pyarrow.ipc.open_stream读取，不需要任何解析（可以直接内存映射）
+ *
+ * 类型映射（由MYSQL_FIELD的类型决定）：
+ * 1）整数类型 -> Int64（UNSIGNED BIGINT -> UInt64）
+ * 2）FLOAT/DOUBLE/DECIMAL -> Float64
+ * 3）binary字符集的字符串/BLOB -> Binary
+ * 4）其他类型 -> Utf8（保留MySQL返回的文本）
+ *
+ * 使用示例：
+ * std::string stream;
+ * ArrowExport::exportStream(*conn.executeQuery("SELECT * FROM users"), stream);
+ * // 把stream作为HTTP响应体发送，Content-Type: application/vnd.apache.arrow.stream
+ */
+namespace ArrowExport
+{
+    /**
+     * @brief 把整个查询结果导出为Arrow IPC流，追加到out的末尾
+     * @param result 查询结果，会从第一行开始读取
+     * @param out 输出缓冲区，可以复用
+     * @param batchRows 每个RecordBatch最多包含的行数
+     * @throws std::runtime_error 如果不是查询操作的结果
+     * @throws std::length_error 如果某一批中字符串列的总长度超过2GB（Arrow的Utf8类型使用int32偏移）
+     */
+    void exportStream(QueryResult &result, std::string &out, size_t batchRows = 65536);
+
+    /**
+     * @brief 写入Schema消息，流的第一个消息
+     */
+    void writeSchema(const ColumnarResult &columns, std::string &out);
+
+    /**
+     * @brief 写入一个RecordBatch消息，列的类型必须与Schema一致
+     */
+    void writeRecordBatch(const ColumnarResult &columns, std::string &out);
+
+    /**
+     * @brief 写入流的结束标记
+     */
+    void writeEndOfStream(std::string &out);
+}   // namespace ArrowExport
+
+#endif  // ARROW_EXPORT_H
@@ -0,0 +1,127 @@
+/**
+ * @brief 实现基于LOAD DATA LOCAL INFILE的内存批量导入
+ */
+#ifndef BULK_LOADER_H
+#define BULK_LOADER_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+
+/**
+ * @brief 批量导入时的行写入器
+ *
+ * LOAD DATA LOCAL INFILE需要的是文本格式的数据流：字段之间使用\t分隔，行之间使用\n分隔，
+ * 特殊字符使用\转义，NULL值写为\N
+ *
+ * 设计特点：
+ * 1）零临时文件：行数据直接格式化到mysqlclient提供的读缓冲区中，不经过磁盘
+ * 2）零额外分配：缓冲区放不下的部分才会溢出到一个可复用的std::string中，下次读取时优先输出
+ * 3）由连接在回调中创建，调用者只需要按列顺序调用addXxx即可
+ *
+ * 使用示例：
+ * conn.bulkLoad("test_users", {"name", "age", "email"}, [&](BulkRowWriter &row) {
+ *     if(i == users.size())
+ *         return false;   // 没有更多的行了
+ *     row.addString(users[i].name).addInt(users[i].age).addString(users[i].email);
+ *     ++i;
+ *     return true;
+ * });
+ */
+class BulkRowWriter
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param dst 目标缓冲区（mysqlclient的读缓冲区）
+     * @param capacity 目标缓冲区的容量
+     * @param overflow 目标缓冲区放不下时的溢出缓冲区
+     */
+    BulkRowWriter(char *dst, size_t capacity, std::string &overflow);
+
+    BulkRowWriter(const BulkRowWriter &) = delete;
+    BulkRowWriter &operator=(const BulkRowWriter &) = delete;
+
+    // =============================
+    // 字段写入方法，返回自身，方便链式调用
+    // =============================
+
+    /**
+     * @brief 写入字符串字段，会自动进行LOAD DATA格式的转义
+     */
+    BulkRowWriter &addString(const char *data, size_t length);
+    BulkRowWriter &addString(const std::string &value);
+
+    /**
+     * @brief 写入整数字段
+     */
+    BulkRowWriter &addInt(long long value);
+
+    /**
+     * @brief 写入浮点数字段，保留17位有效数字，保证往返转换不丢失精度
+     */
+    BulkRowWriter &addDouble(double value);
+
+    /**
+     * @brief 写入NULL字段
+     */
+    BulkRowWriter &addNull();
+
+    // =============================
+    // 由连接内部使用的方法
+    // =============================
+
+    /**
+     * @brief 开始新的一行，记录行首位置，便于放弃未完成的行
+     */
+    void beginRow();
+
+    /**
+     * @brief 结束当前行，写入行分隔符
+     */
+    void endRow();
+
+    /**
+     * @brief 放弃当前行已经写入的内容（行数据源返回false时调用）
+     */
+    void discardRow();
+
+    /**
+     * @brief 得到目标缓冲区已经写入的字节数
+     */
+    size_t written() const { return m_pos; }
+
+    /**
+     * @brief 目标缓冲区是否已经写满，写满后就不需要再生成新的行了
+     */
+    bool full() const { return m_pos == m_capacity; }
+
+private:
+    /**
+     * @brief 写入字段分隔符（第一个字段之前不需要）
+     */
+    void separate();
+
+    /**
+     * @brief 写入原始字节，优先写入目标缓冲区，放不下的部分写入溢出缓冲区
+     */
+    void put(const char *data, size_t length);
+
+private:
+    char *m_dst;                // 目标缓冲区
+    size_t m_capacity;          // 目标缓冲区容量
+    size_t m_pos;               // 目标缓冲区已经写入的位置
+    std::string &m_overflow;    // 溢出缓冲区
+    size_t m_rowStart;          // 当前行在目标缓冲区中的起始位置
+    size_t m_rowOverflowStart;  // 当前行在溢出缓冲区中的起始位置
+    bool m_firstField;          // 当前字段是否为一行中的第一个字段
+};
+
+/**
+ * @brief 行数据源
+ * 每次调用写入一行数据并返回true；没有更多数据时返回false（此次调用写入的内容会被丢弃）
+ * 数据源抛出的异常会中止本次导入，并由bulkLoad重新抛出
+ */
+using BulkRowSource = std::function<bool(BulkRowWriter &)>;
+
+#endif  // BULK_LOADER_H
@@ -0,0 +1,165 @@
+/**
+ * @brief 实现按列存储的查询结果
+ */
+#ifndef COLUMNAR_RESULT_H
+#define COLUMNAR_RESULT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <mysql/mysql.h>
+
+/**
+ * @brief 列的存储类型，由MYSQL_FIELD的类型决定
+ */
+enum class ColumnType
+{
+    INT64 = 0,  // 整数类型：TINYINT/SMALLINT/MEDIUMINT/INT/BIGINT/YEAR
+    DOUBLE = 1, // 浮点类型：FLOAT/DOUBLE/DECIMAL（DECIMAL会损失精度，适用于分析聚合）
+    STRING = 2  // 其他所有类型，保留MySQL返回的原始文本
+};
+
+/**
+ * @brief 一列数据，所有行的值连续存储
+ *
+ * 内存布局与Apache Arrow一致，方便后续直接导出：
+ * 1）validity：有效位图，第i行对应validity[i / 8]的第(i % 8)位（低位在前），1表示非NULL
+ * 2）INT64/DOUBLE：int64Values/doubleValues连续存储，NULL的位置为0
+ * 3）STRING：offsets有rowCount + 1个元素，第i行的内容是bytes[offsets[i], offsets[i + 1])
+ */
+struct Column
+{
+    std::string name;                   // 列名
+    ColumnType type;                    // 存储类型
+    enum_field_types mysqlType;         // 原始的MySQL字段类型
+    unsigned int flags;                 // 原始的MySQL字段标志（UNSIGNED_FLAG等）
+    unsigned int charsetnr;             // 原始的字符集编号，63表示binary
+    size_t nullCount;                   // NULL值的数量
+
+    std::vector<uint8_t> validity;      // 有效位图
+    std::vector<int64_t> int64Values;   // INT64列的值
+    std::vector<double> doubleValues;   // DOUBLE列的值
+    std::vector<uint32_t> offsets;      // STRING列每行的起始偏移
+    std::string bytes;                  // STRING列所有行的字节
+
+    Column() : type(ColumnType::STRING), mysqlType(MYSQL_TYPE_NULL), flags(0), charsetnr(0), nullCount(0) {}
+
+    /**
+     * @brief 指定行是否为NULL
+     */
+    bool isNull(size_t row) const
+    {
+        return (validity[row >> 3] & (1u << (row & 7))) == 0;
+    }
+
+    /**
+     * @brief 得到STRING列指定行的数据指针和长度，不产生拷贝
+     */
+    const char *stringData(size_t row, size_t &length) const
+    {
+        length = offsets[row + 1] - offsets[row];
+        return bytes.data() + offsets[row];
+    }
+
+    /**
+     * @brief 得到STRING列指定行的字符串（会产生拷贝，NULL返回空字符串）
+     */
+    std::string getString(size_t row) const
+    {
+        return std::string(bytes, offsets[row], offsets[row + 1] - offsets[row]);
+    }
+};
+
+/**
+ * @brief 按列存储的查询结果
+ *
+ * 设计特点：
+ * 1）一次遍历：构造时遍历一次MYSQL_RES，把每个单元格解码到对应列的连续数组中
+ * 2）缓存友好：下游的聚合计算直接遍历连续的int64/double数组，编译器可以向量化
+ * 3）不可变：构造完成之后只读，可以在多个线程之间共享（查询缓存会用到这一点）
+ *
+ * 使用示例：
+ * ColumnarResult columns = conn.executeQuery("SELECT age, score FROM users")->toColumns();
+ * const Column &age = columns.getColumn("age");
+ * int64_t sum = 0;
+ * for(size_t i = 0; i < columns.getRowCount(); ++i)
+ *     sum += age.int64Values[i];     // NULL的位置为0，不影响求和
+ */
+class ColumnarResult
+{
+public:
+    ColumnarResult();
+
+    /**
+     * @brief 从MySQL结果集构造，会从第一行开始遍历
+     * @param result MySQL结果集，不接管所有权
+     * @throws std::length_error 如果某一列的字符串总长度超过4GB
+     */
+    explicit ColumnarResult(MYSQL_RES *result);
+
+    /**
+     * @brief 从MySQL结果集的当前游标位置开始，最多读取maxRows行
+     * @param result MySQL结果集，不接管所有权
+     * @param maxRows 最多读取的行数，用于分批处理大结果集
+     * @throws std::length_error 如果某一列的字符串总长度超过4GB
+     */
+    ColumnarResult(MYSQL_RES *result, size_t maxRows);
+
+    ColumnarResult(const ColumnarResult &) = delete;
+    ColumnarResult &operator=(const ColumnarResult &) = delete;
+    ColumnarResult(ColumnarResult &&) noexcept = default;
+    ColumnarResult &operator=(ColumnarResult &&) noexcept = default;
+
+    /**
+     * @brief 得到行数
+     */
+    size_t getRowCount() const { return m_rowCount; }
+
+    /**
+     * @brief 得到列数
+     */
+    size_t getColumnCount() const { return m_columns.size(); }
+
+    /**
+     * @brief 按索引得到列
+     * @throws std::out_of_range 索引超出范围
+     */
+    const Column &getColumn(size_t index) const;
+
+    /**
+     * @brief 按列名得到列
+     * @throws std::out_of_range 列名不存在
+     */
+    const Column &getColumn(const std::string &name) const;
+
+    /**
+     * @brief 得到所有列
+     */
+    const std::vector<Column> &getColumns() const { return m_columns; }
+
+    /**
+     * @brief 估算占用的内存字节数
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * @brief 根据MySQL字段类型得到列的存储类型
+     */
+    static ColumnType columnTypeOf(const MYSQL_FIELD &field);
+
+private:
+    /**
+     * @brief 根据字段信息初始化每一列，并读取最多maxRows行
+     */
+    void load(MYSQL_RES *result, size_t maxRows);
+
+private:
+    std::vector<Column> m_columns;  // 所有列
+    size_t m_rowCount;              // 行数
+};
+
+// 类型别名，不可变结果的智能指针
+using ColumnarResultPtr = std::shared_ptr<const ColumnarResult>;
+
+#endif  // COLUMNAR_RESULT_H
@@ -4,7 +4,17 @@
 #include <string>
 #include <mysql/mysql.h>
 #include <memory>
+#include <vector>
+#include <chrono>
 #include "query_result.h"
+#include "bulk_loader.h"
+#include "query_cache.h"
+#include "pool_metrics.h"
+#include "query_stats.h"
+#include "slow_query_log.h"
+#include "pool_interceptor.h"
+#include "pool_probes.h"
+#include "profiled_mutex.h"
 
 /**
  * @brief 数据库连接类，负责管理单个数据库连接
@@ -20,6 +30,20 @@
 class Connection
 {
 public:
+    /**
+     * @brief 会话状态的标志位，记录借出者留在连接上的会话状态，可以按位组合
+     */
+    enum SessionState : unsigned int
+    {
+        SESSION_CLEAN = 0,
+        SESSION_TRANSACTION = 1u << 0,  // 开始了事务但是没有提交或者回滚
+        SESSION_VARIABLES = 1u << 1,    // SET修改了会话变量或者用户变量
+        SESSION_TEMP_TABLES = 1u << 2,  // 创建了临时表
+        SESSION_LOCKS = 1u << 3,        // LOCK TABLES持有的表锁
+        SESSION_PREPARED = 1u << 4,     // PREPARE的语句
+        SESSION_DATABASE = 1u << 5      // USE切换了默认数据库
+    };
+
     /**
      * @brief 构造函数，使用给定参数进行初始化，创建连接
      */
@@ -107,6 +131,93 @@ public:
      */
     unsigned long long executeUpdate(const std::string &sql);
 
+    /**
+     * @brief 批量导入，通过LOAD DATA LOCAL INFILE把内存中生成的行流式发送给MySQL
+     * @param table 目标表名（可以是db.table的形式）
+     * @param columns 按顺序写入的列名
+     * @param rowSource 行数据源，每次调用写入一行，返回false表示结束
+     * @return 导入的行数（受影响的行数）
+     * @throws std::runtime_error 如果导入失败，或者行数据源抛出了异常
+     *
+     * 不会写任何临时文件，行数据直接格式化到mysqlclient的读缓冲区中
+     * 注意：服务端需要开启local_infile=ON
+     *
+     * 使用示例：
+     * int i = 0;
+     * auto loaded = conn.bulkLoad("test_users", {"name", "age", "email"}, [&](BulkRowWriter &row) {
+     *     if(i == 10000)
+     *         return false;
+     *     row.addString("user" + std::to_string(i)).addInt(20 + i % 30).addString("bulk@example.com");
+     *     ++i;
+     *     return true;
+     * });
+     */
+    unsigned long long bulkLoad(const std::string &table, const std::vector<std::string> &columns,
+                                const BulkRowSource &rowSource);
+
+    // =============================
+    // 查询缓存方法
+    // =============================
+
+    /**
+     * @brief 设置查询缓存，多个连接可以共享同一个缓存；传入nullptr表示关闭缓存
+     * 设置之后executeUpdate/bulkLoad会自动让涉及的表的缓存失效
+     */
+    void setQueryCache(QueryCachePtr cache);
+
+    /**
+     * @brief 得到当前使用的查询缓存
+     */
+    QueryCachePtr getQueryCache() const;
+
+    /**
+     * @brief 执行SELECT查询，优先从查询缓存中读取
+     * @return 不可变的按列存储结果，可以在多个线程之间共享
+     * @throws std::runtime_error 如果查询失败
+     *
+     * 没有设置缓存，或者当前处于事务中时（事务中的读需要看到自己未提交的修改），直接查询数据库
+     *
+     * 使用示例：
+     * ColumnarResultPtr flags = conn.executeCachedQuery("SELECT name, enabled FROM feature_flags");
+     * const Column &enabled = flags->getColumn("enabled");
+     */
+    ColumnarResultPtr executeCachedQuery(const std::string &sql);
+
+    // =============================
+    // 性能统计方法
+    // =============================
+
+    /**
+     * @brief 设置性能统计，多个连接可以共享同一个统计对象；传入nullptr表示关闭统计
+     * 设置之后记录建立连接、ping、查询、更新、事务操作的耗时，以及失败的错误码
+     * 注意：需要在connect之前设置才能记录建立连接的耗时
+     */
+    void setMetrics(PoolMetricsPtr metrics);
+
+    /**
+     * @brief 得到当前使用的性能统计
+     */
+    PoolMetricsPtr getMetrics() const;
+
+    /**
+     * @brief 设置按照SQL指纹的执行统计，多个连接可以共享同一个统计对象；传入nullptr表示关闭
+     * 设置之后executeQuery/executeUpdate执行成功时按照指纹记录耗时、返回行数和影响行数
+     */
+    void setQueryStats(QueryStatsPtr queryStats);
+
+    /**
+     * @brief 设置慢查询日志，多个连接可以共享同一个日志；传入nullptr表示关闭
+     * 设置之后executeQuery/executeUpdate执行成功、耗时超过阈值的语句写入慢查询日志
+     */
+    void setSlowQueryLog(SlowQueryLogPtr slowQueryLog);
+
+    /**
+     * @brief 设置拦截器，多个连接可以共享同一个拦截器；传入nullptr表示关闭
+     * 设置之后executeQuery/executeUpdate前后调用onQueryStart/onQueryEnd，connect之后调用onConnect
+     * 注意：需要在connect之前设置才能收到onConnect
+     */
+    void setInterceptor(PoolInterceptorPtr interceptor);
+
     // =============================
     // 事务管理方法 ### 重点
     // =============================
@@ -141,6 +252,38 @@ public:
      */
     bool rollback();
 
+    // =============================
+    // 会话状态方法
+    // =============================
+
+    /**
+     * @brief 得到会话状态的标志位（SessionState的组合）
+     *
+     * beginTransaction设置、commit/rollback清除SESSION_TRANSACTION；
+     * 执行的语句以SET/USE/LOCK/PREPARE/START TRANSACTION/BEGIN/CREATE TEMPORARY开头时设置对应的标志，
+     * 直接执行的COMMIT/ROLLBACK语句不会清除标志（可能是ROLLBACK TO SAVEPOINT），多做一次重置总是安全的
+     */
+    unsigned int getSessionState() const;
+
+    /**
+     * @brief 会话状态是否被修改过
+     */
+    bool isSessionDirty() const { return getSessionState() != SESSION_CLEAN; }
+
+    /**
+     * @brief 手动标记会话状态，用于无法从语句开头识别的情况，例如SELECT GET_LOCK(...)、SELECT ... INTO @var
+     */
+    void markSessionState(unsigned int flags);
+
+    /**
+     * @brief 使用mysql_reset_connection重置会话：回滚事务、删除临时表、释放表锁、
+     *        清除用户变量和PREPARE的语句、会话变量恢复为全局值；只需要一次往返，不需要重新认证
+     * @return 是否成功重置；会话状态没有被修改过时直接返回true，不访问服务器
+     *
+     * 默认数据库被USE切换过时，重置之后会切换回创建连接时的数据库
+     */
+    bool resetSession();
+
     // =============================
     // 错误处理方法
     // =============================
@@ -168,6 +311,17 @@ public:
      */
     std::string escapeString(const std::string &sql);
 
+    /**
+     * @brief 使用mysql_real_escape_string转义，直接追加到out的末尾
+     * @param out 输出缓冲区，可以复用，容量足够时不会分配内存
+     * @param data 待转义的字符串
+     * @param length 待转义字符串的长度
+     * @throws std::runtime_error 如果连接没有建立
+     *
+     * 与Utils::escapeAppend的区别：这里会考虑连接的字符集，对多字节字符更加安全
+     */
+    void escapeAppend(std::string &out, const char *data, size_t length);
+
     /**
      * @brief 获取连接创建时间
      * @return 毫秒级的时间戳(创建时间)
@@ -193,6 +347,11 @@ public:
      */
     std::string getConnectionId() const;
 
+    /**
+     * @brief 获取连接的目标，格式和DBConfig::getConnectionStr()相同：user@host:port/database
+     */
+    std::string getConnectionStr() const;
+
 private:
     // =============================
     // 私有方法
@@ -212,6 +371,47 @@ private:
      */
     QueryResultPtr executeInternal(const std::string &sql, bool isQuery);
 
+    /**
+     * @brief 写语句执行之后让查询缓存失效，事务中的写语句会记录下来，提交时再次失效
+     */
+    void invalidateCache(const std::string &sql);
+
+    /**
+     * @brief 启用了性能统计、指纹统计、慢查询日志、拦截器或者挂载了探针时得到开始时间，都没有时不读取时钟
+     */
+    std::chrono::steady_clock::time_point startTiming() const
+    {
+        bool observed = m_metrics || m_queryStats || m_slowQueryLog || m_interceptor ||
+                        POOL_PROBE_ENABLED(query_end) || POOL_PROBE_ENABLED(connect);
+        return observed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    }
+
+    /**
+     * @brief 记录从start开始的耗时，没有启用性能统计时什么都不做
+     */
+    void recordLatency(PoolMetrics::Histogram histogram, std::chrono::steady_clock::time_point start) const;
+
+    /**
+     * @brief 记录最近一次失败的错误码，没有启用性能统计时什么都不做
+     */
+    void recordError() const;
+
+    /**
+     * @brief 记录一条执行成功的语句：耗时计入直方图，按照指纹统计，超过阈值时写入慢查询日志，通知拦截器和探针
+     */
+    void recordStatement(const std::string &sql, PoolMetrics::Histogram histogram,
+                         std::chrono::steady_clock::time_point start, uint64_t rows, uint64_t affectedRows) const;
+
+    /**
+     * @brief 通知拦截器和query_end探针语句执行失败
+     */
+    void notifyQueryFailed(const std::string &sql, bool isQuery, std::chrono::steady_clock::time_point start) const;
+
+    /**
+     * @brief 通知拦截器和connect探针建立连接的结果
+     */
+    void notifyConnect(std::chrono::steady_clock::time_point start, bool connected) const;
+
 private:
     // =============================
     // 私有数据成员
@@ -225,8 +425,16 @@ private:
     std::string m_connectionId;         // 连接唯一标识符
     int64_t m_creationTime;             // 连接创建时间
     mutable int64_t m_lastActiveTime;   // 连接最后活动时间
-    mutable std::recursive_mutex m_mutex;         // 互斥锁，保证线程安全
+    mutable ConnectionMutex m_mutex;    // 互斥锁，保证线程安全
     bool m_connected;                   // 是否已经建立连接
+    bool m_inTransaction;               // 是否处于beginTransaction开始的事务中
+    unsigned int m_sessionState;        // 会话状态的标志位，见SessionState
+    QueryCachePtr m_queryCache;         // 查询缓存，可以为空
+    PoolMetricsPtr m_metrics;           // 性能统计，可以为空
+    QueryStatsPtr m_queryStats;         // 按照SQL指纹的执行统计，可以为空
+    SlowQueryLogPtr m_slowQueryLog;     // 慢查询日志，可以为空
+    PoolInterceptorPtr m_interceptor;   // 拦截器，可以为空
+    std::vector<std::string> m_transactionWrites;   // 事务中执行过的写语句，提交时需要再次让缓存失效
 };
 
 // 智能指针类型别名
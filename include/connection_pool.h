@@ -0,0 +1,446 @@
+/**
+ * @brief 实现数据库连接池
+ */
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <string>
+#include <memory>
+#include <deque>
+#include <list>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <stdexcept>
+#include "pool_config.h"
+#include "connection.h"
+#include "query_cache.h"
+#include "pool_metrics.h"
+#include "query_stats.h"
+#include "slow_query_log.h"
+#include "pool_interceptor.h"
+#include "profiled_mutex.h"
+
+/**
+ * @brief 获取连接的优先级，数值越小优先级越高
+ */
+enum class AcquirePriority
+{
+    CRITICAL = 0,   // 关键请求（如支付、登录），可以使用全部连接
+    NORMAL = 1,     // 普通的用户请求，不能使用为CRITICAL预留的连接
+    BATCH = 2       // 后台任务，不能使用为CRITICAL和NORMAL预留的连接
+};
+
+/**
+ * @brief 连接池过载时的快速失败，和等待超时（返回nullptr）区分开
+ * 调用者应该直接向上游返回“服务繁忙”，而不是重试
+ */
+class PoolOverloadException : public std::runtime_error
+{
+public:
+    explicit PoolOverloadException(const std::string &message) : std::runtime_error(message) {}
+};
+
+/**
+ * @brief 数据库连接池，负责创建、借出、回收连接
+ *
+ * 设计特点：
+ * 1）RAII归还：getConnection返回的智能指针带有自定义删除器，析构时自动把连接归还给连接池
+ * 2）按需创建：空闲连接用完且没有达到maxConnections时，在锁外创建新连接
+ * 3）坏连接淘汰：归还时如果连接的最后一个错误是连接断开（2006/2013），直接关闭，不放回连接池
+ * 4）多实例：配置了多个数据库实例时，按照权重轮流在各个实例上创建连接
+ * 5）查询缓存：PoolConfig::queryCacheSize大于0时，所有连接共享同一个查询缓存
+ * 6）公平等待：连接用完时，等待者按照到达顺序排队，归还的连接直接交给队首的等待者，
+ *    每个等待者有自己的条件变量，只唤醒被选中的那一个；已经超过截止时间的等待者会被跳过
+ * 7）优先级：每个优先级有自己的等待队列，高优先级的等待者总是先被服务；
+ *    PoolConfig::criticalReserved/normalReserved为高优先级预留连接，后台任务永远用不到最后的N个连接
+ * 8）单飞（single-flight）：executeSharedQuery中，同时到达的相同查询只执行一次，
+ *    其他线程等待第一个线程的结果，不占用连接，用于缓存未命中时挡住惊群
+ * 9）自适应连接数：PoolConfig::adaptiveSizing为true时，后台线程每个周期统计借出等待时间和连接占用时间，
+ *    由Little定律（平均占用连接数 = 到达率 × 平均占用时间）估算需要的连接数；
+ *    有排队或者平均等待超过targetWaitTime时立即增加，连续多个周期利用率偏低才按比例减少，避免来回抖动
+ * 10）过载保护：等待队列有上限（maxWaiters）；队首等待者的逗留时间持续queueInterval超过queueTargetDelay时（CoDel），
+ *    说明队列已经无法自己消化，新到达的非CRITICAL请求直接抛出PoolOverloadException，不再排队
+ * 11）连接轮换：PoolConfig::maxLifetime大于0时，空闲连接到期后由后台线程先建立新连接、再替换并关闭旧连接，
+ *    轮换期间可用的连接数不会减少；每个连接的寿命有随机的抖动，同一批创建的连接不会同时重连；
+ *    借出期间到期的连接归还时放到空闲队列的最前面，避免一直被借出而错过轮换
+ * 12）会话重置：PoolConfig::resetSessionOnRelease为true时，借出者留下了会话状态（未结束的事务、会话变量、临时表等）的连接
+ *    归还时用mysql_reset_connection重置，只有一次往返；没有修改过会话状态的连接不会产生额外的往返，重置失败的连接直接关闭
+ * 13）性能统计：PoolConfig::enablePerformanceStat为true时，连接池和所有连接共享一个PoolMetrics，
+ *    记录借出等待、查询、更新、事务、建立连接、ping的延迟直方图，以及超时、拒绝、重连和错误码的计数；
+ *    同时按照SQL指纹（字面量替换为?）统计执行次数、耗时和行数，只保留总耗时最多的queryStatsCapacity个指纹
+ * 14）慢查询日志：PoolConfig::slowQueryThreshold大于0时，所有连接共享一个SlowQueryLog，
+ *    超过阈值的语句按照采样率由后台线程写入slowQueryLogFile，不经过同步的Logger
+ * 15）拦截器：PoolConfig::interceptor不为空时，借出连接、执行语句、建立连接的前后调用它（见PoolInterceptor），
+ *    用于把借出等待时间和数据库执行时间接入分布式追踪
+ * 16）锁竞争分析：使用-DENABLE_LOCK_PROFILING=ON编译时，连接池、连接、日志器的互斥锁换成ProfiledMutex，
+ *    每个加锁位置的等待时间和持有时间见PoolMetrics::Snapshot::locks；默认编译时就是std::mutex，没有额外开销
+ *
+ * 注意：连接池析构时会等待所有借出的连接归还，连接的借出者不能比连接池活得更久
+ *
+ * 使用示例：
+ * PoolConfig config("localhost", "admin", "123456", "testdb");
+ * ConnectionPool pool(config);
+ * {
+ *     ConnectionPtr conn = pool.getConnection();
+ *     if(conn)
+ *         conn->executeUpdate("UPDATE users SET age = age + 1");
+ * }   // 离开作用域，连接自动归还
+ * ColumnarResultPtr flags = pool.executeSharedQuery("SELECT name, enabled FROM feature_flags");
+ */
+class ConnectionPool
+{
+public:
+    /**
+     * @brief 构造函数，创建initConnections个连接
+     * @throws std::invalid_argument 如果配置无效
+     */
+    explicit ConnectionPool(const PoolConfig &config);
+
+    /**
+     * @brief 析构函数，等待借出的连接全部归还，然后关闭所有连接
+     */
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool &) = delete;
+    ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+    // =============================
+    // 连接获取方法
+    // =============================
+
+    /**
+     * @brief 从连接池中借出一个连接，最多等待connectionTimeout毫秒
+     * @param priority 获取连接的优先级
+     * @return 连接的智能指针，析构时自动归还；超时或者无法创建连接时返回nullptr
+     * @throws PoolOverloadException 如果需要排队但是被过载保护拒绝
+     */
+    ConnectionPtr getConnection(AcquirePriority priority = AcquirePriority::NORMAL);
+
+    /**
+     * @brief 从连接池中借出一个连接，最多等待到deadline
+     * @param deadline 截止时间，通常是请求本身的截止时间，已经过期时不会等待
+     * @param priority 获取连接的优先级
+     * @return 连接的智能指针，析构时自动归还；超时或者无法创建连接时返回nullptr
+     * @throws PoolOverloadException 如果需要排队但是被过载保护拒绝
+     *
+     * 使用示例：
+     * auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+     * ConnectionPtr conn = pool.getConnection(deadline, AcquirePriority::CRITICAL);
+     */
+    ConnectionPtr getConnection(std::chrono::steady_clock::time_point deadline,
+                                AcquirePriority priority = AcquirePriority::NORMAL);
+
+    // =============================
+    // 查询方法
+    // =============================
+
+    /**
+     * @brief 执行只读查询，相同的查询同时到达时只执行一次
+     * @return 不可变的按列存储结果，所有等待的线程共享同一份结果
+     * @throws std::runtime_error 如果获取连接超时或者查询失败，所有等待的线程都会收到同一个异常
+     * @throws PoolOverloadException 如果获取连接被过载保护拒绝（也会传给所有等待的线程）
+     *
+     * 先查询缓存（如果启用），未命中时：第一个到达的线程借出连接执行查询，
+     * 其他相同查询的线程只等待结果，执行完成后结果写入缓存
+     * 注意：只能用于没有副作用的SELECT，键是规范化之后的SQL
+     */
+    ColumnarResultPtr executeSharedQuery(const std::string &sql);
+
+    // =============================
+    // 状态查询方法
+    // =============================
+
+    /**
+     * @brief 空闲连接数
+     */
+    size_t getIdleCount() const;
+
+    /**
+     * @brief 借出的连接数
+     */
+    size_t getActiveCount() const;
+
+    /**
+     * @brief 连接总数（空闲 + 借出 + 正在创建）
+     */
+    size_t getTotalCount() const;
+
+    /**
+     * @brief 当前允许的连接数上限，没有启用自适应连接数时等于maxConnections
+     */
+    size_t getTargetCount() const;
+
+    /**
+     * @brief 正在等待连接的线程数
+     */
+    size_t getWaiterCount() const;
+
+    /**
+     * @brief 一个数据库实例上的连接数
+     */
+    struct InstanceStats
+    {
+        std::string connectionStr;  // DBConfig::getConnectionStr()
+        size_t idle = 0;            // 空闲连接数
+        size_t active = 0;          // 借出的连接数
+        size_t total = 0;           // 已经建立的连接数
+    };
+
+    /**
+     * @brief 每个数据库实例上的连接数，顺序和配置的实例相同
+     */
+    std::vector<InstanceStats> getInstanceStats() const;
+
+    /**
+     * @brief 把连接池的状态和性能统计按照Prometheus文本格式追加到out的末尾
+     * @param out 输出缓冲区，可以在多次抓取之间复用，容量足够时不会分配内存
+     *
+     * 使用示例（在自己的HTTP服务中）：
+     * thread_local std::string body;
+     * body.clear();
+     * pool.renderPrometheus(body);
+     * response.send(body);
+     */
+    void renderPrometheus(std::string &out) const;
+
+    /**
+     * @brief executeSharedQuery中等待其他线程结果、没有占用连接的查询次数
+     */
+    uint64_t getCoalescedQueryCount() const { return m_coalescedQueries.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 被过载保护拒绝的请求数
+     */
+    uint64_t getRejectedCount() const { return m_rejected.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因为超过maxLifetime被轮换的连接数
+     */
+    uint64_t getRotatedCount() const { return m_rotated.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 归还时重置会话的次数
+     */
+    uint64_t getSessionResetCount() const { return m_sessionResets.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 得到共享的查询缓存，没有启用时返回nullptr
+     */
+    QueryCachePtr getQueryCache() const { return m_queryCache; }
+
+    /**
+     * @brief 得到性能统计，没有启用时返回nullptr
+     *
+     * 使用示例：
+     * PoolMetrics::Snapshot snapshot = pool.getMetrics()->snapshot();
+     * std::cout << "p99 acquire wait: " << snapshot.histograms[PoolMetrics::ACQUIRE_WAIT].p99 << "us" << std::endl;
+     */
+    PoolMetricsPtr getMetrics() const { return m_metrics; }
+
+    /**
+     * @brief 总耗时最多的n个SQL指纹，没有启用时返回空
+     *
+     * 使用示例：
+     * for (const QueryStats::Entry &entry : pool.getTopQueries(10))
+     *     std::cout << entry.totalMicros << "us " << entry.calls << " " << entry.fingerprint << std::endl;
+     */
+    std::vector<QueryStats::Entry> getTopQueries(size_t n) const;
+
+    /**
+     * @brief 得到慢查询日志，没有启用时返回nullptr
+     */
+    SlowQueryLogPtr getSlowQueryLog() const { return m_slowQueryLog; }
+
+    /**
+     * @brief 得到连接池配置
+     */
+    const PoolConfig &getConfig() const { return m_config; }
+
+private:
+    /**
+     * @brief 一个等待连接的线程，对象在等待线程的栈上
+     */
+    struct Waiter
+    {
+        PoolConditionVariable cv;                   // 只有这个等待者会被唤醒
+        std::chrono::steady_clock::time_point deadline; // 等待的截止时间
+        std::chrono::steady_clock::time_point enqueueTime;  // 开始排队的时间
+        AcquirePriority priority;                   // 所在的等待队列
+        std::unique_ptr<Connection> conn;           // 归还者直接交给这个等待者的连接
+        bool permit = false;                        // 获得了创建新连接的名额（连接数已经计入）
+        bool queued = true;                         // 是否仍然在等待队列中
+    };
+    using WaiterList = std::list<Waiter *>;
+    static const size_t kPriorityCount = 3;     // AcquirePriority的数量
+
+    // =============================
+    // 私有方法
+    // =============================
+
+    /**
+     * @brief 借出前检查连接：最近使用过的直接认为有效，否则ping一次，在锁外调用
+     */
+    bool isUsable(Connection &conn) const;
+
+    /**
+     * @brief 指定优先级最多可以同时借出的连接数，调用者需要持有m_mutex
+     */
+    size_t borrowLimit(AcquirePriority priority) const;
+
+    /**
+     * @brief 是否有相同或者更高优先级的线程在排队，调用者需要持有m_mutex
+     */
+    bool hasWaitersAtOrAbove(AcquirePriority priority) const;
+
+    /**
+     * @brief 过载保护：判断一个需要排队的请求是否允许进入等待队列，同时更新CoDel状态，调用者需要持有m_mutex
+     * @param reason 拒绝的原因
+     * @return 允许排队时返回true
+     */
+    bool admitWaiter(AcquirePriority priority, std::chrono::steady_clock::time_point now, std::string &reason);
+
+    /**
+     * @brief 连接归还或者连接数减少之后，把空闲连接或者创建新连接的名额交给等待者，调用者需要持有m_mutex
+     * 按照优先级从高到低，每个队列内先到先得；借出数已经达到上限的优先级不会被服务
+     */
+    void dispatchToWaiters();
+
+    /**
+     * @brief 弹出可以服务的第一个没有过期的等待者，过期的等待者直接出队，调用者需要持有m_mutex
+     * @return 等待者；没有时返回nullptr
+     */
+    Waiter *popEligibleWaiter();
+
+    /**
+     * @brief 后台维护线程，周期性地调整连接数、轮换到期的连接
+     */
+    void maintenanceLoop();
+
+    /**
+     * @brief 连接属于哪个数据库实例（m_instances的下标）
+     */
+    size_t instanceOf(const Connection &conn) const;
+
+    /**
+     * @brief 连接的到期时间（毫秒时间戳）：创建时间 + maxLifetime - 抖动
+     */
+    int64_t expireTime(const Connection &conn) const;
+
+    /**
+     * @brief 用新连接替换到期的空闲连接，在锁外调用
+     */
+    void rotateExpiredConnections();
+
+    /**
+     * @brief 根据上一个周期的统计调整m_targetConnections，多余的空闲连接在锁外关闭
+     */
+    void adjustPoolSize();
+
+    /**
+     * @brief 按照权重选择数据库实例并建立连接，在锁外调用
+     * @return 建立好的连接；失败时返回nullptr
+     */
+    std::unique_ptr<Connection> createConnection();
+
+    /**
+     * @brief getConnection的实现：借出空闲连接、创建新连接或者排队等待
+     * @param requestTime 调用getConnection的时间
+     */
+    ConnectionPtr acquireConnection(std::chrono::steady_clock::time_point deadline, AcquirePriority priority,
+                                    std::chrono::steady_clock::time_point requestTime);
+
+    /**
+     * @brief 借出结束时通知拦截器和acquire探针
+     */
+    void notifyAcquireEnd(const PoolInterceptor::AcquireEvent &event);
+
+    /**
+     * @brief 把连接包装为智能指针，析构时调用releaseConnection，同时记录这次借出的等待时间
+     * @param requestTime 调用getConnection的时间
+     */
+    ConnectionPtr wrapConnection(std::unique_ptr<Connection> conn, std::chrono::steady_clock::time_point requestTime);
+
+    /**
+     * @brief 在锁外拿到的连接交给请求方之前再检查一次截止时间，超时时放回连接池并返回nullptr
+     */
+    ConnectionPtr handOutConnection(std::unique_ptr<Connection> conn, std::chrono::steady_clock::time_point deadline,
+                                    AcquirePriority priority, std::chrono::steady_clock::time_point requestTime);
+
+    /**
+     * @brief 借出的名额没有变成连接（连接无效被丢弃、创建失败），归还名额并唤醒等待者和析构函数，调用者需要持有m_mutex
+     * 连接所属实例的计数由调用者处理
+     */
+    void releaseSlot();
+
+    /**
+     * @brief 记录一次借出超时，调用者需要持有m_mutex
+     */
+    void recordAcquireTimeout(AcquirePriority priority);
+
+    /**
+     * @brief 归还连接，由智能指针的删除器调用
+     * @param borrowTime 借出的时间，用于统计连接占用时间
+     */
+    void releaseConnection(Connection *conn, std::chrono::steady_clock::time_point borrowTime);
+
+    /**
+     * @brief 把借出计数中的连接放回连接池：断开的、多余的连接关闭，其他的交给等待者或者放回空闲队列，在锁外调用
+     * @param broken 连接已经不能使用
+     * @param errorCode broken时的错误码，用于日志
+     */
+    void returnToPool(std::unique_ptr<Connection> owned, bool broken, unsigned int errorCode);
+
+private:
+    // =============================
+    // 私有数据成员
+    // =============================
+    PoolConfig m_config;                // 连接池配置
+    DBConfigList m_instances;           // 数据库实例，单数据库模式下只有一个
+    unsigned int m_totalWeight;         // 所有实例的权重之和
+    unsigned int m_nextSlot;            // 加权轮询的位置，受m_mutex保护
+
+    mutable PoolMutex m_mutex;          // 保护以下连接状态
+    PoolConditionVariable m_available;  // 借出的连接数或者等待者减少时通知析构函数
+    WaiterList m_waiters[kPriorityCount];   // 每个优先级的等待队列，先到先得
+    std::deque<std::unique_ptr<Connection>> m_idle; // 空闲连接，最近归还的在后面
+    std::vector<size_t> m_instanceConnections;      // 每个实例上已经建立的连接数
+    size_t m_totalConnections;          // 连接总数
+    size_t m_activeConnections;         // 借出的连接数
+    size_t m_targetConnections;         // 当前允许的连接数上限，自适应连接数在[min, max]之间调整
+    bool m_closing;                     // 连接池正在析构
+
+    // CoDel过载检测的状态，受m_mutex保护
+    std::chrono::steady_clock::time_point m_firstAboveTime; // 队首逗留时间超过目标之后，开始拒绝的时间；未超过时为默认值
+    bool m_shedding;                    // 是否正在拒绝新的请求
+    std::atomic<uint64_t> m_rejected;   // 被拒绝的请求数
+
+    // 自适应连接数的采样，每个周期清零
+    std::atomic<uint64_t> m_windowBorrows;      // 借出次数
+    std::atomic<uint64_t> m_windowWaitMicros;   // 借出等待时间之和（微秒）
+    std::atomic<uint64_t> m_windowHoldMicros;   // 连接占用时间之和（微秒），包括查询耗时
+    std::atomic<uint64_t> m_windowTimeouts;     // 等待超时和被过载保护拒绝的次数
+    std::chrono::steady_clock::time_point m_windowStart;    // 这个周期的开始时间，只由维护线程访问
+    unsigned int m_lowWindows;          // 连续利用率偏低的周期数，只由维护线程访问
+    PoolConditionVariable m_maintenanceCv;  // 析构时唤醒维护线程
+    std::thread m_maintenanceThread;    // 后台维护线程，没有启用自适应连接数和连接轮换时不启动
+    std::atomic<uint64_t> m_rotated;    // 轮换的连接数
+    std::atomic<uint64_t> m_sessionResets;  // 归还时重置会话的次数
+
+    QueryCachePtr m_queryCache;         // 共享的查询缓存，可以为空
+    PoolMetricsPtr m_metrics;           // 共享的性能统计，可以为空
+    QueryStatsPtr m_queryStats;         // 共享的SQL指纹统计，可以为空
+    SlowQueryLogPtr m_slowQueryLog;     // 共享的慢查询日志，可以为空
+    PoolInterceptorPtr m_interceptor;   // 拦截器，可以为空
+
+    std::mutex m_flightMutex;           // 保护m_flights
+    std::unordered_map<std::string, std::shared_future<ColumnarResultPtr>> m_flights;   // 正在执行的共享查询
+    std::atomic<uint64_t> m_coalescedQueries;       // 合并掉的查询次数
+};
+
+#endif  // CONNECTION_POOL_H
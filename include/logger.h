@@ -13,6 +13,8 @@
 #include <exception>
 #include <iomanip>
 #include <ctime>
+#include "pool_probes.h"
+#include "profiled_mutex.h"
 
 /**
  * @brief 日志级别枚举
@@ -71,7 +73,7 @@ public:
         {
             return;
         }
-        std::unique_lock<std::mutex> lock(m_mutex);
+        std::unique_lock<LoggerMutex> lock(m_mutex);
         if (m_initialized)
         {
             lock.unlock();
@@ -178,7 +180,7 @@ public:
      */
     void setLevel(LogLevel level)
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<LoggerMutex> lock(m_mutex);
         m_level = level;
     }
 
@@ -188,7 +190,7 @@ public:
      */
     void setToConsole(bool toConsole)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
+        std::unique_lock<LoggerMutex> lock(m_mutex);
         m_toConsole = toConsole;
     }
 
@@ -198,7 +200,7 @@ public:
      */
     LogLevel getLevel() const
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<LoggerMutex> lock(m_mutex);
         return m_level;
     }
 
@@ -254,10 +256,11 @@ private:
         // @note 我认为这里不需要加锁，因为仅仅是读，基本不会影响判断结果，因此可以减少临界区
         if(level < m_level)
             return;
+        POOL_PROBE2(log, static_cast<int>(level), message.c_str());
         // 满足日志级别，格式化日志内容
         std::string formattedMsg = formatMessage(level, message);
         // 这里开始临界区，因为需要更改共享资源，所以需要加锁
-        std::unique_lock<std::mutex> lock(m_mutex);
+        std::unique_lock<LoggerMutex> lock(m_mutex);
         // 判断是否输出到日志文件
         if(m_fileStream.is_open())
         {
@@ -318,7 +321,7 @@ private:
     * @attention 这里一定要使用关键字mutable
     * 因为这样在const成员函数中，仍然可以使用mutex互斥访问共享资源，一旦加锁或者解锁，那么mutex的值必然发生改变，那么在const成员函数中，数据成员定义为mutable才能发生改变，否则会报错
     */
-    mutable std::mutex m_mutex;
+    mutable LoggerMutex m_mutex;
     LogLevel m_level = LogLevel::INFO; // C++11之后数据成员可以提供默认值
     std::ofstream m_fileStream;        // 输出文件流到指定的日志文件    
     bool m_toConsole = true;           // 是否同步输出到控制台
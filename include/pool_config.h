@@ -10,6 +10,7 @@
 #include <stdexcept>
 #include <cassert>
 #include "db_config.h"
+#include "pool_interceptor.h"
 
 /**
  * @brief 连接池配置信息
@@ -46,6 +47,7 @@ struct PoolConfig
     unsigned int connectionTimeout; // 等待获取连接的超时时间
     unsigned int maxIdleTime;       // 连接最大的空闲时间（超过则断开连接）
     unsigned int healthCheckPeriod; // 健康检测的周期
+    unsigned int maxLifetime;       // 连接的最长寿命，到期后在后台轮换，0表示不限制
 
     // =============================
     // 重连设置
@@ -53,10 +55,47 @@ struct PoolConfig
     unsigned int reconnectInterval; // 重连的时间间隔（毫秒）
     unsigned int reconnectAttemps;  // 最大重连尝试次数
 
+    // =============================
+    // 优先级预留设置（见ConnectionPool的AcquirePriority）
+    // =============================
+    unsigned int criticalReserved;  // 只有CRITICAL请求可以使用的连接数
+    unsigned int normalReserved;    // BATCH请求不能使用的连接数（在criticalReserved之外再预留）
+
+    // =============================
+    // 自适应连接数设置
+    // =============================
+    bool adaptiveSizing;            // 是否根据等待时间和利用率在[minConnections, maxConnections]之间自动调整连接数
+    unsigned int adaptiveInterval;  // 采样和调整的周期（毫秒）
+    unsigned int targetWaitTime;    // 可以接受的平均等待时间（毫秒），超过时增加连接
+
+    // =============================
+    // 过载保护设置（见ConnectionPool的PoolOverloadException）
+    // =============================
+    unsigned int maxWaiters;        // 等待连接的线程数上限，0表示不限制
+    unsigned int queueTargetDelay;  // 队首等待者可以接受的逗留时间（毫秒），0表示不启用CoDel拒绝
+    unsigned int queueInterval;     // 逗留时间持续超过queueTargetDelay这么久（毫秒）才开始拒绝
+
+    // =============================
+    // 查询缓存设置
+    // =============================
+    size_t queryCacheSize;          // 查询缓存的内存预算（字节），0表示不启用查询缓存
+    unsigned int queryCacheTtl;     // 查询缓存的存活时间（毫秒）
+
+    // =============================
+    // 性能统计设置
+    // =============================
+    size_t queryStatsCapacity;      // 按照SQL指纹统计时最多保留的指纹数量，0表示不统计（见ConnectionPool::getTopQueries）
+    unsigned int slowQueryThreshold;    // 耗时达到这个值（毫秒）的语句写入慢查询日志，0表示不启用（见SlowQueryLog）
+    double slowQuerySampleRate;         // 慢查询被记录的比例，(0, 1]
+    size_t slowQueryMaxSqlLength;       // 慢查询日志中SQL最多保留的字节数，0表示不记录SQL
+    std::string slowQueryLogFile;       // 慢查询日志文件
+    PoolInterceptorPtr interceptor;     // 借出连接、执行语句、建立连接前后调用的拦截器，可以为空（见PoolInterceptor）
+
     // =============================
     // 其他设置
     // =============================
     bool logQueries;            // 日志是否记录所有的SQL查询
+    bool resetSessionOnRelease; // 归还时会话状态被修改过（见Connection::SessionState）就用mysql_reset_connection重置
     bool enablePerformanceStat; // 是否启用性能统计
 
     /**
@@ -71,9 +110,26 @@ struct PoolConfig
         , connectionTimeout(5000)       // 5秒获取连接超时
         , maxIdleTime(600000)           // 连接最多10分钟空闲时间
         , healthCheckPeriod(30000)      // 每30秒一次健康检测
+        , maxLifetime(0)                // 默认不轮换连接
         , reconnectInterval(1000)       // 1秒的重连时间间隔
         , reconnectAttemps(3)           // 最多重试3次
+        , criticalReserved(0)           // 默认不预留，所有优先级共享全部连接
+        , normalReserved(0)
+        , adaptiveSizing(false)         // 默认使用固定的连接数上限
+        , adaptiveInterval(1000)        // 每秒调整一次
+        , targetWaitTime(10)            // 平均等待超过10毫秒时扩容
+        , maxWaiters(0)                 // 默认不限制等待的线程数
+        , queueTargetDelay(0)           // 默认不启用CoDel拒绝
+        , queueInterval(100)            // 队列持续拥堵100毫秒才开始拒绝
+        , queryCacheSize(0)             // 默认不启用查询缓存
+        , queryCacheTtl(5000)           // 缓存的结果最多保留5秒
+        , queryStatsCapacity(256)       // 保留总耗时最多的256个指纹
+        , slowQueryThreshold(0)         // 默认不记录慢查询
+        , slowQuerySampleRate(1.0)      // 默认记录全部慢查询
+        , slowQueryMaxSqlLength(1024)   // SQL最多保留1KB
+        , slowQueryLogFile("./slow_query.log")
         , logQueries(false)             // 默认不记录SQL查询
+        , resetSessionOnRelease(false)  // 默认归还时不重置会话
         , enablePerformanceStat(true)   // 默认启动性能统计
     {}
 
@@ -122,7 +178,27 @@ struct PoolConfig
         if(connectionTimeout == 0 || maxIdleTime == 0 || healthCheckPeriod == 0)
             return false;   
         
-        // 4. 检查重连设置，不需要检查重连信息
+        // 4. 启用查询缓存时，存活时间不能为0
+        if(queryCacheSize > 0 && queryCacheTtl == 0)
+            return false;
+
+        // 5. 预留之后，BATCH请求至少还要有一个连接可用
+        if(criticalReserved + normalReserved >= maxConnections)
+            return false;
+
+        // 6. 启用自适应连接数时，调整周期不能为0
+        if(adaptiveSizing && adaptiveInterval == 0)
+            return false;
+
+        // 7. 启用CoDel拒绝时，观察窗口不能为0
+        if(queueTargetDelay > 0 && queueInterval == 0)
+            return false;
+
+        // 8. 启用慢查询日志时，采样率在(0, 1]之间，并且要有日志文件
+        if(slowQueryThreshold > 0 && (!(slowQuerySampleRate > 0.0 && slowQuerySampleRate <= 1.0) || slowQueryLogFile.empty()))
+            return false;
+
+        // 9. 检查重连设置，不需要检查重连信息
         // if(reconnectInterval == 0 || reconnectAttemps == 0)
             // return false;
 
@@ -158,8 +234,26 @@ struct PoolConfig
                 + std::to_string(maxConnections) + "]";
         // 超时设置
         summary += ", timeout:" + std::to_string(connectionTimeout) + "ms";
+        if(maxLifetime > 0)
+            summary += ", lifetime:" + std::to_string(maxLifetime) + "ms";
         // 已经建立连接的数据库实例数量
         summary += ", databases:" + std::to_string(getDatabaseCount());
+        // 优先级预留
+        if(criticalReserved > 0 || normalReserved > 0)
+            summary += ", reserved:[critical:" + std::to_string(criticalReserved) + ", normal:" + std::to_string(normalReserved) + "]";
+        // 自适应连接数
+        if(adaptiveSizing)
+            summary += ", adaptive:" + std::to_string(adaptiveInterval) + "ms/" + std::to_string(targetWaitTime) + "ms";
+        // 过载保护
+        if(maxWaiters > 0 || queueTargetDelay > 0)
+            summary += ", admission:[waiters:" + std::to_string(maxWaiters) + ", delay:" + std::to_string(queueTargetDelay) +
+                       "ms/" + std::to_string(queueInterval) + "ms]";
+        // 查询缓存
+        if(queryCacheSize > 0)
+            summary += ", queryCache:" + std::to_string(queryCacheSize) + "B/" + std::to_string(queryCacheTtl) + "ms";
+        // 慢查询日志
+        if(slowQueryThreshold > 0)
+            summary += ", slowQuery:" + std::to_string(slowQueryThreshold) + "ms";
         summary += "}";
 
         return summary;
@@ -195,6 +289,49 @@ struct PoolConfig
         maxIdleTime = idleTimeout;
         healthCheckPeriod = checkPeriod;
     }
+
+    /**
+     * @brief 设置优先级预留
+     * @param critical 只有CRITICAL请求可以使用的连接数
+     * @param normal 在critical之外，BATCH请求不能使用的连接数
+     * 例如maxConnections = 20, critical = 2, normal = 4时，BATCH最多使用14个连接，NORMAL最多使用18个
+     */
+    void setPriorityReserves(unsigned int critical, unsigned int normal)
+    {
+        assert(critical + normal < maxConnections && "reserved connections must be less than maxConnections");
+        criticalReserved = critical;
+        normalReserved = normal;
+    }
+
+    /**
+     * @brief 启用自适应连接数
+     * @param interval 采样和调整的周期（毫秒）
+     * @param waitTime 可以接受的平均等待时间（毫秒）
+     * 连接数从initConnections开始，在[minConnections, maxConnections]之间调整
+     */
+    void enableAdaptiveSizing(unsigned int interval, unsigned int waitTime)
+    {
+        assert(interval > 0 && "interval is must bigger than 0");
+        adaptiveSizing = true;
+        adaptiveInterval = interval;
+        targetWaitTime = waitTime;
+    }
+
+    /**
+     * @brief 设置过载保护
+     * @param waiters 等待连接的线程数上限，0表示不限制
+     * @param targetDelay 队首等待者可以接受的逗留时间（毫秒），0表示不启用CoDel拒绝
+     * @param interval 逗留时间持续超过targetDelay这么久（毫秒）才开始拒绝
+     * 例如waiters = 64, targetDelay = 20, interval = 100：排队的线程超过64个、
+     * 或者队首已经连续100毫秒等待超过20毫秒时，新的请求立即失败，而不是等满connectionTimeout
+     */
+    void setAdmissionControl(unsigned int waiters, unsigned int targetDelay, unsigned int interval)
+    {
+        assert((targetDelay == 0 || interval > 0) && "interval is must bigger than 0");
+        maxWaiters = waiters;
+        queueTargetDelay = targetDelay;
+        queueInterval = interval;
+    }
 };
 
 #endif  // POOL_CONFIG_H
\ No newline at end of file
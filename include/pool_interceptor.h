@@ -0,0 +1,86 @@
+/**
+ * @brief 实现连接池和连接的拦截器接口，用于接入分布式追踪
+ */
+#ifndef POOL_INTERCEPTOR_H
+#define POOL_INTERCEPTOR_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+class Connection;
+
+/**
+ * @brief 拦截器：在借出连接、执行语句、建立连接的前后被调用，携带耗时和元数据
+ *
+ * 设计特点：
+ * 1）不依赖任何追踪SDK：使用者继承这个类，在回调中创建和结束自己的span（例如OpenTelemetry），
+ *    把借出连接的等待时间和数据库执行时间分别记录到请求的追踪中
+ * 2）默认实现什么都不做：只需要重写关心的回调
+ * 3）没有设置拦截器时（默认），调用点只有一次空指针判断，不构造事件、不读取额外的时钟
+ *
+ * 调用约定：
+ * 1）Start和对应的End在同一个线程中调用，可以用thread_local保存当前的span
+ * 2）回调在不持有连接池锁的情况下调用，但是onQueryStart/onQueryEnd/onConnect持有连接自己的锁，
+ *    回调中不能再使用同一个连接执行语句
+ * 3）回调不能抛出异常
+ *
+ * 使用示例：
+ * class TracingInterceptor : public PoolInterceptor
+ * {
+ * public:
+ *     void onQueryStart(const QueryEvent &event) override { span = tracer->StartSpan(*event.sql); }
+ *     void onQueryEnd(const QueryEvent &event) override { span->End(); }
+ * };
+ * config.interceptor = std::make_shared<TracingInterceptor>();
+ */
+class PoolInterceptor
+{
+public:
+    /**
+     * @brief 借出连接的事件
+     */
+    struct AcquireEvent
+    {
+        int priority = 0;                       // AcquirePriority（见connection_pool.h）
+        uint64_t waitMicros = 0;                // 从请求到借出（或者失败）的时间，只在onAcquireEnd中有效
+        const Connection *connection = nullptr; // 借出的连接，nullptr表示超时、被拒绝或者连接池正在关闭
+    };
+
+    /**
+     * @brief 执行语句的事件
+     */
+    struct QueryEvent
+    {
+        const Connection *connection = nullptr; // 执行语句的连接
+        const std::string *sql = nullptr;       // 原始SQL
+        bool isQuery = false;                   // executeQuery为true，executeUpdate为false
+        uint64_t micros = 0;                    // 执行时间，只在onQueryEnd中有效
+        unsigned int errorCode = 0;             // mysql_errno，0表示成功，只在onQueryEnd中有效
+        uint64_t rows = 0;                      // 返回的行数，只在onQueryEnd中有效
+        uint64_t affectedRows = 0;              // 影响的行数，只在onQueryEnd中有效
+    };
+
+    /**
+     * @brief 建立连接的事件
+     */
+    struct ConnectEvent
+    {
+        const Connection *connection = nullptr;
+        uint64_t micros = 0;                    // 建立连接的时间
+        unsigned int errorCode = 0;             // mysql_errno，0表示成功
+    };
+
+    virtual ~PoolInterceptor() = default;
+
+    virtual void onAcquireStart(const AcquireEvent &) {}
+    virtual void onAcquireEnd(const AcquireEvent &) {}
+    virtual void onQueryStart(const QueryEvent &) {}
+    virtual void onQueryEnd(const QueryEvent &) {}
+    virtual void onConnect(const ConnectEvent &) {}
+};
+
+// 类型别名，拦截器在连接池和它的所有连接之间共享
+using PoolInterceptorPtr = std::shared_ptr<PoolInterceptor>;
+
+#endif  // POOL_INTERCEPTOR_H
@@ -0,0 +1,264 @@
+/**
+ * @brief 实现连接池的性能统计
+ */
+#ifndef POOL_METRICS_H
+#define POOL_METRICS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <map>
+
+/**
+ * @brief 连接池的性能统计：延迟直方图 + 计数器
+ *
+ * 设计特点：
+ * 1）每个线程写自己的分片：第一次记录时为线程分配分片，之后只有这个线程写，
+ *    计数只需要relaxed的load + store，没有原子读改写，也没有锁，记录一次只要几纳秒
+ * 2）HDR风格的对数线性分桶：每个2的幂区间再均分为32个桶，相对误差不超过约3%，
+ *    覆盖1微秒到约71分钟，固定内存，不需要预先知道延迟的范围
+ * 3）读取时汇总：snapshot在调用时合并所有分片，计算p50/p90/p99/p999，对记录没有任何影响
+ * 4）线程退出后分片被保留并回收给新的线程，计数不会丢失，线程不断创建销毁也不会无限增长
+ *
+ * 错误码的统计使用互斥锁，错误是少数情况，不影响正常路径
+ *
+ * 使用示例：
+ * auto metrics = std::make_shared<PoolMetrics>();
+ * metrics->record(PoolMetrics::QUERY, 350);        // 一次查询耗时350微秒
+ * metrics->increment(PoolMetrics::ACQUIRE_TIMEOUT);
+ * PoolMetrics::Snapshot snapshot = metrics->snapshot();
+ * std::cout << snapshot.histograms[PoolMetrics::QUERY].p99 << "us" << std::endl;
+ */
+class PoolMetrics
+{
+public:
+    /**
+     * @brief 延迟直方图的种类，单位都是微秒
+     */
+    enum Histogram
+    {
+        ACQUIRE_WAIT = 0,   // 借出连接的等待时间
+        QUERY,              // executeQuery的执行时间
+        UPDATE,             // executeUpdate的执行时间
+        TRANSACTION,        // beginTransaction/commit/rollback的执行时间
+        CONNECT,            // 建立连接的时间
+        PING,               // 检测连接的时间
+        HISTOGRAM_COUNT
+    };
+
+    /**
+     * @brief 计数器的种类
+     */
+    enum Counter
+    {
+        ACQUIRE_TIMEOUT = 0,    // 等待连接超时的次数
+        ACQUIRE_REJECTED,       // 被过载保护拒绝的次数
+        RECONNECT,              // 坏连接被淘汰、需要重新建立连接的次数
+        CONNECT_FAILURE,        // 建立连接失败的次数
+        ERROR_TOTAL,            // 执行失败的总次数，按照错误码的分布见Snapshot::errors
+        COUNTER_COUNT
+    };
+
+    static const unsigned int kSubBucketBits = 5;                       // 每个2的幂区间的桶数为2^5
+    static const size_t kSubBucketCount = 1u << kSubBucketBits;
+    static const size_t kBucketCount = (32 - kSubBucketBits + 1) * kSubBucketCount;    // 覆盖[0, 2^32)微秒
+
+    /**
+     * @brief 一个直方图的汇总结果
+     */
+    struct HistogramSnapshot
+    {
+        uint64_t count = 0;     // 记录次数
+        uint64_t sum = 0;       // 总和（微秒）
+        uint64_t max = 0;       // 最大值（微秒）
+        uint64_t p50 = 0;       // 分位数（微秒），桶内的最大值，不会低估
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+        std::vector<uint64_t> buckets;  // 每个桶的次数，边界见bucketUpperBound
+
+        /**
+         * @brief 平均值（微秒）
+         */
+        double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0.0; }
+
+        /**
+         * @brief 计算任意分位数
+         * @param quantile 0到1之间，例如0.99
+         */
+        uint64_t valueAt(double quantile) const;
+
+        /**
+         * @brief 由buckets计算count和各个分位数，sum和max需要已经填好
+         */
+        void summarize();
+    };
+
+    /**
+     * @brief 一个加锁位置的竞争统计（见profiled_mutex.h），单位是纳秒
+     */
+    struct LockSnapshot
+    {
+        const char *site = "";      // 加锁位置，例如"pool"
+        HistogramSnapshot wait;     // 等待时间
+        HistogramSnapshot hold;     // 持有时间
+        uint64_t contended = 0;     // 需要阻塞等待的次数
+    };
+
+    /**
+     * @brief 所有统计的汇总结果
+     */
+    struct Snapshot
+    {
+        HistogramSnapshot histograms[HISTOGRAM_COUNT];
+        uint64_t counters[COUNTER_COUNT] = {};
+        std::map<unsigned int, uint64_t> errors;    // mysql_errno -> 次数
+        std::vector<LockSnapshot> locks;            // 锁竞争统计，只有打开ENABLE_LOCK_PROFILING编译时才有
+    };
+
+    PoolMetrics();
+    ~PoolMetrics();
+
+    PoolMetrics(const PoolMetrics &) = delete;
+    PoolMetrics &operator=(const PoolMetrics &) = delete;
+
+    // =============================
+    // 记录方法，可以在任意线程中并发调用
+    // =============================
+
+    /**
+     * @brief 记录一次延迟
+     * @param micros 微秒，超过范围的记在最后一个桶
+     */
+    void record(Histogram histogram, uint64_t micros)
+    {
+        Shard &shard = localShard();
+        HistogramCells &cells = shard.histograms[histogram];
+        bump(cells.buckets[bucketIndex(micros)], 1);
+        bump(cells.sum, micros);
+        if (micros > cells.max.load(std::memory_order_relaxed))
+            cells.max.store(micros, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 计数器加n
+     */
+    void increment(Counter counter, uint64_t n = 1)
+    {
+        bump(localShard().counters[counter], n);
+    }
+
+    /**
+     * @brief 记录一次执行失败，同时增加ERROR_TOTAL
+     * @param errorCode mysql_errno
+     */
+    void recordError(unsigned int errorCode);
+
+    // =============================
+    // 读取方法
+    // =============================
+
+    /**
+     * @brief 合并所有线程的分片，得到当前的汇总结果
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief 直方图的名字，例如"acquire_wait"
+     */
+    static const char *histogramName(Histogram histogram);
+
+    /**
+     * @brief 计数器的名字，例如"acquire_timeout"
+     */
+    static const char *counterName(Counter counter);
+
+    /**
+     * @brief 值对应的桶：小于32的值每个值一个桶，之后每个2的幂区间均分为32个桶
+     */
+    static size_t bucketIndex(uint64_t micros)
+    {
+        if (micros < kSubBucketCount)
+            return static_cast<size_t>(micros);
+        if (micros >> 32)
+            return kBucketCount - 1;
+        unsigned int exponent = 63 - __builtin_clzll(micros);     // 最高位，至少为kSubBucketBits
+        unsigned int shift = exponent - kSubBucketBits;
+        return (shift + 1) * kSubBucketCount + static_cast<size_t>((micros >> shift) - kSubBucketCount);
+    }
+
+    /**
+     * @brief 桶内的最大值（包含）
+     */
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    /**
+     * @brief 一个直方图在一个分片中的计数
+     */
+    struct HistogramCells
+    {
+        std::atomic<uint64_t> buckets[kBucketCount];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    /**
+     * @brief 一个线程的分片，只有拥有它的线程写，其他线程只读
+     */
+    struct Shard
+    {
+        Shard();
+        HistogramCells histograms[HISTOGRAM_COUNT];
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+        std::atomic<bool> inUse;    // 是否有线程正在使用，线程退出时清除，之后可以分配给新的线程
+    };
+    using ShardPtr = std::shared_ptr<Shard>;
+
+    /**
+     * @brief 只有一个写者的计数，不需要原子读改写
+     */
+    static void bump(std::atomic<uint64_t> &cell, uint64_t n)
+    {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 得到当前线程的分片，第一次调用时分配
+     */
+    Shard &localShard()
+    {
+        // 绝大多数情况下命中这个缓存：同一个线程连续使用同一个统计对象
+        struct LastShard
+        {
+            uint64_t owner = 0;
+            Shard *shard = nullptr;
+        };
+        thread_local LastShard last;
+        if (last.owner == m_id)
+            return *last.shard;
+        Shard *shard = attachShard();
+        last.owner = m_id;
+        last.shard = shard;
+        return *shard;
+    }
+
+    /**
+     * @brief 为当前线程查找或者分配分片，优先复用已经退出的线程留下的分片
+     */
+    Shard *attachShard();
+
+private:
+    const uint64_t m_id;                // 全局唯一的编号，线程通过编号找到自己的分片，地址可能被复用，编号不会
+    mutable std::mutex m_mutex;         // 保护m_shards和m_errors
+    std::vector<ShardPtr> m_shards;     // 所有分片
+    std::map<unsigned int, uint64_t> m_errors;  // 错误码 -> 次数
+};
+
+// 类型别名，统计对象在连接池和它的所有连接之间共享
+using PoolMetricsPtr = std::shared_ptr<PoolMetrics>;
+
+#endif  // POOL_METRICS_H
@@ -0,0 +1,60 @@
+/**
+ * @brief 实现USDT静态探针，用于在生产环境中用bpftrace/perf观察连接池
+ */
+#ifndef POOL_PROBES_H
+#define POOL_PROBES_H
+
+/**
+ * @brief 连接池的USDT探针（provider为mysql_pool）
+ *
+ * 编译时打开CMake选项ENABLE_USDT（需要systemtap的sys/sdt.h）才会生成探针，否则所有宏都展开为空
+ *
+ * 探针及参数：
+ * 1）acquire(connection_id, wait_us, priority)：getConnection返回，connection_id为空字符串表示没有借到
+ * 2）release(connection_id, hold_us)：连接归还
+ * 3）query_start(connection_id, sql) / query_end(connection_id, latency_us, errno)：executeQuery/executeUpdate
+ * 4）connect(connection_id, latency_us, errno)：建立连接
+ * 5）reconnect(connection_id)：坏连接被淘汰
+ * 6）log(level, message)：Logger写入一条日志
+ *
+ * 零开销：探针本身是一条nop；需要额外计算的参数（读取时钟）使用信号量判断，
+ * 只有bpftrace等工具挂载了这个探针时信号量才不为0，没有挂载时只是一次内存读取
+ *
+ * 使用示例：
+ * bpftrace -e 'usdt:./lib/libdbconnectionpool.so:mysql_pool:query_end { @us = hist(arg1); }'
+ * bpftrace -e 'usdt:./lib/libdbconnectionpool.so:mysql_pool:acquire /arg1 > 10000/ { printf("%s waited %dus\n", str(arg0), arg1); }'
+ */
+#ifdef MYSQL_POOL_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define POOL_PROBE_SEMAPHORE(name) mysql_pool_##name##_semaphore
+
+extern "C"
+{
+    extern unsigned short POOL_PROBE_SEMAPHORE(acquire);
+    extern unsigned short POOL_PROBE_SEMAPHORE(release);
+    extern unsigned short POOL_PROBE_SEMAPHORE(query_start);
+    extern unsigned short POOL_PROBE_SEMAPHORE(query_end);
+    extern unsigned short POOL_PROBE_SEMAPHORE(connect);
+    extern unsigned short POOL_PROBE_SEMAPHORE(reconnect);
+    extern unsigned short POOL_PROBE_SEMAPHORE(log);
+}
+
+// 探针是否被挂载
+#define POOL_PROBE_ENABLED(name) __builtin_expect(POOL_PROBE_SEMAPHORE(name) != 0, 0)
+#define POOL_PROBE1(name, a) STAP_PROBE1(mysql_pool, name, a)
+#define POOL_PROBE2(name, a, b) STAP_PROBE2(mysql_pool, name, a, b)
+#define POOL_PROBE3(name, a, b, c) STAP_PROBE3(mysql_pool, name, a, b, c)
+
+#else
+
+#define POOL_PROBE_ENABLED(name) false
+#define POOL_PROBE1(name, a) do {} while (0)
+#define POOL_PROBE2(name, a, b) do {} while (0)
+#define POOL_PROBE3(name, a, b, c) do {} while (0)
+
+#endif  // MYSQL_POOL_USDT
+
+#endif  // POOL_PROBES_H
@@ -0,0 +1,181 @@
+/**
+ * @brief 实现锁竞争分析模式：记录每个加锁位置的等待时间和持有时间
+ */
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "pool_metrics.h"
+
+/**
+ * @brief 被分析的加锁位置
+ */
+enum class LockSite
+{
+    POOL = 0,       // ConnectionPool::m_mutex
+    CONNECTION,     // Connection::m_mutex（所有连接合计）
+    LOGGER,         // Logger::m_mutex
+    COUNT
+};
+
+/**
+ * @brief 锁竞争统计，进程内唯一
+ *
+ * 每个加锁位置两个直方图（纳秒）：等待时间（从请求加锁到拿到锁）和持有时间（从拿到锁到解锁），
+ * 分桶方式与PoolMetrics相同；另外记录需要阻塞等待的次数。
+ * 通过PoolMetrics::snapshot()的locks读取，只有打开CMake选项ENABLE_LOCK_PROFILING编译时才有数据
+ *
+ * 写入按照线程分散到多个条带上，减少统计本身在同一个缓存行上的竞争，避免干扰被测量的锁
+ */
+class LockProfiler
+{
+public:
+    static LockProfiler &instance();
+
+    /**
+     * @brief 记录一次加锁
+     * @param waitNanos 等待时间（纳秒），没有阻塞时为0
+     * @param holdNanos 持有时间（纳秒）
+     * @param contended 是否阻塞等待过
+     */
+    void record(LockSite site, uint64_t waitNanos, uint64_t holdNanos, bool contended);
+
+    /**
+     * @brief 所有加锁位置的汇总结果
+     */
+    std::vector<PoolMetrics::LockSnapshot> snapshot() const;
+
+    /**
+     * @brief 加锁位置的名字，例如"pool"
+     */
+    static const char *siteName(LockSite site);
+
+private:
+    LockProfiler() = default;
+    LockProfiler(const LockProfiler &) = delete;
+    LockProfiler &operator=(const LockProfiler &) = delete;
+
+    static const size_t kStripeCount = 8;
+
+    /**
+     * @brief 一个直方图的计数
+     */
+    struct Cells
+    {
+        std::atomic<uint64_t> buckets[PoolMetrics::kBucketCount];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    /**
+     * @brief 一个加锁位置在一个条带上的统计
+     */
+    struct Stripe
+    {
+        Cells wait;
+        Cells hold;
+        std::atomic<uint64_t> contended;
+    };
+
+    // 静态存储期的对象在构造之前已经被清零，std::atomic不需要再初始化
+    Stripe m_stripes[static_cast<size_t>(LockSite::COUNT)][kStripeCount];
+};
+
+/**
+ * @brief 记录等待时间和持有时间的互斥锁，满足Lockable的要求，可以配合lock_guard、unique_lock、condition_variable_any使用
+ * @tparam Mutex 被包装的互斥锁，std::mutex或者std::recursive_mutex
+ * @tparam Site 加锁位置
+ *
+ * 没有竞争时先try_lock成功，只读取两次时钟（拿到锁、解锁）；重入的加锁不单独计数
+ */
+template <typename Mutex, LockSite Site>
+class ProfiledMutex
+{
+public:
+    ProfiledMutex() : m_depth(0), m_wait(0), m_contended(false) {}
+
+    ProfiledMutex(const ProfiledMutex &) = delete;
+    ProfiledMutex &operator=(const ProfiledMutex &) = delete;
+
+    void lock()
+    {
+        if (m_mutex.try_lock())
+        {
+            onAcquired(Clock::time_point(), false);
+            return;
+        }
+        Clock::time_point start = Clock::now();
+        m_mutex.lock();
+        onAcquired(start, true);
+    }
+
+    bool try_lock()
+    {
+        if (!m_mutex.try_lock())
+            return false;
+        onAcquired(Clock::time_point(), false);
+        return true;
+    }
+
+    void unlock()
+    {
+        if (--m_depth > 0)
+        {
+            m_mutex.unlock();
+            return;
+        }
+        // 持有锁时读出本次的数据，解锁之后再写统计，不延长临界区
+        uint64_t hold = nanosBetween(m_acquired, Clock::now());
+        uint64_t wait = m_wait;
+        bool contended = m_contended;
+        m_mutex.unlock();
+        LockProfiler::instance().record(Site, wait, hold, contended);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static uint64_t nanosBetween(Clock::time_point from, Clock::time_point to)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+    }
+
+    /**
+     * @brief 拿到锁之后调用，以下成员只由持有锁的线程读写
+     */
+    void onAcquired(Clock::time_point start, bool contended)
+    {
+        if (m_depth++ > 0)
+            return;
+        m_acquired = Clock::now();
+        m_wait = contended ? nanosBetween(start, m_acquired) : 0;
+        m_contended = contended;
+    }
+
+    Mutex m_mutex;
+    unsigned int m_depth;           // 重入深度，只对recursive_mutex有意义
+    Clock::time_point m_acquired;   // 最外层拿到锁的时间
+    uint64_t m_wait;                // 最外层加锁的等待时间（纳秒）
+    bool m_contended;               // 最外层加锁是否阻塞过
+};
+
+// 连接池、连接和日志器使用的锁类型，只有打开ENABLE_LOCK_PROFILING编译时才记录
+#ifdef MYSQL_POOL_LOCK_PROFILING
+using PoolMutex = ProfiledMutex<std::mutex, LockSite::POOL>;
+using PoolConditionVariable = std::condition_variable_any;
+using ConnectionMutex = ProfiledMutex<std::recursive_mutex, LockSite::CONNECTION>;
+using LoggerMutex = ProfiledMutex<std::mutex, LockSite::LOGGER>;
+#else
+using PoolMutex = std::mutex;
+using PoolConditionVariable = std::condition_variable;
+using ConnectionMutex = std::recursive_mutex;
+using LoggerMutex = std::mutex;
+#endif  // MYSQL_POOL_LOCK_PROFILING
+
+#endif  // PROFILED_MUTEX_H
@@ -0,0 +1,44 @@
+/**
+ * @brief 实现连接池状态到Prometheus文本格式的导出
+ */
+#ifndef PROMETHEUS_EXPORTER_H
+#define PROMETHEUS_EXPORTER_H
+
+#include <string>
+#include <cstdint>
+
+class ConnectionPool;
+
+/**
+ * @brief 把连接池的状态和性能统计输出为Prometheus文本格式（0.0.4）
+ *
+ * 输出的指标：
+ * 1）mysql_pool_connections{instance,state}：每个数据库实例的空闲、借出、总连接数
+ * 2）mysql_pool_waiters、mysql_pool_target_connections：等待的线程数和当前允许的连接数上限
+ * 3）mysql_pool_<计数器>_total：超时、拒绝、重连、建立连接失败、轮换、会话重置等次数，
+ *    mysql_pool_errors_total{errno}按照错误码分别计数
+ * 4）mysql_pool_<直方图>_seconds：借出等待、查询、更新、事务、建立连接、检测连接的延迟，
+ *    使用固定的桶边界（100微秒到10秒），由内部的对数线性分桶合并而来
+ *
+ * 只追加到调用者提供的缓冲区，数值直接格式化到栈上的数组，
+ * 缓冲区在多次抓取之间复用时，除了读取统计本身不会再分配内存
+ *
+ * 使用示例：
+ * std::string body;
+ * PrometheusExporter::render(pool, body);
+ * // mysql_pool_connections{instance="root@localhost:3306/test",state="idle"} 4
+ */
+namespace PrometheusExporter
+{
+    /**
+     * @brief 把连接池的指标追加到out的末尾
+     */
+    void render(const ConnectionPool &pool, std::string &out);
+
+    /**
+     * @brief 追加转义后的标签值：反斜杠、双引号、换行
+     */
+    void appendLabelValue(std::string &out, const std::string &value);
+}   // namespace PrometheusExporter
+
+#endif  // PROMETHEUS_EXPORTER_H
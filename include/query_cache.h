@@ -0,0 +1,149 @@
+/**
+ * @brief 实现查询结果缓存
+ */
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include "columnar_result.h"
+
+/**
+ * @brief 查询结果缓存，缓存的是不可变的按列存储结果
+ *
+ * 设计特点：
+ * 1）键是规范化之后的SQL：去掉首尾空白和结尾的分号，引号之外的连续空白合并为一个空格
+ * 2）值是ColumnarResultPtr：构造完成后只读，命中时多个线程直接共享同一份结果，不产生拷贝
+ * 3）过期时间（TTL）+ 内存预算：超出预算时按照LRU淘汰
+ * 4）按表失效：缓存时记录SELECT用到的表，写操作按表名让相关的结果失效
+ * 5）代数（generation）：查询开始前读取代数，写入缓存时代数变化说明期间有表失效，结果直接丢弃，
+ *    避免“先读到旧数据、后写入缓存”把已经失效的数据重新放回缓存
+ *
+ * 注意：表名是从SQL中解析出来的，覆盖FROM/JOIN/INTO/UPDATE/TABLE之后的表，
+ * 存储过程、视图、触发器间接修改的表无法识别，这类数据依靠TTL兜底
+ *
+ * 使用示例：
+ * auto cache = std::make_shared<QueryCache>(64 * 1024 * 1024, 5000);
+ * conn.setQueryCache(cache);
+ * ColumnarResultPtr flags = conn.executeCachedQuery("SELECT name, enabled FROM feature_flags");
+ * conn.executeUpdate("UPDATE feature_flags SET enabled = 0 WHERE name = 'x'");  // 自动让feature_flags相关的缓存失效
+ */
+class QueryCache
+{
+public:
+    /**
+     * @brief 缓存的统计信息
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;          // 命中次数
+        uint64_t misses = 0;        // 未命中次数（包括过期）
+        uint64_t evictions = 0;     // 因为内存预算被淘汰的条目数
+        uint64_t invalidations = 0; // 因为表失效被删除的条目数
+        size_t entries = 0;         // 当前条目数
+        size_t memoryUsage = 0;     // 当前占用的内存字节数
+    };
+
+    /**
+     * @brief 构造函数
+     * @param maxMemoryBytes 内存预算（字节），超过时按照LRU淘汰
+     * @param ttlMs 条目的存活时间（毫秒）
+     */
+    QueryCache(size_t maxMemoryBytes, int64_t ttlMs);
+
+    QueryCache(const QueryCache &) = delete;
+    QueryCache &operator=(const QueryCache &) = delete;
+
+    /**
+     * @brief 查找缓存
+     * @return 命中且没有过期时返回结果，否则返回nullptr
+     */
+    ColumnarResultPtr get(const std::string &sql);
+
+    /**
+     * @brief 得到当前的代数，查询开始之前调用，并把返回值传给put
+     */
+    uint64_t getGeneration() const;
+
+    /**
+     * @brief 写入缓存
+     * @param sql 查询语句
+     * @param result 查询结果
+     * @param generation 查询开始前通过getGeneration得到的代数，期间发生过失效则不会写入
+     * @return 是否写入了缓存（结果超过整个内存预算、或者代数已经变化时不会写入）
+     */
+    bool put(const std::string &sql, ColumnarResultPtr result, uint64_t generation);
+
+    /**
+     * @brief 让所有用到指定表的缓存失效，表名不区分大小写，db.table只按照table匹配
+     */
+    void invalidateTable(const std::string &table);
+
+    /**
+     * @brief 让SQL语句涉及的所有表的缓存失效，无法解析出表名时清空整个缓存
+     * Connection::executeUpdate会自动调用
+     */
+    void invalidateStatement(const std::string &sql);
+
+    /**
+     * @brief 清空缓存
+     */
+    void clear();
+
+    /**
+     * @brief 得到统计信息
+     */
+    Stats getStats() const;
+
+    /**
+     * @brief 规范化SQL，作为缓存的键
+     */
+    static std::string normalizeSql(const std::string &sql);
+
+    /**
+     * @brief 解析SQL中涉及的表名（小写，去掉反引号和库名），结果已经去重
+     */
+    static std::vector<std::string> extractTables(const std::string &sql);
+
+private:
+    /**
+     * @brief 缓存条目
+     */
+    struct Entry
+    {
+        std::string key;                    // 规范化之后的SQL
+        ColumnarResultPtr result;           // 查询结果
+        std::vector<std::string> tables;    // 用到的表
+        int64_t expireAt;                   // 过期时间（毫秒）
+        size_t memory;                      // 占用的内存字节数
+    };
+    using EntryList = std::list<Entry>;
+
+    /**
+     * @brief 删除一个条目，同时维护表索引和内存统计，调用者需要持有锁
+     */
+    void removeEntry(EntryList::iterator it);
+
+private:
+    const size_t m_maxMemoryBytes;                  // 内存预算
+    const int64_t m_ttlMs;                          // 存活时间
+
+    mutable std::mutex m_mutex;                     // 保护以下所有成员
+    EntryList m_lru;                                // 最近使用的在前面
+    std::unordered_map<std::string, EntryList::iterator> m_entries;             // 键 -> 条目
+    std::unordered_map<std::string, std::unordered_set<std::string>> m_tables; // 表 -> 用到该表的键
+    size_t m_memoryUsage;                           // 当前占用的内存
+    uint64_t m_generation;                          // 每次失效都会加1
+    Stats m_stats;                                  // 统计信息
+};
+
+// 类型别名，缓存会在多个连接之间共享
+using QueryCachePtr = std::shared_ptr<QueryCache>;
+
+#endif  // QUERY_CACHE_H
@@ -7,6 +7,8 @@
 #include <stdexcept>
 #include <mysql/mysql.h>
 #include "logger.h"
+#include "row_mapping.h"
+#include "columnar_result.h"
 
 /**
  * @brief MySQL查询结果封装类
@@ -186,6 +188,26 @@ public:
      */
     bool isNull(const std::string &fieldName) const;
 
+    // =============================
+    // 原始数据访问方法（不产生拷贝，用于序列化等对性能敏感的场景）
+    // =============================
+
+    /**
+     * @brief 获取当前行指定索引的原始字节
+     * @param index 字段索引
+     * @param length 输出参数，字段值的字节数
+     * @return 字段值的指针（以'\0'结尾），NULL值返回nullptr
+     * @throws std::out_of_range 索引超出范围
+     * @throws std::runtime_error 当前行无效
+     */
+    const char *getRawValue(unsigned int index, unsigned long &length) const;
+
+    /**
+     * @brief 获取所有字段的元数据（类型、标志、字符集等）
+     * @return MYSQL_FIELD数组，长度为getFieldCount()；非查询操作返回nullptr
+     */
+    const MYSQL_FIELD *getFields() const;
+
     // =============================
     // 便利方法
     // =============================
@@ -202,6 +224,48 @@ public:
      */
     bool hasResultSet() const;
 
+    // =============================
+    // 结构体映射方法
+    // =============================
+
+    /**
+     * @brief 把结果集的所有行解码为结构体T的向量
+     * @return 每一行对应一个T，NULL值对应的成员保持默认值
+     * @throws std::runtime_error 如果不是查询操作的结果
+     * @throws std::out_of_range 如果RowMapping<T>中声明的列名不在结果集中
+     *
+     * 列名到列索引的映射在每个结果集中只解析一次，之后每个单元格直接从MYSQL_ROW解码到成员，
+     * 不会经过getString/getInt的按名查找和中间字符串
+     * 注意：会从第一行开始读取，调用结束后游标位于结果集末尾
+     *
+     * 使用示例：
+     * DB_ROW_MAPPING(User, DB_COLUMN(User, id), DB_COLUMN(User, name))
+     * std::vector<User> users = conn.executeQuery("SELECT id, name FROM users")->fetchAll<User>();
+     */
+    template <typename T>
+    std::vector<T> fetchAll();
+
+    /**
+     * @brief 把结果集转换为按列存储的形式
+     * @return 每一列的值连续存储的ColumnarResult
+     * @throws std::runtime_error 如果不是查询操作的结果
+     *
+     * 只遍历一次MYSQL_RES，根据MYSQL_FIELD的类型把整数、浮点数解码到连续的数组中，
+     * 字符串存储为偏移数组 + 字节数组，适合下游做聚合计算
+     * 注意：会从第一行开始读取，调用结束后游标重置到结果集开头
+     */
+    ColumnarResult toColumns();
+
+    /**
+     * @brief 从当前游标位置开始，把最多maxRows行转换为按列存储的形式
+     * @param maxRows 本批最多读取的行数
+     * @return 本批的ColumnarResult，行数为0表示已经读完
+     * @throws std::runtime_error 如果不是查询操作的结果
+     *
+     * 用于分批处理大结果集（例如按批导出Arrow记录批次），调用之后需要重新调用next()才能按行访问
+     */
+    ColumnarResult nextColumns(size_t maxRows);
+
 private:
     /**
      * @brief 初始化元数据信息
@@ -260,6 +324,39 @@ private:
     std::vector<std::string> m_fieldNames;  // 字段名列表
 };
 
+// =============================
+// 模板成员函数的实现，必须放在头文件中
+// =============================
+template <typename T>
+std::vector<T> QueryResult::fetchAll()
+{
+    if (!m_result)
+        throw std::runtime_error("this is non-select operation, cannot fetchAll");
+
+    auto columns = RowMapping<T>::columns();
+    constexpr size_t columnCount = std::tuple_size<decltype(columns)>::value;
+    static_assert(columnCount > 0, "RowMapping must bind at least one column");
+    using Indices = std::make_index_sequence<columnCount>;
+
+    // 1. 每个结果集只解析一次列索引
+    unsigned int indices[columnCount];
+    RowMappingDetail::resolveIndices(columns, indices, [this](const char *name) {
+        return getFieldIndex(name);
+    }, Indices{});
+
+    // 2. 逐行直接解码到结构体中
+    std::vector<T> rows;
+    rows.reserve(static_cast<size_t>(m_rowCount));
+    reset();
+    while (next())
+    {
+        rows.emplace_back();
+        RowMappingDetail::decodeRow(columns, indices, m_currentRow, m_lengths, rows.back(), Indices{});
+    }
+
+    return rows;
+}
+
 // 类型别名，智能指针类型定义
 using QueryResultPtr = std::shared_ptr<QueryResult>;
 
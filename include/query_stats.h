@@ -0,0 +1,117 @@
+/**
+ * @brief 实现按照SQL指纹的执行统计
+ */
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief 按照SQL指纹汇总执行次数和耗时，只保留消耗时间最多的若干条
+ *
+ * 设计特点：
+ * 1）指纹：一遍扫描完成规范化，字面量（字符串、数字、十六进制）替换为?，注释去掉，
+ *    连续空白合并为一个空格，关键字和标识符转为小写（反引号中的保持不变），
+ *    IN列表和多行VALUES合并为一个?和一行，参数个数不同的同一语句得到同一个指纹
+ * 2）有界：最多保留capacity个指纹，满了以后按照加权Space-Saving算法淘汰总耗时最少的指纹，
+ *    新指纹继承被淘汰者的总耗时（记在overestimate中），真正消耗时间多的语句不会被挤出去
+ * 3）分段加锁：按照指纹的哈希值分为16段，规范化在锁外完成，并发执行的语句很少竞争同一把锁
+ *
+ * 只统计执行成功的语句，失败的语句见PoolMetrics的错误统计
+ *
+ * 使用示例：
+ * auto stats = std::make_shared<QueryStats>(256);
+ * conn.setQueryStats(stats);
+ * conn.executeQuery("SELECT * FROM users WHERE id = 42");
+ * for (const QueryStats::Entry &entry : stats->top(10))
+ *     std::cout << entry.fingerprint << " " << entry.calls << " " << entry.totalMicros << "us" << std::endl;
+ * // select * from users where id = ? 1 350us
+ */
+class QueryStats
+{
+public:
+    /**
+     * @brief 一个指纹的统计
+     */
+    struct Entry
+    {
+        std::string fingerprint;        // 规范化之后的SQL
+        uint64_t hash = 0;              // 指纹的哈希值
+        uint64_t calls = 0;             // 执行次数
+        uint64_t totalMicros = 0;       // 总耗时（微秒），包含overestimate
+        uint64_t maxMicros = 0;         // 最大耗时（微秒）
+        uint64_t rows = 0;              // 查询返回的总行数
+        uint64_t affectedRows = 0;      // 更新影响的总行数
+        uint64_t overestimate = 0;      // 从被淘汰的指纹继承的耗时，totalMicros的误差上限
+
+        /**
+         * @brief 平均耗时（微秒），不包含继承的耗时
+         */
+        double meanMicros() const
+        {
+            return calls > 0 ? static_cast<double>(totalMicros - overestimate) / calls : 0.0;
+        }
+    };
+
+    /**
+     * @brief 构造函数
+     * @param capacity 最多保留的指纹数量
+     */
+    explicit QueryStats(size_t capacity);
+
+    QueryStats(const QueryStats &) = delete;
+    QueryStats &operator=(const QueryStats &) = delete;
+
+    /**
+     * @brief 记录一次执行成功的语句，可以在任意线程中并发调用
+     * @param sql 原始SQL
+     * @param micros 耗时（微秒）
+     * @param rows 返回的行数
+     * @param affectedRows 影响的行数
+     */
+    void record(const std::string &sql, uint64_t micros, uint64_t rows, uint64_t affectedRows);
+
+    /**
+     * @brief 总耗时最多的n个指纹，按照总耗时从多到少排列
+     */
+    std::vector<Entry> top(size_t n) const;
+
+    /**
+     * @brief 清空所有统计
+     */
+    void clear();
+
+    /**
+     * @brief 计算SQL的指纹
+     * @param sql 原始SQL
+     * @param out 输出规范化之后的SQL，先被清空，可以复用同一个缓冲区
+     * @return 指纹的64位哈希值
+     */
+    static uint64_t fingerprint(const std::string &sql, std::string &out);
+
+private:
+    static const size_t kSegmentCount = 16;
+
+    /**
+     * @brief 一段统计，由自己的互斥锁保护
+     */
+    struct Segment
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, Entry> entries;   // 哈希值 -> 统计
+    };
+
+    size_t m_segmentCapacity;           // 每段最多保留的指纹数量
+    Segment m_segments[kSegmentCount];
+};
+
+// 类型别名，统计对象在连接池和它的所有连接之间共享
+using QueryStatsPtr = std::shared_ptr<QueryStats>;
+
+#endif  // QUERY_STATS_H
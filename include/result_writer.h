@@ -0,0 +1,138 @@
+/**
+ * @brief 实现查询结果到JSON/CSV的高速序列化
+ */
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include "query_result.h"
+
+/**
+ * @brief 序列化输出的目的地，例如HTTP响应体、socket、文件
+ * 每次写入的都是一个完整的数据块，实现者不需要再做缓冲
+ */
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+
+    /**
+     * @brief 写入一块数据
+     */
+    virtual void write(const char *data, size_t length) = 0;
+};
+
+/**
+ * @brief 输出到std::string的Sink，字符串可以复用
+ */
+class StringSink : public OutputSink
+{
+public:
+    explicit StringSink(std::string &out) : m_out(out) {}
+
+    void write(const char *data, size_t length) override
+    {
+        m_out.append(data, length);
+    }
+
+private:
+    std::string &m_out;
+};
+
+/**
+ * @brief 分块输出缓冲区
+ *
+ * 所有小的写入先放到固定大小的块中，块写满之后才一次性交给Sink，
+ * 避免每个单元格都调用一次虚函数，也避免每个单元格都产生一次内存分配
+ */
+class ChunkedWriter
+{
+public:
+    static const size_t kChunkSize = 64 * 1024;     // 每块64KB
+
+    explicit ChunkedWriter(OutputSink &sink);
+
+    /**
+     * @brief 析构时会自动flush
+     */
+    ~ChunkedWriter();
+
+    ChunkedWriter(const ChunkedWriter &) = delete;
+    ChunkedWriter &operator=(const ChunkedWriter &) = delete;
+
+    /**
+     * @brief 写入数据，大块数据直接交给Sink
+     */
+    void write(const char *data, size_t length)
+    {
+        if (length <= kChunkSize - m_pos)
+        {
+            std::memcpy(m_chunk.get() + m_pos, data, length);
+            m_pos += length;
+            return;
+        }
+        writeSlow(data, length);
+    }
+
+    void put(char c)
+    {
+        if (m_pos == kChunkSize)
+            flush();
+        m_chunk[m_pos++] = c;
+    }
+
+    /**
+     * @brief 把当前块交给Sink
+     */
+    void flush();
+
+private:
+    void writeSlow(const char *data, size_t length);
+
+private:
+    OutputSink &m_sink;                 // 输出目的地
+    std::unique_ptr<char[]> m_chunk;    // 当前块，放在堆上，避免占用线程栈
+    size_t m_pos;                       // 当前块已经写入的字节数
+};
+
+/**
+ * @brief 查询结果的序列化函数
+ *
+ * 设计特点：
+ * 1）零拷贝读取：直接从MYSQL_ROW和每行的长度数组读取原始字节，不调用getString
+ * 2）类型感知：数值类型（整数、浮点数、DECIMAL）直接输出原始文本，不加引号
+ * 3）SIMD转义：每次扫描16/32字节，没有需要转义的字符时整体拷贝
+ *
+ * 使用示例：
+ * std::string body;
+ * StringSink sink(body);
+ * ResultWriter::writeJson(*conn.executeQuery("SELECT id, name FROM users"), sink);
+ * // body = [{"id":1,"name":"张三"},{"id":2,"name":null}]
+ */
+namespace ResultWriter
+{
+    /**
+     * @brief 序列化为JSON对象数组，NULL输出为null
+     * @param result 查询结果，从第一行开始读取，结束后游标重置到开头
+     * @throws std::runtime_error 如果不是查询操作的结果
+     */
+    void writeJson(QueryResult &result, OutputSink &sink);
+
+    /**
+     * @brief 序列化为RFC 4180格式的CSV，第一行是列名
+     * NULL输出为空字段，空字符串输出为""，以便区分
+     * @param result 查询结果，从第一行开始读取，结束后游标重置到开头
+     * @throws std::runtime_error 如果不是查询操作的结果
+     */
+    void writeCsv(QueryResult &result, OutputSink &sink);
+
+    /**
+     * @brief 判断字段是否为数值类型（JSON中不加引号）
+     */
+    bool isNumericField(const MYSQL_FIELD &field);
+}   // namespace ResultWriter
+
+#endif  // RESULT_WRITER_H
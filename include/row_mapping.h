@@ -0,0 +1,144 @@
+/**
+ * @brief 实现结果集到结构体的编译期列绑定
+ */
+#ifndef ROW_MAPPING_H
+#define ROW_MAPPING_H
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <cstdlib>
+#include <type_traits>
+#include <initializer_list>
+
+/**
+ * @brief 一列的绑定关系：列名 + 结构体的成员指针
+ */
+template <typename T, typename M>
+struct ColumnBinding
+{
+    const char *name;   // 结果集中的列名
+    M T::*member;       // 对应的结构体成员
+};
+
+/**
+ * @brief 创建列绑定，成员类型由编译器推导
+ */
+template <typename T, typename M>
+constexpr ColumnBinding<T, M> bindColumn(const char *name, M T::*member)
+{
+    return ColumnBinding<T, M>{name, member};
+}
+
+/**
+ * @brief 结构体的列映射声明，需要为每个结构体特化，提供返回ColumnBinding元组的columns()
+ *
+ * 一般使用下面的宏来声明，不需要手写特化：
+ * struct User
+ * {
+ *     int id;
+ *     std::string name;
+ *     long long age;
+ * };
+ * DB_ROW_MAPPING(User, DB_COLUMN(User, id), DB_COLUMN(User, name), DB_COLUMN_AS(User, age, "user_age"))
+ *
+ * auto users = result->fetchAll<User>();
+ */
+template <typename T>
+struct RowMapping;
+
+/**
+ * @brief 列名与成员名相同
+ */
+#define DB_COLUMN(Type, member) bindColumn(#member, &Type::member)
+
+/**
+ * @brief 列名与成员名不同
+ */
+#define DB_COLUMN_AS(Type, member, column) bindColumn(column, &Type::member)
+
+/**
+ * @brief 声明结构体的列映射，必须在全局命名空间中使用
+ */
+#define DB_ROW_MAPPING(Type, ...)                            \
+    template <>                                              \
+    struct RowMapping<Type>                                  \
+    {                                                        \
+        static auto columns()                                \
+        {                                                    \
+            return std::make_tuple(__VA_ARGS__);             \
+        }                                                    \
+    };
+
+/**
+ * @brief 列映射的内部实现，使用者不需要关心
+ */
+namespace RowMappingDetail
+{
+    // =============================
+    // 单元格解码：直接从MYSQL_ROW的原始字节解码到成员，不产生中间字符串
+    // MySQL文本协议中每个字段都以'\0'结尾，因此可以直接使用strtoxx
+    // =============================
+
+    template <typename M>
+    typename std::enable_if<std::is_integral<M>::value && std::is_signed<M>::value>::type
+    decodeCell(const char *data, unsigned long, M &dst)
+    {
+        dst = static_cast<M>(std::strtoll(data, nullptr, 10));
+    }
+
+    template <typename M>
+    typename std::enable_if<std::is_integral<M>::value && std::is_unsigned<M>::value && !std::is_same<M, bool>::value>::type
+    decodeCell(const char *data, unsigned long, M &dst)
+    {
+        dst = static_cast<M>(std::strtoull(data, nullptr, 10));
+    }
+
+    inline void decodeCell(const char *data, unsigned long length, bool &dst)
+    {
+        // TINYINT(1)/BIT(1)：'0'为false；BIT类型返回的是原始字节
+        dst = length > 0 && data[0] != '0' && data[0] != '\0';
+    }
+
+    template <typename M>
+    typename std::enable_if<std::is_floating_point<M>::value>::type
+    decodeCell(const char *data, unsigned long, M &dst)
+    {
+        dst = static_cast<M>(std::strtod(data, nullptr));
+    }
+
+    inline void decodeCell(const char *data, unsigned long length, std::string &dst)
+    {
+        // assign可以复用dst已有的容量
+        dst.assign(data, length);
+    }
+
+    /**
+     * @brief 根据列名解析每个绑定对应的列索引，每个结果集只需要解析一次
+     */
+    template <typename Tuple, typename Resolver, size_t... I>
+    void resolveIndices(const Tuple &columns, unsigned int *indices, Resolver &&resolve, std::index_sequence<I...>)
+    {
+        (void)std::initializer_list<int>{(indices[I] = resolve(std::get<I>(columns).name), 0)...};
+    }
+
+    /**
+     * @brief 解码一行：NULL值保持成员的默认值
+     */
+    template <typename T, typename M>
+    void decodeColumn(const ColumnBinding<T, M> &binding, const char *data, unsigned long length, T &row)
+    {
+        if (data != nullptr)
+            decodeCell(data, length, row.*(binding.member));
+    }
+
+    template <typename T, typename Tuple, size_t... I>
+    void decodeRow(const Tuple &columns, const unsigned int *indices, char **values,
+                   const unsigned long *lengths, T &row, std::index_sequence<I...>)
+    {
+        (void)std::initializer_list<int>{
+            (decodeColumn(std::get<I>(columns), values[indices[I]], lengths[indices[I]], row), 0)...};
+    }
+}   // namespace RowMappingDetail
+
+#endif  // ROW_MAPPING_H
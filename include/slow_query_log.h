@@ -0,0 +1,135 @@
+/**
+ * @brief 实现慢查询日志
+ */
+#ifndef SLOW_QUERY_LOG_H
+#define SLOW_QUERY_LOG_H
+
+#include <string>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief 一条慢查询记录
+ */
+struct SlowQuery
+{
+    int64_t timestamp = 0;      // 执行结束的时间（毫秒时间戳）
+    uint64_t micros = 0;        // 耗时（微秒）
+    std::string connectionId;   // 执行语句的连接
+    uint64_t rows = 0;          // 返回的行数
+    uint64_t affectedRows = 0;  // 影响的行数
+    std::string sql;            // SQL，超过maxSqlLength时被截断
+    bool truncated = false;     // SQL是否被截断
+};
+
+/**
+ * @brief 慢查询日志：耗时超过阈值的语句按照采样率写入专用的日志文件
+ *
+ * 设计特点：
+ * 1）快速路径只有一次比较：isSlow是内联的，没有超过阈值的语句不会进入日志的任何其他代码
+ * 2）异步写入：执行语句的线程只把记录放入有界队列，由后台线程格式化并写入文件，
+ *    不经过同步的Logger，也不在执行语句的线程中做磁盘IO；队列满时丢弃新的记录并计数
+ * 3）采样：慢查询集中爆发时按照sampleRate只记录一部分，采样使用线程内的随机数，不竞争同一个变量
+ * 4）SQL截断：只保留前maxSqlLength个字节，0表示不记录SQL
+ *
+ * 日志格式（每条一行）：
+ * 2026-10-17 01:42:21.657 duration=12.345ms connection=... rows=5 affected=0 sql=SELECT ...
+ *
+ * 使用示例：
+ * auto slowLog = std::make_shared<SlowQueryLog>("./slow_query.log", 100 * 1000, 1.0, 1024);
+ * conn.setSlowQueryLog(slowLog);
+ */
+class SlowQueryLog
+{
+public:
+    /**
+     * @brief 构造函数，打开日志文件并启动后台写入线程
+     * @param filePath 日志文件路径，追加写入
+     * @param thresholdMicros 耗时达到这个值（微秒）的语句是慢查询
+     * @param sampleRate 慢查询被记录的比例，(0, 1]
+     * @param maxSqlLength SQL最多保留的字节数，0表示不记录SQL
+     * @param queueCapacity 等待写入的记录数上限
+     * @throws std::runtime_error 如果日志文件无法打开
+     */
+    SlowQueryLog(const std::string &filePath, uint64_t thresholdMicros, double sampleRate,
+                 size_t maxSqlLength, size_t queueCapacity = 4096);
+
+    /**
+     * @brief 析构函数，写完队列中剩余的记录后退出后台线程
+     */
+    ~SlowQueryLog();
+
+    SlowQueryLog(const SlowQueryLog &) = delete;
+    SlowQueryLog &operator=(const SlowQueryLog &) = delete;
+
+    /**
+     * @brief 是否是慢查询
+     */
+    bool isSlow(uint64_t micros) const { return micros >= m_thresholdMicros; }
+
+    /**
+     * @brief 提交一条慢查询，按照采样率决定是否记录，可以在任意线程中并发调用
+     */
+    void submit(uint64_t micros, const std::string &connectionId, uint64_t rows, uint64_t affectedRows,
+                const std::string &sql);
+
+    /**
+     * @brief 等待已经提交的记录全部写入文件
+     */
+    void flush();
+
+    /**
+     * @brief 写入文件的记录数
+     */
+    uint64_t getWrittenCount() const { return m_written.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因为队列已满被丢弃的记录数
+     */
+    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 因为采样没有被记录的慢查询数
+     */
+    uint64_t getSampledOutCount() const { return m_sampledOut.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * @brief 后台线程：取出记录、格式化、写入文件
+     */
+    void writerLoop();
+
+    /**
+     * @brief 把一条记录格式化为一行
+     */
+    static void format(const SlowQuery &record, std::string &line);
+
+private:
+    const uint64_t m_thresholdMicros;   // 慢查询阈值（微秒）
+    const uint32_t m_sampleThreshold;   // 采样：32位随机数小于它时记录，sampleRate为1时记录全部
+    const size_t m_maxSqlLength;        // SQL最多保留的字节数
+    const size_t m_queueCapacity;       // 队列容量
+    std::ofstream m_file;               // 日志文件，只由后台线程写入
+    std::mutex m_mutex;                 // 保护m_queue、m_pending和m_stopping
+    std::condition_variable m_cv;       // 有新记录或者需要退出时唤醒后台线程
+    std::condition_variable m_drainedCv;    // 队列写完时唤醒flush
+    std::deque<SlowQuery> m_queue;      // 等待写入的记录
+    size_t m_pending;                   // 已经提交、还没有写入文件的记录数（包括后台线程正在写的）
+    bool m_stopping;                    // 析构时设置
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_sampledOut;
+    std::thread m_writer;               // 后台写入线程，最后初始化
+};
+
+// 类型别名，慢查询日志在连接池和它的所有连接之间共享
+using SlowQueryLogPtr = std::shared_ptr<SlowQueryLog>;
+
+#endif  // SLOW_QUERY_LOG_H
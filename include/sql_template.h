@@ -0,0 +1,270 @@
+/**
+ * @brief 实现编译期检查占位符数量的SQL语句构建器
+ */
+#ifndef SQL_TEMPLATE_H
+#define SQL_TEMPLATE_H
+
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <initializer_list>
+#include "utils.h"
+
+// =============================
+// 编译期的SQL解析函数（C++14的constexpr允许循环）
+// =============================
+
+/**
+ * @brief 从pos开始查找下一个?占位符的位置，找不到返回length
+ * 引号（'、"、`）内部的?不是占位符，引号内的\转义也需要跳过；
+ * 注释（#、-- 和块注释）整体跳过，注释里的?和引号都不起作用，和QueryStats::fingerprint的规则相同
+ */
+constexpr size_t findSqlPlaceholder(const char *sql, size_t length, size_t pos)
+{
+    char quote = '\0';  // 当前所在的引号，'\0'表示不在引号内
+    for (size_t i = pos; i < length; ++i)
+    {
+        char c = sql[i];
+        if (quote != '\0')
+        {
+            if (c == '\\' && quote != '`')
+                ++i;    // 跳过被转义的字符
+            else if (c == quote)
+                quote = '\0';
+        }
+        else if (c == '\'' || c == '"' || c == '`')
+        {
+            quote = c;
+        }
+        else if (c == '#' || (c == '-' && i + 1 < length && sql[i + 1] == '-' &&
+                               (i + 2 == length || sql[i + 2] == ' ' || sql[i + 2] == '\t' ||
+                                sql[i + 2] == '\n' || sql[i + 2] == '\r')))
+        {
+            // 单行注释到行尾为止，换行之后继续查找
+            while (i + 1 < length && sql[i + 1] != '\n')
+                ++i;
+        }
+        else if (c == '/' && i + 1 < length && sql[i + 1] == '*')
+        {
+            // 块注释到*/为止，没有闭合时一直到语句结束
+            for (i += 2; i + 1 < length && !(sql[i] == '*' && sql[i + 1] == '/'); ++i)
+                ;
+            ++i;    // 停在'/'上，循环的++i跳过它
+        }
+        else if (c == '?')
+        {
+            return i;
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief 计算C风格字符串的长度
+ */
+constexpr size_t sqlLength(const char *sql)
+{
+    size_t length = 0;
+    while (sql[length] != '\0')
+        ++length;
+    return length;
+}
+
+/**
+ * @brief 统计SQL语句中的占位符数量
+ */
+constexpr size_t countSqlPlaceholders(const char *sql)
+{
+    size_t length = sqlLength(sql);
+    size_t count = 0;
+    for (size_t pos = findSqlPlaceholder(sql, length, 0); pos < length;
+         pos = findSqlPlaceholder(sql, length, pos + 1))
+    {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * @brief 带占位符的SQL模板，占位符数量N在编译期确定
+ *
+ * 设计特点：
+ * 1）编译期检查：format的参数个数与占位符个数不一致时，直接编译失败，而不是运行时拼出错误的SQL
+ * 2）一次分配：先估算最终长度并预留空间，整数、浮点数直接格式化到同一个缓冲区中
+ * 3）原地转义：字符串参数通过Utils::escapeAppend直接转义到缓冲区中，不产生quoteMySQLString的临时字符串
+ *
+ * 使用示例：
+ * // 通过SQL_TEMPLATE宏创建，宏在编译期统计占位符的数量
+ * constexpr auto kFindUser = SQL_TEMPLATE("SELECT * FROM users WHERE id = ? AND name = ?");
+ * std::string sql = kFindUser.format(42, userName);
+ * // kFindUser.format(42);  编译错误：占位符数量与参数数量不一致
+ *
+ * 支持的参数类型：整数、bool、浮点数、std::string、const char*、nullptr（NULL）
+ */
+template <size_t N>
+class SqlTemplate
+{
+public:
+    /**
+     * @brief 构造函数，sql必须在SqlTemplate的整个生命周期内有效（通常是字符串字面量）
+     */
+    constexpr explicit SqlTemplate(const char *sql)
+        : m_sql(sql), m_length(sqlLength(sql))
+    {
+    }
+
+    /**
+     * @brief 得到占位符的数量
+     */
+    static constexpr size_t placeholderCount() { return N; }
+
+    /**
+     * @brief 得到原始的SQL模板
+     */
+    const char *sql() const { return m_sql; }
+
+    /**
+     * @brief 使用参数替换占位符，返回完整的SQL语句
+     */
+    template <typename... Args>
+    std::string format(const Args &...args) const
+    {
+        std::string out;
+        formatTo(out, args...);
+        return out;
+    }
+
+    /**
+     * @brief 使用参数替换占位符，追加到out的末尾
+     * @param out 输出缓冲区，可以复用，容量足够时不会分配内存
+     */
+    template <typename... Args>
+    void formatTo(std::string &out, const Args &...args) const
+    {
+        static_assert(sizeof...(Args) == N, "SQL placeholder count does not match argument count");
+
+        // 1. 预估最终长度，一次性预留空间
+        size_t estimated = out.size() + m_length;
+        (void)std::initializer_list<int>{(estimated += estimateLength(args), 0)...};
+        out.reserve(estimated);
+
+        // 2. 依次把每个参数写入对应的占位符位置
+        size_t pos = 0;
+        (void)std::initializer_list<int>{(appendSegment(out, pos, args), 0)...};
+
+        // 3. 最后一个占位符之后的部分
+        out.append(m_sql + pos, m_length - pos);
+    }
+
+private:
+    /**
+     * @brief 写入下一个占位符之前的SQL片段，以及替换占位符的参数
+     */
+    template <typename T>
+    void appendSegment(std::string &out, size_t &pos, const T &value) const
+    {
+        size_t placeholder = findSqlPlaceholder(m_sql, m_length, pos);
+        out.append(m_sql + pos, placeholder - pos);
+        appendValue(out, value);
+        pos = placeholder + 1;
+    }
+
+    // =============================
+    // 参数长度估算
+    // =============================
+    template <typename T>
+    static typename std::enable_if<std::is_arithmetic<T>::value, size_t>::type
+    estimateLength(const T &)
+    {
+        return 24;
+    }
+    static size_t estimateLength(const std::string &value) { return value.size() * 2 + 2; }
+    static size_t estimateLength(const char *value) { return value ? std::strlen(value) * 2 + 2 : 4; }
+    static size_t estimateLength(std::nullptr_t) { return 4; }
+
+    // =============================
+    // 参数格式化
+    // =============================
+
+    /**
+     * @brief 整数直接从后往前生成数字，不经过std::to_string
+     */
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+    appendValue(std::string &out, T value)
+    {
+        char buf[24];
+        char *end = buf + sizeof(buf);
+        char *p = end;
+        bool negative = value < 0;
+        // 转换为无符号数计算，避免最小负数取反溢出
+        unsigned long long magnitude = negative ? 0ULL - static_cast<unsigned long long>(value)
+                                                : static_cast<unsigned long long>(value);
+        do
+        {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (negative)
+            *--p = '-';
+        out.append(p, static_cast<size_t>(end - p));
+    }
+
+    static void appendValue(std::string &out, bool value)
+    {
+        out += value ? '1' : '0';
+    }
+
+    /**
+     * @throws std::invalid_argument MySQL不支持NaN和无穷大
+     */
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    appendValue(std::string &out, T value)
+    {
+        if (!std::isfinite(value))
+            throw std::invalid_argument("SqlTemplate: NaN or infinity cannot be written into SQL");
+        char buf[32];
+        int length = std::snprintf(buf, sizeof(buf), "%.17g", static_cast<double>(value));
+        out.append(buf, static_cast<size_t>(length));
+    }
+
+    static void appendValue(std::string &out, const std::string &value)
+    {
+        out += '\'';
+        Utils::escapeAppend(out, value.data(), value.size());
+        out += '\'';
+    }
+
+    static void appendValue(std::string &out, const char *value)
+    {
+        if (!value)
+        {
+            out += "NULL";
+            return;
+        }
+        out += '\'';
+        Utils::escapeAppend(out, value, std::strlen(value));
+        out += '\'';
+    }
+
+    static void appendValue(std::string &out, std::nullptr_t)
+    {
+        out += "NULL";
+    }
+
+private:
+    const char *m_sql;  // SQL模板
+    size_t m_length;    // SQL模板的长度
+};
+
+/**
+ * @brief 创建SqlTemplate，在编译期统计占位符的数量
+ * 参数必须是字符串字面量
+ */
+#define SQL_TEMPLATE(sql) SqlTemplate<countSqlPlaceholders(sql)>(sql)
+
+#endif  // SQL_TEMPLATE_H
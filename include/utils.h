@@ -10,6 +10,8 @@
 #include <sstream>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <cctype>
 
 /**
  * @brief 通用工具类和功能
@@ -160,58 +162,53 @@ inline std::string toString(const T& value)
     return oss.str();
 }
 
+/**
+ * @brief 把MySQL字符串转义后追加到out的末尾，不产生任何临时对象
+ * @param out 输出缓冲区，可以在多次调用之间复用，避免重复分配内存
+ * @param data 待转义的原始字符串（不带''）
+ * @param length 原始字符串的长度
+ *
+ * 转义规则与escapeMySQLString一致；支持SSE2/AVX2的平台上，每次扫描16/32字节，
+ * 没有特殊字符的连续片段整体拷贝，只有遇到特殊字符时才逐个处理
+ * 实现在utils.cpp中，因为SIMD代码不适合inline
+ */
+void escapeAppend(std::string &out, const char *data, size_t length);
+
 /**
  * @brief MySQL专用的字符串转义函数
  * 主要就是转义字符需要注意
  * @param 这里的输入参数，就是我们写入的原始的mysql语句中的字符串部分，但是不带''，然后进行转义
  * 我需要明确一点：这里转义的是SQL语句中的字符串部分，不是整体，不是整体，整体需要使用mysql官方的API mysql_real_escape_string函数
  * 这里转义的示例： SELECT * from users WHERE name = 'O'relly'; 这里的O'relly是这个函数要进行转义的字符串
+ *
+ * 转义规则：
+ * 1）O'relly ---SQL---> O\'relly ---C++---> O\\'relly
+ * 2) O"relly ---SQL---> O\"relly ---C++---> O\\\"relly
+ * 3) \n ---SQL---> \n ---C++---> \\n
+ * 4) \ ---SQL---> \\ ---C++---> \\\\
+ * 此外还有\0 \r Ctrl+Z(\Z) \t \b；双引号在SQL字符串中\"与"是一样的，转义虽然冗余，但是具有更好的兼容性
  */
 inline std::string escapeMySQLString(const std::string &str)
 {
     // 为了提高性能，都应该提前预留足够的内存空间
     std::string escaped;
     escaped.reserve(str.size() * 2);
-
-    // 一个一个浏览字符，将需要进行转换的字符都进行修改
-    for(char c : str)
-    {
-        switch (c)
-        {
-        /**
-         * 理解：
-         * 1）O'relly ---SQL---> O\'relly ---C++---> O\\'relly
-         * case '\''，这样在C++中才能表示字符'
-         * 2) O"relly ---SQL---> O\"relly ---C++---> O\\\"relly
-         * 3) \n ---SQL---> \n ---C++---> \\n
-         * 4) \ ---SQL---> \\ ---C++---> \\\\
-         */
-        case '\0': escaped += "\\0"; break;     // NULL字符
-        case '\n': escaped += "\\n"; break;     // 换行符
-        case '\r': escaped += "\\r"; break;     // 回车符
-        case '\\': escaped += "\\\\"; break;    // 反斜杠
-        case '\'': escaped += "\\'"; break;     // 单引号；最重要的
-        case '"': escaped += "\\\""; break;     // 双引号，这一行是为什么呢？在SQL字符串中\"与"是一样的，因此转义"虽然冗余，但是具有更好的兼容性
-        case '\x1a': escaped += "\\Z"; break;   // Ctrl + Z
-        case '\t': escaped += "\\t"; break;     // 制表符
-        case '\b': escaped += "\\b"; break;     // 退格符
-        default: escaped += c; break;
-        }
-        /**
-         * 之所以转义，就是因为这些转义后的字符串先通过C++输出为最初的SQL语句
-         * 再由SQL解析器解释成具体的SQL命令，因此需要在最开始的时候进行转义
-         */
-    }
-
+    escapeAppend(escaped, str.data(), str.size());
     return escaped;
 }
 
 /**
  * @brief 构建安全的SQL查询字符串
+ * 直接在一个缓冲区中完成引号和转义，不再产生"'" + ... + "'"的临时字符串
  */
 inline std::string quoteMySQLString(const std::string &value)
 {
-    return "'" + escapeMySQLString(value) + "'";
+    std::string quoted;
+    quoted.reserve(value.size() * 2 + 2);
+    quoted += '\'';
+    escapeAppend(quoted, value.data(), value.size());
+    quoted += '\'';
+    return quoted;
 }
 
 /**
@@ -256,6 +253,16 @@ inline std::string trim(const std::string &str)
     return str.substr(first, end - first + 1);
 }
 
+/**
+ * @brief 转换为小写，只处理ASCII字符
+ */
+inline std::string toLower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return str;
+}
+
 }   // namespace Utils
 
 #endif // UTILS_H
\ No newline at end of file
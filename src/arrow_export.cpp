@@ -0,0 +1,415 @@
+#include "arrow_export.h"
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <limits>
+
+/**
+ * @brief Arrow IPC流格式编码器的实现
+ *
+ * Arrow IPC的元数据使用FlatBuffers编码，为了不引入flatbuffers和arrow依赖，
+ * 这里实现了一个只包含必要功能的FlatBuffers构建器，字段编号参考Arrow的Schema.fbs和Message.fbs
+ */
+
+namespace
+{
+    // =============================
+    // Arrow Schema.fbs/Message.fbs中的常量
+    // =============================
+    const int16_t kMetadataVersionV5 = 4;
+    const uint8_t kHeaderSchema = 1;
+    const uint8_t kHeaderRecordBatch = 3;
+    const uint8_t kTypeInt = 2;
+    const uint8_t kTypeFloatingPoint = 3;
+    const uint8_t kTypeBinary = 4;
+    const uint8_t kTypeUtf8 = 5;
+    const int16_t kPrecisionDouble = 2;
+    const unsigned int kBinaryCharset = 63;     // MySQL的binary字符集编号
+    const uint32_t kContinuation = 0xFFFFFFFF;  // IPC消息的继续标记
+
+    /**
+     * @brief 最小化的FlatBuffers构建器
+     *
+     * 与官方实现一样从后往前构建：先创建的对象位于缓冲区的末尾，因此引用总是指向后面，
+     * 偏移量使用"距离缓冲区末尾的字节数"表示，前插数据不会改变已有对象的偏移
+     * 元数据只有几百字节，前插使用vector::insert即可
+     */
+    class FlatBufferBuilder
+    {
+    public:
+        FlatBufferBuilder() : m_minAlign(1), m_tableStart(0) {}
+
+        /**
+         * @brief 当前已经写入的字节数，也就是最近写入的对象的偏移
+         */
+        uint32_t size() const { return static_cast<uint32_t>(m_buf.size()); }
+
+        template <typename T>
+        void push(T value)
+        {
+            align(sizeof(T));
+            prepend(&value, sizeof(T));     // x86/ARM都是小端，与FlatBuffers的字节序一致
+        }
+
+        /**
+         * @brief 写入一个指向offset处对象的uoffset
+         */
+        void pushOffset(uint32_t offset)
+        {
+            align(sizeof(uint32_t));
+            push<uint32_t>(size() + sizeof(uint32_t) - offset);
+        }
+
+        uint32_t createString(const std::string &value)
+        {
+            preAlign(value.size() + 1, sizeof(uint32_t));
+            uint8_t nul = 0;
+            prepend(&nul, 1);
+            prepend(value.data(), value.size());
+            push<uint32_t>(static_cast<uint32_t>(value.size()));
+            return size();
+        }
+
+        /**
+         * @brief 创建结构体数组，data是所有结构体按顺序排列的字节
+         */
+        uint32_t createStructVector(const void *data, size_t count, size_t structSize, size_t alignment)
+        {
+            preAlign(count * structSize, sizeof(uint32_t));
+            preAlign(count * structSize, alignment);
+            prepend(data, count * structSize);
+            push<uint32_t>(static_cast<uint32_t>(count));
+            return size();
+        }
+
+        uint32_t createOffsetVector(const std::vector<uint32_t> &offsets)
+        {
+            preAlign(offsets.size() * sizeof(uint32_t), sizeof(uint32_t));
+            for (size_t i = offsets.size(); i > 0; --i)
+                pushOffset(offsets[i - 1]);
+            push<uint32_t>(static_cast<uint32_t>(offsets.size()));
+            return size();
+        }
+
+        // =============================
+        // 表（table）的构建
+        // =============================
+        void startTable()
+        {
+            m_fields.clear();
+            m_tableStart = size();
+        }
+
+        template <typename T>
+        void addField(uint16_t id, T value)
+        {
+            push(value);
+            m_fields.push_back(FieldLocation{id, size()});
+        }
+
+        void addOffsetField(uint16_t id, uint32_t offset)
+        {
+            pushOffset(offset);
+            m_fields.push_back(FieldLocation{id, size()});
+        }
+
+        /**
+         * @brief 结束表的构建：写入soffset，再在表的前面写入vtable
+         */
+        uint32_t endTable()
+        {
+            push<int32_t>(0);   // 指向vtable的soffset，稍后回填
+            uint32_t tableOffset = size();
+
+            uint16_t fieldCount = 0;
+            for (const FieldLocation &field : m_fields)
+                fieldCount = std::max<uint16_t>(fieldCount, static_cast<uint16_t>(field.id + 1));
+
+            // vtable：[vtable大小, 表的大小, 每个字段在表中的偏移...]，0表示字段不存在
+            std::vector<uint16_t> vtable(2 + fieldCount, 0);
+            vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+            vtable[1] = static_cast<uint16_t>(tableOffset - m_tableStart);
+            for (const FieldLocation &field : m_fields)
+                vtable[2 + field.id] = static_cast<uint16_t>(tableOffset - field.offset);
+            for (size_t i = vtable.size(); i > 0; --i)
+                push<uint16_t>(vtable[i - 1]);
+            uint32_t vtableOffset = size();
+
+            // 回填soffset：表的位置 - vtable的位置
+            int32_t soffset = static_cast<int32_t>(vtableOffset - tableOffset);
+            std::memcpy(&m_buf[m_buf.size() - tableOffset], &soffset, sizeof(soffset));
+            return tableOffset;
+        }
+
+        /**
+         * @brief 写入根对象的偏移，得到完整的FlatBuffer
+         */
+        const std::vector<uint8_t> &finish(uint32_t root)
+        {
+            preAlign(sizeof(uint32_t), m_minAlign);
+            pushOffset(root);
+            return m_buf;
+        }
+
+    private:
+        struct FieldLocation
+        {
+            uint16_t id;        // 字段编号
+            uint32_t offset;    // 字段的偏移
+        };
+
+        void prepend(const void *data, size_t length)
+        {
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+            m_buf.insert(m_buf.begin(), bytes, bytes + length);
+        }
+
+        void pad(size_t length)
+        {
+            m_buf.insert(m_buf.begin(), length, 0);
+        }
+
+        /**
+         * @brief 保证接下来写入length字节之后，缓冲区大小是alignment的整数倍
+         */
+        void preAlign(size_t length, size_t alignment)
+        {
+            m_minAlign = std::max(m_minAlign, alignment);
+            pad((alignment - ((m_buf.size() + length) % alignment)) % alignment);
+        }
+
+        void align(size_t alignment)
+        {
+            preAlign(0, alignment);
+        }
+
+    private:
+        std::vector<uint8_t> m_buf;             // 从后往前构建的缓冲区
+        size_t m_minAlign;                      // 最大的对齐要求，最终大小必须是它的整数倍
+        uint32_t m_tableStart;                  // 当前表开始时的偏移
+        std::vector<FieldLocation> m_fields;    // 当前表已经写入的字段
+    };
+
+    // =============================
+    // 类型映射
+    // =============================
+
+    bool isBinary(const Column &column)
+    {
+        return column.type == ColumnType::STRING && column.charsetnr == kBinaryCharset;
+    }
+
+    bool isUnsigned64(const Column &column)
+    {
+        return column.type == ColumnType::INT64 && column.mysqlType == MYSQL_TYPE_LONGLONG &&
+               (column.flags & UNSIGNED_FLAG) != 0;
+    }
+
+    /**
+     * @brief 创建Field.type对应的类型表，返回(类型编号, 类型表偏移)
+     */
+    uint8_t createType(FlatBufferBuilder &builder, const Column &column, uint32_t &typeOffset)
+    {
+        builder.startTable();
+        switch (column.type)
+        {
+        case ColumnType::INT64:
+            builder.addField<int32_t>(0, 64);                   // bitWidth
+            builder.addField<uint8_t>(1, isUnsigned64(column) ? 0 : 1);  // is_signed
+            typeOffset = builder.endTable();
+            return kTypeInt;
+        case ColumnType::DOUBLE:
+            builder.addField<int16_t>(0, kPrecisionDouble);     // precision
+            typeOffset = builder.endTable();
+            return kTypeFloatingPoint;
+        case ColumnType::STRING:
+        default:
+            typeOffset = builder.endTable();    // Utf8和Binary都是空表
+            return isBinary(column) ? kTypeBinary : kTypeUtf8;
+        }
+    }
+
+    /**
+     * @brief 创建Message表并完成FlatBuffer
+     */
+    const std::vector<uint8_t> &finishMessage(FlatBufferBuilder &builder, uint8_t headerType,
+                                              uint32_t header, int64_t bodyLength)
+    {
+        builder.startTable();
+        builder.addField<int64_t>(3, bodyLength);       // bodyLength
+        builder.addOffsetField(2, header);              // header
+        builder.addField<int16_t>(0, kMetadataVersionV5);   // version
+        builder.addField<uint8_t>(1, headerType);       // header_type
+        return builder.finish(builder.endTable());
+    }
+
+    /**
+     * @brief 写入封装后的消息：继续标记 + 元数据长度 + 元数据（填充到8字节对齐）
+     */
+    void writeMessage(const std::vector<uint8_t> &metadata, std::string &out)
+    {
+        uint32_t continuation = kContinuation;
+        // 8字节的前缀 + 元数据之后必须是8字节对齐的，元数据长度包含填充
+        size_t padded = (metadata.size() + 7) & ~static_cast<size_t>(7);
+        int32_t length = static_cast<int32_t>(padded);
+        out.append(reinterpret_cast<const char *>(&continuation), sizeof(continuation));
+        out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        out.append(reinterpret_cast<const char *>(metadata.data()), metadata.size());
+        out.append(padded - metadata.size(), '\0');
+    }
+
+    /**
+     * @brief Buffer结构体：body中的偏移和长度
+     */
+    struct BufferSpec
+    {
+        int64_t offset;
+        int64_t length;
+    };
+
+    /**
+     * @brief FieldNode结构体：行数和NULL值数量
+     */
+    struct FieldNode
+    {
+        int64_t length;
+        int64_t nullCount;
+    };
+
+    /**
+     * @brief 记录一个body缓冲区的位置，每个缓冲区都填充到8字节对齐
+     */
+    void addBuffer(std::vector<BufferSpec> &buffers, int64_t &bodyLength, size_t length)
+    {
+        buffers.push_back(BufferSpec{bodyLength, static_cast<int64_t>(length)});
+        bodyLength += static_cast<int64_t>((length + 7) & ~static_cast<size_t>(7));
+    }
+
+    void appendPadded(std::string &out, const void *data, size_t length)
+    {
+        out.append(static_cast<const char *>(data), length);
+        out.append(((length + 7) & ~static_cast<size_t>(7)) - length, '\0');
+    }
+}   // namespace
+
+namespace ArrowExport
+{
+
+void exportStream(QueryResult &result, std::string &out, size_t batchRows)
+{
+    if (batchRows == 0)
+        batchRows = 65536;
+
+    result.reset();
+    // 第一批同时提供Schema需要的列信息，即使结果集为空也要写出Schema
+    ColumnarResult batch = result.nextColumns(batchRows);
+    writeSchema(batch, out);
+    while (batch.getRowCount() > 0)
+    {
+        writeRecordBatch(batch, out);
+        batch = result.nextColumns(batchRows);
+    }
+    writeEndOfStream(out);
+    result.reset();
+}
+
+void writeSchema(const ColumnarResult &columns, std::string &out)
+{
+    FlatBufferBuilder builder;
+
+    // 1. 每一列对应一个Field表
+    std::vector<uint32_t> fields;
+    fields.reserve(columns.getColumnCount());
+    for (const Column &column : columns.getColumns())
+    {
+        uint32_t name = builder.createString(column.name);
+        uint32_t type = 0;
+        uint8_t typeType = createType(builder, column, type);
+        // Arrow的读取端要求children必须存在，即使是空数组
+        uint32_t children = builder.createOffsetVector(std::vector<uint32_t>());
+
+        builder.startTable();
+        builder.addOffsetField(0, name);        // name
+        builder.addOffsetField(3, type);        // type
+        builder.addOffsetField(5, children);    // children
+        builder.addField<uint8_t>(1, 1);        // nullable，MySQL的列都可能为NULL
+        builder.addField<uint8_t>(2, typeType); // type_type
+        fields.push_back(builder.endTable());
+    }
+    uint32_t fieldVector = builder.createOffsetVector(fields);
+
+    // 2. Schema表
+    builder.startTable();
+    builder.addOffsetField(1, fieldVector);     // fields
+    builder.addField<int16_t>(0, 0);            // endianness: Little
+    uint32_t schema = builder.endTable();
+
+    writeMessage(finishMessage(builder, kHeaderSchema, schema, 0), out);
+}
+
+void writeRecordBatch(const ColumnarResult &columns, std::string &out)
+{
+    const size_t rows = columns.getRowCount();
+
+    // 1. 先计算每个缓冲区在body中的位置
+    std::vector<FieldNode> nodes;
+    std::vector<BufferSpec> buffers;
+    int64_t bodyLength = 0;
+    for (const Column &column : columns.getColumns())
+    {
+        nodes.push_back(FieldNode{static_cast<int64_t>(rows), static_cast<int64_t>(column.nullCount)});
+        addBuffer(buffers, bodyLength, column.validity.size());
+        switch (column.type)
+        {
+        case ColumnType::INT64:
+        case ColumnType::DOUBLE:
+            addBuffer(buffers, bodyLength, rows * 8);
+            break;
+        case ColumnType::STRING:
+            if (column.bytes.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+                throw std::length_error("Arrow export: string column '" + column.name + "' exceeds 2GB in one batch");
+            addBuffer(buffers, bodyLength, column.offsets.size() * sizeof(uint32_t));
+            addBuffer(buffers, bodyLength, column.bytes.size());
+            break;
+        }
+    }
+
+    // 2. RecordBatch元数据
+    FlatBufferBuilder builder;
+    uint32_t bufferVector = builder.createStructVector(buffers.data(), buffers.size(), sizeof(BufferSpec), 8);
+    uint32_t nodeVector = builder.createStructVector(nodes.data(), nodes.size(), sizeof(FieldNode), 8);
+    builder.startTable();
+    builder.addField<int64_t>(0, static_cast<int64_t>(rows));   // length
+    builder.addOffsetField(1, nodeVector);      // nodes
+    builder.addOffsetField(2, bufferVector);    // buffers
+    uint32_t recordBatch = builder.endTable();
+    writeMessage(finishMessage(builder, kHeaderRecordBatch, recordBatch, bodyLength), out);
+
+    // 3. body：按照缓冲区的顺序直接拷贝列的连续数组，布局已经与Arrow一致
+    out.reserve(out.size() + static_cast<size_t>(bodyLength));
+    for (const Column &column : columns.getColumns())
+    {
+        appendPadded(out, column.validity.data(), column.validity.size());
+        switch (column.type)
+        {
+        case ColumnType::INT64:
+            appendPadded(out, column.int64Values.data(), rows * 8);
+            break;
+        case ColumnType::DOUBLE:
+            appendPadded(out, column.doubleValues.data(), rows * 8);
+            break;
+        case ColumnType::STRING:
+            appendPadded(out, column.offsets.data(), column.offsets.size() * sizeof(uint32_t));
+            appendPadded(out, column.bytes.data(), column.bytes.size());
+            break;
+        }
+    }
+}
+
+void writeEndOfStream(std::string &out)
+{
+    uint32_t marker[2] = {kContinuation, 0};
+    out.append(reinterpret_cast<const char *>(marker), sizeof(marker));
+}
+
+}   // namespace ArrowExport
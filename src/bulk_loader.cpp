@@ -0,0 +1,143 @@
+#include "bulk_loader.h"
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+/**
+ * @brief 批量导入行写入器的实现
+ */
+
+BulkRowWriter::BulkRowWriter(char *dst, size_t capacity, std::string &overflow)
+    : m_dst(dst), m_capacity(capacity), m_pos(0), m_overflow(overflow), m_rowStart(0), m_rowOverflowStart(0), m_firstField(true)
+{
+}
+
+// =============================
+// 字段写入方法
+// =============================
+
+BulkRowWriter &BulkRowWriter::addString(const char *data, size_t length)
+{
+    separate();
+
+    // 按照LOAD DATA的默认规则转义：ESCAPED BY '\\'
+    // 没有特殊字符的连续片段整体拷贝，减少put的调用次数
+    size_t runStart = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        const char *escaped = nullptr;
+        switch (data[i])
+        {
+        case '\0': escaped = "\\0"; break;
+        case '\t': escaped = "\\t"; break;  // 字段分隔符
+        case '\n': escaped = "\\n"; break;  // 行分隔符
+        case '\r': escaped = "\\r"; break;
+        case '\\': escaped = "\\\\"; break; // 转义字符本身
+        default: continue;
+        }
+        put(data + runStart, i - runStart);
+        put(escaped, 2);
+        runStart = i + 1;
+    }
+    put(data + runStart, length - runStart);
+
+    return *this;
+}
+
+BulkRowWriter &BulkRowWriter::addString(const std::string &value)
+{
+    return addString(value.data(), value.size());
+}
+
+BulkRowWriter &BulkRowWriter::addInt(long long value)
+{
+    separate();
+
+    // 从后往前生成数字，避免snprintf的格式解析开销
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    // 使用unsigned进行计算，避免LLONG_MIN取负数溢出
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                             : static_cast<unsigned long long>(value);
+    do
+    {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+        *--p = '-';
+
+    put(p, static_cast<size_t>(end - p));
+    return *this;
+}
+
+BulkRowWriter &BulkRowWriter::addDouble(double value)
+{
+    separate();
+
+    char buf[32];
+    int length = std::snprintf(buf, sizeof(buf), "%.17g", value);
+    put(buf, static_cast<size_t>(length));
+    return *this;
+}
+
+BulkRowWriter &BulkRowWriter::addNull()
+{
+    separate();
+    put("\\N", 2);
+    return *this;
+}
+
+// =============================
+// 行控制方法
+// =============================
+
+void BulkRowWriter::beginRow()
+{
+    m_rowStart = m_pos;
+    m_rowOverflowStart = m_overflow.size();
+    m_firstField = true;
+}
+
+void BulkRowWriter::endRow()
+{
+    put("\n", 1);
+}
+
+void BulkRowWriter::discardRow()
+{
+    m_pos = m_rowStart;
+    m_overflow.resize(m_rowOverflowStart);
+}
+
+// =============================
+// 私有辅助方法
+// =============================
+
+void BulkRowWriter::separate()
+{
+    if (m_firstField)
+    {
+        m_firstField = false;
+        return;
+    }
+    put("\t", 1);
+}
+
+void BulkRowWriter::put(const char *data, size_t length)
+{
+    // 一旦开始溢出，后续的内容必须全部写入溢出缓冲区，保证字节顺序
+    if (m_overflow.empty() && m_pos < m_capacity)
+    {
+        size_t n = std::min(length, m_capacity - m_pos);
+        std::memcpy(m_dst + m_pos, data, n);
+        m_pos += n;
+        data += n;
+        length -= n;
+    }
+    if (length > 0)
+    {
+        m_overflow.append(data, length);
+    }
+}
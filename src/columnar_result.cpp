@@ -0,0 +1,201 @@
+#include "columnar_result.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+
+/**
+ * @brief 按列存储的查询结果的实现
+ */
+
+namespace
+{
+    /**
+     * @brief 按长度解析整数，MySQL返回的整数文本格式是固定的，不需要strtoll的通用处理
+     * 超出int64范围的无符号BIGINT按照补码回绕
+     */
+    inline int64_t parseInt64(const char *data, unsigned long length)
+    {
+        unsigned long i = 0;
+        bool negative = false;
+        if (length > 0 && (data[0] == '-' || data[0] == '+'))
+        {
+            negative = data[0] == '-';
+            i = 1;
+        }
+        uint64_t value = 0;
+        for (; i < length; ++i)
+        {
+            unsigned digit = static_cast<unsigned>(data[i] - '0');
+            if (digit > 9)
+                break;
+            value = value * 10 + digit;
+        }
+        return static_cast<int64_t>(negative ? 0 - value : value);
+    }
+}   // namespace
+
+// =============================
+// 构造函数
+// =============================
+
+ColumnarResult::ColumnarResult()
+    : m_rowCount(0)
+{
+}
+
+ColumnarResult::ColumnarResult(MYSQL_RES *result)
+    : m_rowCount(0)
+{
+    if (!result)
+        return;
+
+    mysql_data_seek(result, 0);
+    load(result, std::numeric_limits<size_t>::max());
+}
+
+ColumnarResult::ColumnarResult(MYSQL_RES *result, size_t maxRows)
+    : m_rowCount(0)
+{
+    if (!result)
+        return;
+
+    load(result, maxRows);
+}
+
+// =============================
+// 私有辅助方法
+// =============================
+
+void ColumnarResult::load(MYSQL_RES *result, size_t maxRows)
+{
+    unsigned int fieldCount = mysql_num_fields(result);
+    MYSQL_FIELD *fields = mysql_fetch_fields(result);
+    size_t expectedRows = std::min(static_cast<size_t>(mysql_num_rows(result)), maxRows);
+
+    // 1. 根据字段类型初始化每一列，提前分配好空间
+    m_columns.resize(fieldCount);
+    for (unsigned int i = 0; i < fieldCount; ++i)
+    {
+        Column &column = m_columns[i];
+        column.name = fields[i].name;
+        column.type = columnTypeOf(fields[i]);
+        column.mysqlType = fields[i].type;
+        column.flags = fields[i].flags;
+        column.charsetnr = fields[i].charsetnr;
+        column.validity.reserve((expectedRows + 7) / 8);
+        switch (column.type)
+        {
+        case ColumnType::INT64:
+            column.int64Values.reserve(expectedRows);
+            break;
+        case ColumnType::DOUBLE:
+            column.doubleValues.reserve(expectedRows);
+            break;
+        case ColumnType::STRING:
+            column.offsets.reserve(expectedRows + 1);
+            column.offsets.push_back(0);
+            break;
+        }
+    }
+
+    // 2. 只遍历一次结果集，把每个单元格追加到对应的列
+    MYSQL_ROW row;
+    while (m_rowCount < maxRows && (row = mysql_fetch_row(result)) != nullptr)
+    {
+        unsigned long *lengths = mysql_fetch_lengths(result);
+        size_t bit = m_rowCount & 7;
+        for (unsigned int i = 0; i < fieldCount; ++i)
+        {
+            Column &column = m_columns[i];
+            if (bit == 0)
+                column.validity.push_back(0);
+
+            const char *value = row[i];
+            if (value == nullptr)
+            {
+                ++column.nullCount;
+            }
+            else
+            {
+                column.validity.back() |= static_cast<uint8_t>(1u << bit);
+            }
+
+            switch (column.type)
+            {
+            case ColumnType::INT64:
+                column.int64Values.push_back(value ? parseInt64(value, lengths[i]) : 0);
+                break;
+            case ColumnType::DOUBLE:
+                // MySQL文本协议中每个字段都以'\0'结尾，可以直接使用strtod
+                column.doubleValues.push_back(value ? std::strtod(value, nullptr) : 0.0);
+                break;
+            case ColumnType::STRING:
+                if (value)
+                {
+                    if (column.bytes.size() + lengths[i] > std::numeric_limits<uint32_t>::max())
+                        throw std::length_error("ColumnarResult: string column '" + column.name + "' exceeds 4GB");
+                    column.bytes.append(value, lengths[i]);
+                }
+                column.offsets.push_back(static_cast<uint32_t>(column.bytes.size()));
+                break;
+            }
+        }
+        ++m_rowCount;
+    }
+}
+
+// =============================
+// 列访问方法
+// =============================
+
+const Column &ColumnarResult::getColumn(size_t index) const
+{
+    if (index >= m_columns.size())
+        throw std::out_of_range("Column index out of range: " + std::to_string(index));
+    return m_columns[index];
+}
+
+const Column &ColumnarResult::getColumn(const std::string &name) const
+{
+    for (const Column &column : m_columns)
+    {
+        if (column.name == name)
+            return column;
+    }
+    throw std::out_of_range("Column name not found: " + name);
+}
+
+size_t ColumnarResult::getMemoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    for (const Column &column : m_columns)
+    {
+        bytes += sizeof(Column) + column.name.capacity() + column.validity.capacity() +
+                 column.int64Values.capacity() * sizeof(int64_t) +
+                 column.doubleValues.capacity() * sizeof(double) +
+                 column.offsets.capacity() * sizeof(uint32_t) + column.bytes.capacity();
+    }
+    return bytes;
+}
+
+ColumnType ColumnarResult::columnTypeOf(const MYSQL_FIELD &field)
+{
+    switch (field.type)
+    {
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_YEAR:
+        return ColumnType::INT64;
+    case MYSQL_TYPE_FLOAT:
+    case MYSQL_TYPE_DOUBLE:
+    case MYSQL_TYPE_DECIMAL:
+    case MYSQL_TYPE_NEWDECIMAL:
+        return ColumnType::DOUBLE;
+    default:
+        return ColumnType::STRING;
+    }
+}
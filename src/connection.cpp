@@ -1,11 +1,204 @@
 #include "connection.h"
 #include "utils.h"
 #include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <mysql/errmsg.h>
 
 /**
  * @brief 这是连接类的基础实现
  */
 
+// =============================
+// LOAD DATA LOCAL INFILE的回调函数，只在本文件中使用
+// =============================
+namespace
+{
+    /**
+     * @brief 一次批量导入的上下文，通过userdata传给mysqlclient的回调函数
+     */
+    struct BulkLoadContext
+    {
+        const BulkRowSource *source = nullptr;  // 行数据源
+        std::string overflow;                   // 读缓冲区放不下的行数据
+        size_t overflowPos = 0;                 // 溢出缓冲区中已经输出的位置
+        bool finished = false;                  // 行数据源是否已经结束
+        unsigned long long rows = 0;            // 已经生成的行数
+        std::string error;                      // 行数据源抛出的异常信息
+    };
+
+    int bulkLoadInit(void **ptr, const char * /*filename*/, void *userdata)
+    {
+        *ptr = userdata;
+        return 0;
+    }
+
+    /**
+     * @brief mysqlclient每次需要数据时调用，返回写入buf的字节数，返回0表示数据结束，返回-1表示出错
+     */
+    int bulkLoadRead(void *ptr, char *buf, unsigned int bufLen)
+    {
+        BulkLoadContext *ctx = static_cast<BulkLoadContext *>(ptr);
+        size_t copied = 0;
+
+        // 1. 先输出上一次没有放下的行数据
+        if (ctx->overflowPos < ctx->overflow.size())
+        {
+            copied = std::min<size_t>(bufLen, ctx->overflow.size() - ctx->overflowPos);
+            std::memcpy(buf, ctx->overflow.data() + ctx->overflowPos, copied);
+            ctx->overflowPos += copied;
+            if (ctx->overflowPos < ctx->overflow.size())
+                return static_cast<int>(copied);
+        }
+        ctx->overflow.clear();  // 只清空内容，保留容量，溢出缓冲区可以一直复用
+        ctx->overflowPos = 0;
+
+        if (ctx->finished)
+            return static_cast<int>(copied);
+
+        // 2. 把新的行直接格式化到读缓冲区中，直到写满或者发生溢出
+        BulkRowWriter writer(buf + copied, bufLen - copied, ctx->overflow);
+        try
+        {
+            while (!writer.full() && ctx->overflow.empty())
+            {
+                writer.beginRow();
+                if (!(*ctx->source)(writer))
+                {
+                    writer.discardRow();
+                    ctx->finished = true;
+                    break;
+                }
+                writer.endRow();
+                ++ctx->rows;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            // 异常不能穿过C语言的回调，记录下来，由bulkLoad重新抛出
+            ctx->error = e.what();
+            return -1;
+        }
+        catch (...)
+        {
+            ctx->error = "unknown exception from row source";
+            return -1;
+        }
+
+        return static_cast<int>(copied + writer.written());
+    }
+
+    void bulkLoadEnd(void * /*ptr*/)
+    {
+    }
+
+    int bulkLoadError(void *ptr, char *msg, unsigned int msgLen)
+    {
+        BulkLoadContext *ctx = static_cast<BulkLoadContext *>(ptr);
+        std::string error = (ctx && !ctx->error.empty()) ? ctx->error : "bulk load aborted";
+        std::snprintf(msg, msgLen, "%s", error.c_str());
+        return CR_UNKNOWN_ERROR;
+    }
+
+    /**
+     * @brief 默认的处理函数：拒绝服务端发起的任何LOAD DATA LOCAL INFILE请求
+     * 开启MYSQL_OPT_LOCAL_INFILE之后，mysqlclient默认会读取服务端指定的本地文件，这是有安全风险的
+     * 因此只有在bulkLoad期间才会安装真正的处理函数
+     */
+    int denyLocalInfileInit(void **ptr, const char * /*filename*/, void * /*userdata*/)
+    {
+        *ptr = nullptr;
+        return 1;
+    }
+
+    int denyLocalInfileRead(void * /*ptr*/, char * /*buf*/, unsigned int /*bufLen*/)
+    {
+        return -1;
+    }
+
+    int denyLocalInfileError(void * /*ptr*/, char *msg, unsigned int msgLen)
+    {
+        std::snprintf(msg, msgLen, "%s", "LOAD DATA LOCAL INFILE is only allowed through Connection::bulkLoad");
+        return CR_UNKNOWN_ERROR;
+    }
+
+    void installDenyLocalInfileHandler(MYSQL *mysql)
+    {
+        mysql_set_local_infile_handler(mysql, denyLocalInfileInit, denyLocalInfileRead,
+                                       bulkLoadEnd, denyLocalInfileError, nullptr);
+    }
+
+    /**
+     * @brief 使用反引号包围标识符，支持db.table的形式
+     */
+    std::string quoteIdentifier(const std::string &name)
+    {
+        std::string quoted = "`";
+        for (char c : name)
+        {
+            if (c == '.')
+                quoted += "`.`";
+            else if (c == '`')
+                quoted += "``";
+            else
+                quoted += c;
+        }
+        quoted += "`";
+        return quoted;
+    }
+
+    /**
+     * @brief 比较sql从pos开始的单词是否为keyword（keyword是大写），成功时pos移动到单词之后
+     */
+    bool matchKeyword(const std::string &sql, size_t &pos, const char *keyword)
+    {
+        while (pos < sql.size() && std::isspace(static_cast<unsigned char>(sql[pos])))
+            ++pos;
+        size_t length = std::strlen(keyword);
+        if (sql.size() - pos < length)
+            return false;
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (std::toupper(static_cast<unsigned char>(sql[pos + i])) != keyword[i])
+                return false;
+        }
+        // 单词之后必须是分隔符，避免把SETTINGS当作SET
+        if (pos + length < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[pos + length])) || sql[pos + length] == '_'))
+            return false;
+        pos += length;
+        return true;
+    }
+
+    /**
+     * @brief 根据语句开头的关键字判断语句会留下哪些会话状态，只看开头，代价很小
+     */
+    unsigned int sessionStateOf(const std::string &sql)
+    {
+        size_t pos = 0;
+        if (matchKeyword(sql, pos, "SET"))
+            return Connection::SESSION_VARIABLES;
+        if (matchKeyword(sql, pos, "USE"))
+            return Connection::SESSION_DATABASE;
+        if (matchKeyword(sql, pos, "LOCK"))
+            return Connection::SESSION_LOCKS;
+        if (matchKeyword(sql, pos, "PREPARE"))
+            return Connection::SESSION_PREPARED;
+        if (matchKeyword(sql, pos, "BEGIN") || (matchKeyword(sql, pos, "START") && matchKeyword(sql, pos, "TRANSACTION")))
+            return Connection::SESSION_TRANSACTION;
+        pos = 0;
+        if (matchKeyword(sql, pos, "CREATE") && matchKeyword(sql, pos, "TEMPORARY"))
+            return Connection::SESSION_TEMP_TABLES;
+        return Connection::SESSION_CLEAN;
+    }
+
+    uint64_t microsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}   // namespace
+
 // =============================
 // 构造函数和析构函数
 // =============================
@@ -13,7 +206,7 @@
 Connection::Connection(const std::string &host, const std::string &user,
                        const std::string &password, const std::string &database,
                        unsigned int port)
-    : m_mysql(nullptr), m_host(host), m_user(user), m_password(password), m_database(database), m_port(port), m_connectionId(Utils::generateRandomString(16)), m_creationTime(Utils::currentTimeMillis()), m_lastActiveTime(m_creationTime), m_connected(false)
+    : m_mysql(nullptr), m_host(host), m_user(user), m_password(password), m_database(database), m_port(port), m_connectionId(Utils::generateRandomString(16)), m_creationTime(Utils::currentTimeMillis()), m_lastActiveTime(m_creationTime), m_connected(false), m_inTransaction(false), m_sessionState(SESSION_CLEAN)
 {
     LOG_INFO("Creating connection [" + m_connectionId + "] to " +
              m_user + "@" + m_host + ":" + std::to_string(m_port) + "/" + m_database);
@@ -82,6 +275,15 @@ void Connection::init()
     //     LOG_WARNING("Failed to set multistatement");
     // }
 
+    // 7. 允许LOAD DATA LOCAL INFILE，用于bulkLoad批量导入
+    // 同时安装拒绝处理函数，保证只有bulkLoad能够发送本地数据
+    unsigned int localInfile = 1;
+    if (mysql_options(m_mysql, MYSQL_OPT_LOCAL_INFILE, &localInfile) != 0)
+    {
+        LOG_WARNING("Failed to enable local infile");
+    }
+    installDenyLocalInfileHandler(m_mysql);
+
     // 日志记录
     LOG_INFO("MYSQL connection object initialized [" + m_connectionId + "]");
 }
@@ -95,7 +297,7 @@ bool Connection::connect()
 {
     // 加锁
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
 
     if (m_connected)
     {
@@ -113,6 +315,7 @@ bool Connection::connect()
 
     // 开始尝试进行连接
     LOG_INFO("Connecting to MySQL server [" + m_connectionId + "]");
+    auto start = startTiming();
     MYSQL *result = mysql_real_connect(
         m_mysql,
         m_host.c_str(),
@@ -128,10 +331,16 @@ bool Connection::connect()
     {
         std::string error = getLastError();
         LOG_ERROR("Failed to connect to MySQL Server: [" + m_connectionId + "]: " + error);
+        if (m_metrics)
+            m_metrics->increment(PoolMetrics::CONNECT_FAILURE);
+        recordError();
+        notifyConnect(start, false);
         lock.unlock();
         return false;
     }
     m_connected = true;
+    recordLatency(PoolMetrics::CONNECT, start);
+    notifyConnect(start, true);
 
     // 如果连接建立成功，更新连接的活动时间
     updateLastActiveTime();
@@ -147,7 +356,7 @@ bool Connection::connect()
 void Connection::close()
 {
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
 
     if (m_mysql)
     {
@@ -167,7 +376,7 @@ void Connection::close()
 bool Connection::isValid() const
 {
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
 
     if (!m_mysql)
     {
@@ -182,8 +391,10 @@ bool Connection::isValid() const
         return false;
     }
 
+    auto start = startTiming();
     if (mysql_ping(m_mysql) == 0)
     {
+        recordLatency(PoolMetrics::PING, start);
         updateLastActiveTime();
         return true;
     }
@@ -191,6 +402,7 @@ bool Connection::isValid() const
     {
         // 任何mysql操作失败后，都应该打印getLastError()
         LOG_ERROR("Connection validation failed [" + m_connectionId + "]: " + getLastError());
+        recordError();
         return false;
     }
 }
@@ -207,7 +419,18 @@ QueryResultPtr Connection::executeQuery(const std::string &sql)
 
 unsigned long long Connection::executeUpdate(const std::string &sql)
 {
-    QueryResultPtr result = executeInternal(sql, false);
+    QueryResultPtr result;
+    try
+    {
+        result = executeInternal(sql, false);
+    }
+    catch (...)
+    {
+        // 执行失败的语句也可能已经修改了部分数据（例如非事务表），同样需要让缓存失效
+        invalidateCache(sql);
+        throw;
+    }
+    invalidateCache(sql);
     return result ? result->getAffectedRows() : 0;
 }
 
@@ -226,7 +449,7 @@ QueryResultPtr Connection::executeInternal(const std::string &sql, bool isQuery)
     }
 
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
     // 若有效
     // 记录日志：尝试进行什么操作
     LOG_DEBUG("Connection execute " + std::string(isQuery ? "query" : "update") +
@@ -236,13 +459,26 @@ QueryResultPtr Connection::executeInternal(const std::string &sql, bool isQuery)
 
     // 开始对应的操作
     // 无论是query or update 是不是都采用一个mysql_query的接口 ### 疑问
+    if (m_interceptor)
+    {
+        PoolInterceptor::QueryEvent event;
+        event.connection = this;
+        event.sql = &sql;
+        event.isQuery = isQuery;
+        m_interceptor->onQueryStart(event);
+    }
+    POOL_PROBE2(query_start, m_connectionId.c_str(), sql.c_str());
+    auto start = startTiming();
     if (mysql_query(m_mysql, sql.c_str()) != 0)
     {
+        recordError();
+        notifyQueryFailed(sql, isQuery, start);
         std::string error = getLastError();
         LOG_ERROR("connection failed to execute " + std::string(isQuery ? "query" : "update") +
                  " [" + m_connectionId + "]: " + error + ", SQL: " + sql);
         throw std::runtime_error("SQL execution failed: " + error);
     }
+    m_sessionState |= sessionStateOf(sql);
     // 如果发生错误，进行错误处理
     // 执行成功
     // 如果为查询操作，需要返回查询结果
@@ -254,19 +490,226 @@ QueryResultPtr Connection::executeInternal(const std::string &sql, bool isQuery)
         // 判断是否有结果集，为什么这样判断呢？
         if(!result && mysql_field_count(m_mysql) > 0)    // ### 这里命名result为空指针，为什么mysql_field_count还能够有结果呢？因为传入的是m_mysql，这里是不是要验证数据表不是空表，表是由多个域组成的
         {
+            recordError();
+            notifyQueryFailed(sql, isQuery, start);
             std::string error = getLastError();
             LOG_ERROR("Failed to store query result [" + m_connectionId + "]: " + error);
             throw std::runtime_error("Failed to store query result [" + m_connectionId + "]: " + error);
         }
 
+        recordStatement(sql, PoolMetrics::QUERY, start, result ? mysql_num_rows(result) : 0, 0);
         return std::make_shared<QueryResult>(result);
     } else {
         // 对于更新操作，返回受影响的行数
         unsigned long long affects = mysql_affected_rows(m_mysql);
+        recordStatement(sql, PoolMetrics::UPDATE, start, 0, affects);
         return std::make_shared<QueryResult>(nullptr, affects);
     }
 }
 
+// =============================
+// 批量导入方法
+// =============================
+unsigned long long Connection::bulkLoad(const std::string &table, const std::vector<std::string> &columns,
+                                        const BulkRowSource &rowSource)
+{
+    if (table.empty() || columns.empty() || !rowSource)
+    {
+        throw std::invalid_argument("bulkLoad requires table, columns and rowSource [" + m_connectionId + "]");
+    }
+
+    if (!isValid())
+    {
+        LOG_ERROR("Connection not established [" + m_connectionId + "]");
+        throw std::runtime_error("Connection not established [" + m_connectionId + "]");
+    }
+
+    // 文件名只是一个占位符，真正的数据来自于回调函数
+    std::string sql = "LOAD DATA LOCAL INFILE 'bulk_load' INTO TABLE " + quoteIdentifier(table) +
+                      " FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\' LINES TERMINATED BY '\\n' (";
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        if (i > 0)
+            sql += ", ";
+        sql += quoteIdentifier(columns[i]);
+    }
+    sql += ")";
+
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    LOG_DEBUG("Connection bulk load [" + m_connectionId + "], sql: " + sql);
+
+    updateLastActiveTime();
+
+    BulkLoadContext context;
+    context.source = &rowSource;
+    mysql_set_local_infile_handler(m_mysql, bulkLoadInit, bulkLoadRead, bulkLoadEnd, bulkLoadError, &context);
+    int status = mysql_real_query(m_mysql, sql.c_str(), sql.length());
+    // 无论成功与否，都要恢复拒绝处理函数，context是栈上的对象，不能再被回调访问
+    installDenyLocalInfileHandler(m_mysql);
+    // 导入失败时也可能已经写入了部分行，同样需要让缓存失效
+    invalidateCache(sql);
+
+    if (status != 0)
+    {
+        std::string error = context.error.empty() ? getLastError() : context.error;
+        LOG_ERROR("connection failed to bulk load into " + table + " [" + m_connectionId + "]: " + error);
+        throw std::runtime_error("Bulk load failed: " + error);
+    }
+
+    unsigned long long affects = mysql_affected_rows(m_mysql);
+    LOG_INFO("Bulk load into " + table + " finished [" + m_connectionId + "]: " +
+             std::to_string(context.rows) + " rows sent, " + std::to_string(affects) + " rows affected");
+    return affects;
+}
+
+// =============================
+// 查询缓存方法
+// =============================
+void Connection::setQueryCache(QueryCachePtr cache)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    m_queryCache = std::move(cache);
+}
+
+QueryCachePtr Connection::getQueryCache() const
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    return m_queryCache;
+}
+
+ColumnarResultPtr Connection::executeCachedQuery(const std::string &sql)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+
+    // 事务中的读必须看到自己未提交的修改，也不能把未提交的数据放入共享的缓存
+    if (!m_queryCache || m_inTransaction)
+        return std::make_shared<const ColumnarResult>(executeQuery(sql)->toColumns());
+
+    ColumnarResultPtr cached = m_queryCache->get(sql);
+    if (cached)
+        return cached;
+
+    // 代数必须在查询之前读取，查询期间发生的失效会让put放弃写入
+    uint64_t generation = m_queryCache->getGeneration();
+    ColumnarResultPtr result = std::make_shared<const ColumnarResult>(executeQuery(sql)->toColumns());
+    m_queryCache->put(sql, result, generation);
+    return result;
+}
+
+void Connection::invalidateCache(const std::string &sql)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    if (!m_queryCache)
+        return;
+
+    m_queryCache->invalidateStatement(sql);
+    if (m_inTransaction)
+        m_transactionWrites.push_back(sql);
+}
+
+// =============================
+// 性能统计方法
+// =============================
+
+void Connection::setMetrics(PoolMetricsPtr metrics)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    m_metrics = std::move(metrics);
+}
+
+PoolMetricsPtr Connection::getMetrics() const
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    return m_metrics;
+}
+
+void Connection::setQueryStats(QueryStatsPtr queryStats)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    m_queryStats = std::move(queryStats);
+}
+
+void Connection::setSlowQueryLog(SlowQueryLogPtr slowQueryLog)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    m_slowQueryLog = std::move(slowQueryLog);
+}
+
+void Connection::setInterceptor(PoolInterceptorPtr interceptor)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    m_interceptor = std::move(interceptor);
+}
+
+void Connection::recordLatency(PoolMetrics::Histogram histogram, std::chrono::steady_clock::time_point start) const
+{
+    if (m_metrics)
+        m_metrics->record(histogram, std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::steady_clock::now() - start).count());
+}
+
+void Connection::recordStatement(const std::string &sql, PoolMetrics::Histogram histogram,
+                                 std::chrono::steady_clock::time_point start, uint64_t rows, uint64_t affectedRows) const
+{
+    // 开始执行之后才启用的统计没有开始时间，这一次不记录
+    if (start == std::chrono::steady_clock::time_point())
+        return;
+    uint64_t micros = microsSince(start);
+    if (m_metrics)
+        m_metrics->record(histogram, micros);
+    if (m_queryStats)
+        m_queryStats->record(sql, micros, rows, affectedRows);
+    // 绝大多数语句到这里只有一次比较
+    if (m_slowQueryLog && m_slowQueryLog->isSlow(micros))
+        m_slowQueryLog->submit(micros, m_connectionId, rows, affectedRows, sql);
+    if (m_interceptor)
+    {
+        PoolInterceptor::QueryEvent event;
+        event.connection = this;
+        event.sql = &sql;
+        event.isQuery = histogram == PoolMetrics::QUERY;
+        event.micros = micros;
+        event.rows = rows;
+        event.affectedRows = affectedRows;
+        m_interceptor->onQueryEnd(event);
+    }
+    POOL_PROBE3(query_end, m_connectionId.c_str(), micros, 0);
+}
+
+void Connection::notifyQueryFailed(const std::string &sql, bool isQuery, std::chrono::steady_clock::time_point start) const
+{
+    if ((!m_interceptor && !POOL_PROBE_ENABLED(query_end)) || start == std::chrono::steady_clock::time_point())
+        return;
+    PoolInterceptor::QueryEvent event;
+    event.connection = this;
+    event.sql = &sql;
+    event.isQuery = isQuery;
+    event.micros = microsSince(start);
+    event.errorCode = m_mysql ? mysql_errno(m_mysql) : 0;
+    if (m_interceptor)
+        m_interceptor->onQueryEnd(event);
+    POOL_PROBE3(query_end, m_connectionId.c_str(), event.micros, event.errorCode);
+}
+
+void Connection::notifyConnect(std::chrono::steady_clock::time_point start, bool connected) const
+{
+    if ((!m_interceptor && !POOL_PROBE_ENABLED(connect)) || start == std::chrono::steady_clock::time_point())
+        return;
+    PoolInterceptor::ConnectEvent event;
+    event.connection = this;
+    event.micros = microsSince(start);
+    event.errorCode = connected || !m_mysql ? 0 : mysql_errno(m_mysql);
+    if (m_interceptor)
+        m_interceptor->onConnect(event);
+    POOL_PROBE3(connect, m_connectionId.c_str(), event.micros, event.errorCode);
+}
+
+void Connection::recordError() const
+{
+    if (m_metrics && m_mysql)
+        m_metrics->recordError(mysql_errno(m_mysql));
+}
+
 // =============================
 // 事务管理方法
 // 无论是开始事务、提交事务、回滚事务，整体的逻辑是一样的，只是进行事务的不同阶段而已
@@ -276,7 +719,7 @@ bool Connection::beginTransaction()
 {
     // 加锁，保证多线程安全
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
     // 判断连接是否建立
     if(!m_mysql || !m_connected)
     {
@@ -288,8 +731,10 @@ bool Connection::beginTransaction()
     // 日志记录开始事务的事件
     LOG_DEBUG("start transaction [" + m_connectionId + "]");
     // 执行命令 ### 注意好像无论执行什么命令，都是mysql_query这一个函数
+    auto start = startTiming();
     if(mysql_query(m_mysql, "START TRANSACTION") != 0)
     {
+        recordError();
         // 错误处理
         std::string error = "Failed to begin transaction [" + m_connectionId + "]: " + getLastError();
         LOG_ERROR(error);
@@ -297,7 +742,11 @@ bool Connection::beginTransaction()
         return false;
     }
     // 更新最近连接活动时间，这应该是执行成功才会更新连接的最新活动时间吗？还是在活动开始之前更新活动时间
+    recordLatency(PoolMetrics::TRANSACTION, start);
     updateLastActiveTime();
+    m_inTransaction = true;
+    m_sessionState |= SESSION_TRANSACTION;
+    m_transactionWrites.clear();
     // 返回
     return true;
 }
@@ -307,7 +756,7 @@ bool Connection::commit()
 {
     // 加锁
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
     // 判断连接是否建立
     if(!m_mysql || !m_connected)
     {
@@ -317,13 +766,28 @@ bool Connection::commit()
     // 日志记录事件
     LOG_DEBUG("commit transaction [" + m_connectionId + "]");
     // 执行命令
-    if(mysql_query(m_mysql, "COMMIT") != 0)
+    auto start = startTiming();
+    int status = mysql_query(m_mysql, "COMMIT");
+    // 事务中的写语句执行时已经让缓存失效过一次，但是提交之前其他连接读到的仍然是旧数据，
+    // 这些旧数据可能又被放回了缓存，所以提交之后需要再次失效；提交失败时事务的状态不确定，同样处理
+    m_inTransaction = false;
+    std::vector<std::string> writes;
+    writes.swap(m_transactionWrites);
+    if (m_queryCache)
+    {
+        for (const std::string &sql : writes)
+            m_queryCache->invalidateStatement(sql);
+    }
+    if(status != 0)
     {
         // 错误处理
+        recordError();
         std::string error = "Failed to commit transaction [" + m_connectionId + "]: " + getLastError();
         LOG_ERROR(error);
         return false;   
     }
+    m_sessionState &= ~SESSION_TRANSACTION;
+    recordLatency(PoolMetrics::TRANSACTION, start);
     
     // 更新连接最新活动时间
     updateLastActiveTime();
@@ -336,7 +800,7 @@ bool Connection::rollback()
 {
     // 加锁
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
     // 判断连接是否建立
     if(!m_mysql || !m_connected)
     {
@@ -344,13 +808,20 @@ bool Connection::rollback()
     }
     // 记录事件
     LOG_DEBUG("roll back transaction [" + m_connectionId + "]");
+    // 回滚之后数据没有变化，执行写语句时已经让缓存失效过，不需要再处理
+    m_inTransaction = false;
+    m_transactionWrites.clear();
     // 开始执行事务回滚
+    auto start = startTiming();
     if(mysql_query(m_mysql, "ROLLBACK") != 0)
     {
         // 错误处理
+        recordError();
         LOG_ERROR("Failed to rollback [" + m_connectionId + "]: " + getLastError());
         return false;
     }
+    m_sessionState &= ~SESSION_TRANSACTION;
+    recordLatency(PoolMetrics::TRANSACTION, start);
     
     // 更新连接的最新活动时间
     updateLastActiveTime();
@@ -358,6 +829,54 @@ bool Connection::rollback()
     return true;
 }
 
+// =============================
+// 会话状态方法
+// =============================
+
+unsigned int Connection::getSessionState() const
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    return m_sessionState;
+}
+
+void Connection::markSessionState(unsigned int flags)
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    m_sessionState |= flags;
+}
+
+bool Connection::resetSession()
+{
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
+    if (m_sessionState == SESSION_CLEAN)
+        return true;
+    if (!m_mysql || !m_connected)
+    {
+        LOG_ERROR("Connection not established [" + m_connectionId + "]");
+        return false;
+    }
+
+    LOG_DEBUG("reset session [" + m_connectionId + "], state: " + std::to_string(m_sessionState));
+    if (mysql_reset_connection(m_mysql) != 0)
+    {
+        LOG_ERROR("Failed to reset session [" + m_connectionId + "]: " + getLastError());
+        return false;
+    }
+    // 重置不会改变默认数据库，USE切换过时需要切换回来
+    if ((m_sessionState & SESSION_DATABASE) && mysql_select_db(m_mysql, m_database.c_str()) != 0)
+    {
+        LOG_ERROR("Failed to restore database after reset [" + m_connectionId + "]: " + getLastError());
+        return false;
+    }
+
+    // 未提交的事务已经回滚，写语句执行时已经让缓存失效过，不需要再处理
+    m_inTransaction = false;
+    m_transactionWrites.clear();
+    m_sessionState = SESSION_CLEAN;
+    updateLastActiveTime();
+    return true;
+}
+
 // =============================
 // 错误处理方法
 // ### BUG 在getLastError，getLastErrorCode，escapeString函数中，我自己使用了isValid代替直接判断
@@ -397,8 +916,13 @@ unsigned int Connection::getLastErrorCode() const
 std::string Connection::escapeString(const std::string &sql)
 {
     // ### 我需要确定的一点是：对于SQL中的字符串我需要进行转义，而且这些字符串需要使用单引号包围起来，整个SQL语句是字符串形式，这两个字符串是不一样的意思的，我需要分清楚
-    
-    // 我认为这个函数的功能仅仅是转义SQL语句，而不需要判断连接是否建立，但是写上也无所谓
+    std::string escaped;
+    escapeAppend(escaped, sql.data(), sql.size());
+    return escaped;
+}
+
+void Connection::escapeAppend(std::string &out, const char *data, size_t length)
+{
     // ### 疑问：由于mysql_real_escape_string仍然需要传入连接句柄m_mysql，所以使用API进行转义的前提是需要建立MySQL连接 ### 疑问
     // 判断连接是否建立
     // if(!isValid())
@@ -408,18 +932,16 @@ std::string Connection::escapeString(const std::string &sql)
         // 返回的应该是转义后的SQL语句，因此这里无法返回，只能抛出异常
         throw std::runtime_error("connection not established, cannot escape string!");
     }
-    // 提前分配足够大的缓冲区，这里使用的是vector而不是string，需要思考为什么这样做
-    // 因为我需要得到容器底层的数组指针，然后进行赋值，但是string.c_str返回的是const char*无法进行赋值操作，但是vector<char>.data()可以得到char*，这样就可以直接赋值
-    std::vector<char> escaped(sql.size() + 1);  // 按照C风格字符串数组进行分配
-    // 调用mysql官方的转义函数
-    // ### 必须要进行错误处理，需要进行错误处理吗？如果需要的话，应该如何做错误处理？
-    uint64_t escaped_length = mysql_real_escape_string(m_mysql,
-                                                       escaped.data(),
-                                                       sql.c_str(),
-                                                       sql.length());   // 原始的SQL字符串的长度
-    
-    // 返回转义后的字符串，需要自己进行构造
-    return std::string(escaped.data(), escaped_length);
+    // ### BUG 之前只分配了sql.size() + 1字节，但是MySQL文档要求目标缓冲区至少为2 * length + 1字节，
+    // 因为最坏情况下每个字符都需要转义，再加上结尾的'\0'，缓冲区不够会发生越界写
+    // 现在直接在out的末尾扩容，转义到out的内存中，然后截断为真实长度，不再需要vector和额外的string拷贝
+    size_t oldSize = out.size();
+    out.resize(oldSize + length * 2 + 1);
+    unsigned long escapedLength = mysql_real_escape_string(m_mysql,
+                                                           &out[oldSize],
+                                                           data,
+                                                           static_cast<unsigned long>(length));
+    out.resize(oldSize + escapedLength);
 }
 
 // ### getCreationTime and getLastActiveTime就很容易说明很多的问题
@@ -435,7 +957,7 @@ int64_t Connection::getCreationTime() const
 int64_t Connection::getLastActiveTime() const
 {
     // std::unique_lock<std::mutex> lock(m_mutex);
-    std::unique_lock<std::recursive_mutex> lock(m_mutex);
+    std::unique_lock<ConnectionMutex> lock(m_mutex);
     return m_lastActiveTime;
 }
 
@@ -452,3 +974,9 @@ std::string Connection::getConnectionId() const
 {
     return m_connectionId;
 }
+
+// 连接参数在构造之后同样不会改变，不需要加锁
+std::string Connection::getConnectionStr() const
+{
+    return m_user + "@" + m_host + ":" + std::to_string(m_port) + "/" + m_database;
+}
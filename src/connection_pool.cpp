@@ -0,0 +1,884 @@
+#include "connection_pool.h"
+#include "prometheus_exporter.h"
+#include "pool_probes.h"
+#include "logger.h"
+#include "utils.h"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <mysql/errmsg.h>
+
+/**
+ * @brief 数据库连接池的实现
+ */
+
+// 类内初始化的static const成员被ODR使用时需要定义（C++14）
+const size_t ConnectionPool::kPriorityCount;
+
+namespace
+{
+    const double kSizingHeadroom = 1.25;        // 按照Little定律估算连接数时预留的余量
+    const double kShrinkUtilization = 0.5;      // 平均占用低于上限的这个比例时认为利用率偏低
+    const double kShrinkFactor = 0.75;          // 每次收缩保留的比例
+    const unsigned int kShrinkWindows = 3;      // 连续这么多个周期利用率偏低才收缩
+    const double kLifetimeJitter = 0.1;         // 连接寿命最多提前这个比例到期
+    const unsigned int kMaintenanceInterval = 1000; // 只启用连接轮换时，维护线程的周期（毫秒）
+
+    uint64_t elapsedMicros(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+    }
+}
+
+// =============================
+// 构造函数和析构函数
+// =============================
+
+ConnectionPool::ConnectionPool(const PoolConfig &config)
+    : m_config(config), m_totalWeight(0), m_nextSlot(0), m_totalConnections(0), m_activeConnections(0),
+      m_targetConnections(config.maxConnections), m_closing(false), m_shedding(false), m_rejected(0), m_windowBorrows(0), m_windowWaitMicros(0),
+      m_windowHoldMicros(0), m_windowTimeouts(0), m_windowStart(std::chrono::steady_clock::now()), m_lowWindows(0),
+      m_rotated(0), m_sessionResets(0), m_coalescedQueries(0)
+{
+    if (!m_config.isValid())
+    {
+        LOG_ERROR("Invalid pool config: " + m_config.getSummary());
+        throw std::invalid_argument("Invalid pool config: " + m_config.getSummary());
+    }
+
+    // 1. 整理数据库实例，单数据库模式也统一为一个实例
+    m_instances = m_config.dbInstances;
+    if (m_instances.empty())
+        m_instances.emplace_back(m_config.host, m_config.user, m_config.password, m_config.database, m_config.port);
+    for (const DBConfig &instance : m_instances)
+        m_totalWeight += std::max(instance.weight, 1u);
+    m_instanceConnections.assign(m_instances.size(), 0);
+
+    // 2. 所有连接共享同一个查询缓存
+    if (m_config.queryCacheSize > 0)
+        m_queryCache = std::make_shared<QueryCache>(m_config.queryCacheSize, m_config.queryCacheTtl);
+    if (m_config.enablePerformanceStat)
+        m_metrics = std::make_shared<PoolMetrics>();
+    if (m_config.enablePerformanceStat && m_config.queryStatsCapacity > 0)
+        m_queryStats = std::make_shared<QueryStats>(m_config.queryStatsCapacity);
+    m_interceptor = m_config.interceptor;
+    if (m_config.slowQueryThreshold > 0)
+        m_slowQueryLog = std::make_shared<SlowQueryLog>(m_config.slowQueryLogFile, m_config.slowQueryThreshold * 1000ull,
+                                                        m_config.slowQuerySampleRate, m_config.slowQueryMaxSqlLength);
+
+    // 3. 创建初始连接，失败不影响连接池的创建，之后按需重新创建
+    for (unsigned int i = 0; i < m_config.initConnections; ++i)
+    {
+        std::unique_ptr<Connection> conn = createConnection();
+        if (!conn)
+            break;
+        m_idle.push_back(std::move(conn));
+        ++m_totalConnections;
+    }
+
+    // 4. 自适应连接数从初始连接数开始，由维护线程调整；维护线程同时负责轮换到期的连接
+    if (m_config.adaptiveSizing)
+        m_targetConnections = std::max(m_config.initConnections, m_config.minConnections);
+    if (m_config.adaptiveSizing || m_config.maxLifetime > 0)
+        m_maintenanceThread = std::thread(&ConnectionPool::maintenanceLoop, this);
+
+    LOG_INFO("Connection pool created with " + std::to_string(m_totalConnections) + " connections, " +
+             m_config.getSummary());
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    {
+        std::lock_guard<PoolMutex> lock(m_mutex);
+        m_closing = true;
+        m_maintenanceCv.notify_all();
+        for (const WaiterList &waiters : m_waiters)
+        {
+            for (Waiter *waiter : waiters)
+                waiter->cv.notify_one();
+        }
+    }
+    if (m_maintenanceThread.joinable())
+        m_maintenanceThread.join();
+
+    std::deque<std::unique_ptr<Connection>> idle;
+    {
+        std::unique_lock<PoolMutex> lock(m_mutex);
+        // 借出的连接归还时、等待者退出时都会引用连接池，必须等待全部结束
+        m_available.wait(lock, [this] {
+            return m_activeConnections == 0 && m_waiters[0].empty() && m_waiters[1].empty() && m_waiters[2].empty();
+        });
+        idle.swap(m_idle);
+        m_totalConnections = 0;
+    }
+    // 在锁外关闭连接
+    idle.clear();
+    LOG_INFO("Connection pool destroyed");
+}
+
+// =============================
+// 连接获取方法
+// =============================
+
+ConnectionPtr ConnectionPool::getConnection(AcquirePriority priority)
+{
+    return getConnection(std::chrono::steady_clock::now() + std::chrono::milliseconds(m_config.connectionTimeout),
+                         priority);
+}
+
+ConnectionPtr ConnectionPool::getConnection(std::chrono::steady_clock::time_point deadline, AcquirePriority priority)
+{
+    auto requestTime = std::chrono::steady_clock::now();
+    if (!m_interceptor && !POOL_PROBE_ENABLED(acquire))
+        return acquireConnection(deadline, priority, requestTime);
+
+    PoolInterceptor::AcquireEvent event;
+    event.priority = static_cast<int>(priority);
+    if (m_interceptor)
+        m_interceptor->onAcquireStart(event);
+    ConnectionPtr conn;
+    try
+    {
+        conn = acquireConnection(deadline, priority, requestTime);
+    }
+    catch (...)
+    {
+        // 被过载保护拒绝时同样结束这次借出
+        event.waitMicros = elapsedMicros(requestTime);
+        notifyAcquireEnd(event);
+        throw;
+    }
+    event.waitMicros = elapsedMicros(requestTime);
+    event.connection = conn.get();
+    notifyAcquireEnd(event);
+    return conn;
+}
+
+void ConnectionPool::notifyAcquireEnd(const PoolInterceptor::AcquireEvent &event)
+{
+    if (m_interceptor)
+        m_interceptor->onAcquireEnd(event);
+    if (POOL_PROBE_ENABLED(acquire))
+        POOL_PROBE3(acquire, event.connection ? event.connection->getConnectionId().c_str() : "", event.waitMicros,
+                    event.priority);
+}
+
+ConnectionPtr ConnectionPool::acquireConnection(std::chrono::steady_clock::time_point deadline,
+                                                AcquirePriority priority,
+                                                std::chrono::steady_clock::time_point requestTime)
+{
+    std::unique_lock<PoolMutex> lock(m_mutex);
+
+    while (!m_closing)
+    {
+        // 已经超时的请求不再借出或者创建连接，包括截止时间已经过去才调用的getConnection
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+
+        // 相同或者更高优先级的线程在排队时不能插队；借出数达到这个优先级的上限时，剩下的连接是为更高优先级预留的
+        if (!hasWaitersAtOrAbove(priority) && m_activeConnections < borrowLimit(priority))
+        {
+            // 1. 优先使用最近归还的空闲连接，它们最可能仍然有效
+            if (!m_idle.empty())
+            {
+                std::unique_ptr<Connection> conn = std::move(m_idle.back());
+                m_idle.pop_back();
+                ++m_activeConnections;
+                lock.unlock();
+
+                if (isUsable(*conn))
+                    return handOutConnection(std::move(conn), deadline, priority, requestTime);
+
+                LOG_WARNING("Discard invalid idle connection [" + conn->getConnectionId() + "]");
+                if (m_metrics)
+                    m_metrics->increment(PoolMetrics::RECONNECT);
+                POOL_PROBE1(reconnect, conn->getConnectionId().c_str());
+                size_t instance = instanceOf(*conn);
+                conn.reset();
+                lock.lock();
+                --m_instanceConnections[instance];
+                releaseSlot();
+                continue;
+            }
+
+            // 2. 没有空闲连接，但是还可以创建新连接，先占住名额，再在锁外创建
+            if (m_totalConnections < m_targetConnections)
+            {
+                ++m_totalConnections;
+                ++m_activeConnections;
+                lock.unlock();
+
+                std::unique_ptr<Connection> conn = createConnection();
+                if (conn)
+                    return handOutConnection(std::move(conn), deadline, priority, requestTime);
+
+                lock.lock();
+                releaseSlot();
+                return nullptr;
+            }
+        }
+
+        // 3. 排到自己优先级的队尾，等待归还者把连接或者创建名额直接交过来
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            break;
+
+        // 过载时与其排到超时，不如立即失败，让上游尽快降级
+        std::string reason;
+        if (!admitWaiter(priority, now, reason))
+        {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            m_windowTimeouts.fetch_add(1, std::memory_order_relaxed);
+            lock.unlock();
+            if (m_metrics)
+                m_metrics->increment(PoolMetrics::ACQUIRE_REJECTED);
+            LOG_WARNING("Reject connection request, priority: " + std::to_string(static_cast<int>(priority)) + ", " +
+                        reason);
+            throw PoolOverloadException("Connection pool overloaded, " + reason);
+        }
+
+        Waiter waiter;
+        waiter.deadline = deadline;
+        waiter.enqueueTime = now;
+        waiter.priority = priority;
+        WaiterList &waiters = m_waiters[static_cast<size_t>(priority)];
+        WaiterList::iterator position = waiters.insert(waiters.end(), &waiter);
+        while (!waiter.conn && !waiter.permit && !m_closing)
+        {
+            if (waiter.cv.wait_until(lock, deadline) == std::cv_status::timeout)
+                break;
+        }
+        if (waiter.queued)
+            waiters.erase(position);
+        if (m_closing)
+            m_available.notify_all();
+
+        if (waiter.conn)
+        {
+            std::unique_ptr<Connection> conn = std::move(waiter.conn);
+            lock.unlock();
+            if (isUsable(*conn))
+                return handOutConnection(std::move(conn), deadline, priority, requestTime);
+
+            LOG_WARNING("Discard invalid idle connection [" + conn->getConnectionId() + "]");
+            if (m_metrics)
+                m_metrics->increment(PoolMetrics::RECONNECT);
+            POOL_PROBE1(reconnect, conn->getConnectionId().c_str());
+            size_t instance = instanceOf(*conn);
+            conn.reset();
+            lock.lock();
+            --m_instanceConnections[instance];
+            releaseSlot();
+            continue;
+        }
+        if (waiter.permit)
+        {
+            lock.unlock();
+            std::unique_ptr<Connection> conn = createConnection();
+            if (conn)
+                return handOutConnection(std::move(conn), deadline, priority, requestTime);
+
+            lock.lock();
+            releaseSlot();
+            return nullptr;
+        }
+        if (!m_closing)
+            break;
+    }
+
+    if (m_closing)
+    {
+        LOG_WARNING("Connection pool is closing, cannot get connection");
+        return nullptr;
+    }
+    recordAcquireTimeout(priority);
+    return nullptr;
+}
+
+void ConnectionPool::releaseSlot()
+{
+    --m_activeConnections;
+    --m_totalConnections;
+    dispatchToWaiters();
+    // 析构函数在等待借出数归零
+    m_available.notify_all();
+}
+
+void ConnectionPool::recordAcquireTimeout(AcquirePriority priority)
+{
+    m_windowTimeouts.fetch_add(1, std::memory_order_relaxed);
+    if (m_metrics)
+        m_metrics->increment(PoolMetrics::ACQUIRE_TIMEOUT);
+    LOG_WARNING("Timeout waiting for connection, priority: " + std::to_string(static_cast<int>(priority)) +
+                ", active: " + std::to_string(m_activeConnections));
+}
+
+ConnectionPtr ConnectionPool::handOutConnection(std::unique_ptr<Connection> conn,
+                                                std::chrono::steady_clock::time_point deadline,
+                                                AcquirePriority priority,
+                                                std::chrono::steady_clock::time_point requestTime)
+{
+    if (std::chrono::steady_clock::now() < deadline)
+        return wrapConnection(std::move(conn), requestTime);
+
+    // 建立连接或者ping的过程中已经超时，请求方不会再使用它，交给其他等待者或者放回空闲队列
+    returnToPool(std::move(conn), false, 0);
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    recordAcquireTimeout(priority);
+    return nullptr;
+}
+
+// =============================
+// 查询方法
+// =============================
+
+ColumnarResultPtr ConnectionPool::executeSharedQuery(const std::string &sql)
+{
+    // 1. 先查询缓存，命中时不需要任何协调
+    if (m_queryCache)
+    {
+        ColumnarResultPtr cached = m_queryCache->get(sql);
+        if (cached)
+            return cached;
+    }
+
+    // 2. 查找是否已经有相同的查询正在执行，没有则成为执行者
+    std::string key = QueryCache::normalizeSql(sql);
+    std::promise<ColumnarResultPtr> promise;
+    std::shared_future<ColumnarResultPtr> future;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(m_flightMutex);
+        auto it = m_flights.find(key);
+        if (it != m_flights.end())
+        {
+            future = it->second;
+        }
+        else
+        {
+            future = promise.get_future().share();
+            m_flights.emplace(key, future);
+            leader = true;
+        }
+    }
+
+    // 3. 等待者不占用连接，直接等待执行者的结果；执行者抛出的异常会在这里重新抛出
+    if (!leader)
+    {
+        m_coalescedQueries.fetch_add(1, std::memory_order_relaxed);
+        return future.get();
+    }
+
+    // 4. 执行者借出连接执行查询
+    try
+    {
+        ConnectionPtr conn = getConnection();
+        if (!conn)
+            throw std::runtime_error("Failed to get connection within " +
+                                     std::to_string(m_config.connectionTimeout) + "ms");
+
+        // 代数必须在查询之前读取，查询期间发生的失效会让put放弃写入
+        uint64_t generation = m_queryCache ? m_queryCache->getGeneration() : 0;
+        ColumnarResultPtr result = std::make_shared<const ColumnarResult>(conn->executeQuery(sql)->toColumns());
+        if (m_queryCache)
+            m_queryCache->put(sql, result, generation);
+
+        // 先移除再通知：之后到达的相同查询会发起新的执行，而不是拿到已经完成的旧结果
+        {
+            std::lock_guard<std::mutex> lock(m_flightMutex);
+            m_flights.erase(key);
+        }
+        promise.set_value(result);
+        return result;
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_flightMutex);
+            m_flights.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+// =============================
+// 状态查询方法
+// =============================
+
+size_t ConnectionPool::getIdleCount() const
+{
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    return m_idle.size();
+}
+
+size_t ConnectionPool::getActiveCount() const
+{
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    return m_activeConnections;
+}
+
+size_t ConnectionPool::getTotalCount() const
+{
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    return m_totalConnections;
+}
+
+size_t ConnectionPool::getTargetCount() const
+{
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    return m_targetConnections;
+}
+
+size_t ConnectionPool::getWaiterCount() const
+{
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    return m_waiters[0].size() + m_waiters[1].size() + m_waiters[2].size();
+}
+
+std::vector<ConnectionPool::InstanceStats> ConnectionPool::getInstanceStats() const
+{
+    std::vector<InstanceStats> stats(m_instances.size());
+    for (size_t i = 0; i < m_instances.size(); ++i)
+        stats[i].connectionStr = m_instances[i].getConnectionStr();
+
+    std::lock_guard<PoolMutex> lock(m_mutex);
+    for (size_t i = 0; i < m_instances.size(); ++i)
+        stats[i].total = m_instanceConnections[i];
+    for (const std::unique_ptr<Connection> &conn : m_idle)
+        ++stats[instanceOf(*conn)].idle;
+    // 已经建立的连接中，不空闲的就是借出的
+    for (InstanceStats &instance : stats)
+        instance.active = instance.total > instance.idle ? instance.total - instance.idle : 0;
+    return stats;
+}
+
+std::vector<QueryStats::Entry> ConnectionPool::getTopQueries(size_t n) const
+{
+    return m_queryStats ? m_queryStats->top(n) : std::vector<QueryStats::Entry>();
+}
+
+void ConnectionPool::renderPrometheus(std::string &out) const
+{
+    PrometheusExporter::render(*this, out);
+}
+
+// =============================
+// 私有方法
+// =============================
+
+std::unique_ptr<Connection> ConnectionPool::createConnection()
+{
+    // 加权轮询：权重为w的实例在每一轮中连续分到w个位置
+    unsigned int slot;
+    {
+        std::lock_guard<PoolMutex> lock(m_mutex);
+        slot = m_nextSlot;
+        m_nextSlot = (m_nextSlot + 1) % m_totalWeight;
+    }
+    const DBConfig *instance = &m_instances.front();
+    for (const DBConfig &candidate : m_instances)
+    {
+        unsigned int weight = std::max(candidate.weight, 1u);
+        if (slot < weight)
+        {
+            instance = &candidate;
+            break;
+        }
+        slot -= weight;
+    }
+
+    try
+    {
+        std::unique_ptr<Connection> conn(new Connection(instance->host, instance->user, instance->password,
+                                                        instance->database, instance->port));
+        // 在connect之前设置，才能记录建立连接的耗时
+        if (m_metrics)
+            conn->setMetrics(m_metrics);
+        if (m_queryStats)
+            conn->setQueryStats(m_queryStats);
+        if (m_slowQueryLog)
+            conn->setSlowQueryLog(m_slowQueryLog);
+        if (m_interceptor)
+            conn->setInterceptor(m_interceptor);
+        if (!conn->connect())
+        {
+            LOG_ERROR("Pool failed to connect to " + instance->getConnectionStr() + ": " + conn->getLastError());
+            return nullptr;
+        }
+        if (m_queryCache)
+            conn->setQueryCache(m_queryCache);
+        {
+            std::lock_guard<PoolMutex> lock(m_mutex);
+            ++m_instanceConnections[instance - &m_instances.front()];
+        }
+        return conn;
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("Pool failed to create connection to " + instance->getConnectionStr() + ": " + e.what());
+        return nullptr;
+    }
+}
+
+void ConnectionPool::maintenanceLoop()
+{
+    auto interval = std::chrono::milliseconds(m_config.adaptiveSizing ? m_config.adaptiveInterval : kMaintenanceInterval);
+    std::unique_lock<PoolMutex> lock(m_mutex);
+    auto next = std::chrono::steady_clock::now() + interval;
+    while (!m_maintenanceCv.wait_until(lock, next, [this] { return m_closing; }))
+    {
+        lock.unlock();
+        if (m_config.adaptiveSizing)
+            adjustPoolSize();
+        if (m_config.maxLifetime > 0)
+            rotateExpiredConnections();
+        lock.lock();
+        next = std::chrono::steady_clock::now() + interval;
+    }
+}
+
+size_t ConnectionPool::instanceOf(const Connection &conn) const
+{
+    if (m_instances.size() == 1)
+        return 0;
+    std::string connectionStr = conn.getConnectionStr();
+    for (size_t i = 0; i < m_instances.size(); ++i)
+    {
+        if (m_instances[i].getConnectionStr() == connectionStr)
+            return i;
+    }
+    return 0;
+}
+
+int64_t ConnectionPool::expireTime(const Connection &conn) const
+{
+    // 连接标识符是随机生成的，用它的哈希作为抖动：同一个连接每次算出来相同，不同连接均匀分散
+    int64_t jitterRange = static_cast<int64_t>(m_config.maxLifetime * kLifetimeJitter);
+    int64_t jitter = jitterRange > 0 ? std::hash<std::string>()(conn.getConnectionId()) % jitterRange : 0;
+    return conn.getCreationTime() + m_config.maxLifetime - jitter;
+}
+
+void ConnectionPool::rotateExpiredConnections()
+{
+    // 1. 找出到期的空闲连接，只记录标识符，连接仍然留在空闲队列中，可以照常借出
+    std::vector<std::string> expired;
+    int64_t now = Utils::currentTimeMillis();
+    {
+        std::lock_guard<PoolMutex> lock(m_mutex);
+        for (const std::unique_ptr<Connection> &conn : m_idle)
+        {
+            if (now >= expireTime(*conn))
+                expired.push_back(conn->getConnectionId());
+        }
+    }
+
+    for (const std::string &id : expired)
+    {
+        // 2. 先在锁外建立新连接，数据库暂时不可用时旧连接继续使用，下个周期再试
+        std::unique_ptr<Connection> fresh = createConnection();
+        if (!fresh)
+            return;
+
+        // 3. 旧连接仍然空闲时原地替换；已经被借出时，新连接在不超过上限的情况下作为普通的空闲连接补充进来
+        std::unique_ptr<Connection> retired;
+        {
+            std::lock_guard<PoolMutex> lock(m_mutex);
+            if (m_closing)
+                return;
+            auto it = std::find_if(m_idle.begin(), m_idle.end(), [&id](const std::unique_ptr<Connection> &conn) {
+                return conn->getConnectionId() == id;
+            });
+            if (it != m_idle.end())
+            {
+                retired = std::move(*it);
+                *it = std::move(fresh);
+                --m_instanceConnections[instanceOf(*retired)];
+                m_rotated.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (m_totalConnections < m_targetConnections)
+            {
+                m_idle.push_back(std::move(fresh));
+                ++m_totalConnections;
+                dispatchToWaiters();
+            }
+            else
+            {
+                --m_instanceConnections[instanceOf(*fresh)];
+            }
+        }
+        if (retired)
+            LOG_INFO("Rotate connection [" + id + "] after " +
+                     std::to_string(Utils::currentTimeMillis() - retired->getCreationTime()) + "ms");
+        // retired和没有用上的fresh在锁外析构，关闭连接
+    }
+}
+
+void ConnectionPool::adjustPoolSize()
+{
+    // 1. 取出上一个周期的采样
+    auto now = std::chrono::steady_clock::now();
+    double windowMicros = std::chrono::duration_cast<std::chrono::microseconds>(now - m_windowStart).count();
+    m_windowStart = now;
+    uint64_t borrows = m_windowBorrows.exchange(0, std::memory_order_relaxed);
+    uint64_t waitMicros = m_windowWaitMicros.exchange(0, std::memory_order_relaxed);
+    uint64_t holdMicros = m_windowHoldMicros.exchange(0, std::memory_order_relaxed);
+    uint64_t timeouts = m_windowTimeouts.exchange(0, std::memory_order_relaxed);
+    if (windowMicros <= 0)
+        return;
+
+    // Little定律：周期内平均占用的连接数 = 占用时间之和 / 周期长度
+    double busy = holdMicros / windowMicros;
+    double averageWaitMs = borrows > 0 ? waitMicros / 1000.0 / borrows : 0.0;
+
+    std::vector<std::unique_ptr<Connection>> retired;
+    size_t before, after;
+    {
+        std::lock_guard<PoolMutex> lock(m_mutex);
+        size_t waiting = m_waiters[0].size() + m_waiters[1].size() + m_waiters[2].size();
+        before = m_targetConnections;
+        after = before;
+
+        // 2. 有排队、超时或者平均等待过长：立即扩容，至少加1，排队的线程多时一次补足
+        if ((waiting > 0 || timeouts > 0 || averageWaitMs > m_config.targetWaitTime) && before < m_config.maxConnections)
+        {
+            size_t needed = static_cast<size_t>(std::ceil(busy * kSizingHeadroom)) + waiting;
+            after = std::min<size_t>(m_config.maxConnections, std::max(before + 1, needed));
+            m_lowWindows = 0;
+        }
+        // 3. 利用率偏低：连续kShrinkWindows个周期之后才按比例收缩，避免在负载边界来回抖动
+        else if (busy < before * kShrinkUtilization && before > m_config.minConnections)
+        {
+            if (++m_lowWindows >= kShrinkWindows)
+            {
+                after = std::max<size_t>(m_config.minConnections, static_cast<size_t>(before * kShrinkFactor));
+                m_lowWindows = 0;
+            }
+        }
+        else
+        {
+            m_lowWindows = 0;
+        }
+
+        m_targetConnections = after;
+        if (after > before)
+        {
+            // 上限提高了，排队的线程可以创建新连接
+            dispatchToWaiters();
+        }
+        else if (after < before)
+        {
+            // 先关闭最久没有使用的空闲连接，借出的连接归还时再关闭
+            while (m_totalConnections > m_targetConnections && !m_idle.empty())
+            {
+                retired.push_back(std::move(m_idle.front()));
+                m_idle.pop_front();
+                --m_totalConnections;
+                --m_instanceConnections[instanceOf(*retired.back())];
+            }
+        }
+    }
+
+    if (after != before)
+        LOG_INFO("Adaptive pool size " + std::to_string(before) + " -> " + std::to_string(after) +
+                 ", busy: " + std::to_string(busy) + ", average wait: " + std::to_string(averageWaitMs) +
+                 "ms, timeouts: " + std::to_string(timeouts));
+    // retired在锁外析构，关闭连接
+}
+
+ConnectionPtr ConnectionPool::wrapConnection(std::unique_ptr<Connection> conn,
+                                             std::chrono::steady_clock::time_point requestTime)
+{
+    auto borrowTime = std::chrono::steady_clock::now();
+    uint64_t waitMicros = std::chrono::duration_cast<std::chrono::microseconds>(borrowTime - requestTime).count();
+    m_windowBorrows.fetch_add(1, std::memory_order_relaxed);
+    m_windowWaitMicros.fetch_add(waitMicros, std::memory_order_relaxed);
+    if (m_metrics)
+        m_metrics->record(PoolMetrics::ACQUIRE_WAIT, waitMicros);
+
+    // 删除器不会真正删除连接，而是归还给连接池
+    return ConnectionPtr(conn.release(),
+                         [this, borrowTime](Connection *released) { releaseConnection(released, borrowTime); });
+}
+
+void ConnectionPool::releaseConnection(Connection *conn, std::chrono::steady_clock::time_point borrowTime)
+{
+    uint64_t holdMicros = elapsedMicros(borrowTime);
+    m_windowHoldMicros.fetch_add(holdMicros, std::memory_order_relaxed);
+    if (POOL_PROBE_ENABLED(release))
+        POOL_PROBE2(release, conn->getConnectionId().c_str(), holdMicros);
+    std::unique_ptr<Connection> owned(conn);
+    // 连接已经断开，放回连接池只会让下一个借出者失败
+    unsigned int errorCode = owned->getLastErrorCode();
+    bool broken = errorCode == CR_SERVER_GONE_ERROR || errorCode == CR_SERVER_LOST;
+
+    // 借出者留下的会话状态会影响下一个借出者，在锁外重置，重置失败的连接不能再用
+    if (!broken && m_config.resetSessionOnRelease && owned->isSessionDirty())
+    {
+        m_sessionResets.fetch_add(1, std::memory_order_relaxed);
+        if (!owned->resetSession())
+        {
+            broken = true;
+            errorCode = owned->getLastErrorCode();
+        }
+    }
+
+    returnToPool(std::move(owned), broken, errorCode);
+}
+
+void ConnectionPool::returnToPool(std::unique_ptr<Connection> owned, bool broken, unsigned int errorCode)
+{
+    std::unique_lock<PoolMutex> lock(m_mutex);
+    --m_activeConnections;
+    // 自适应连接数收缩之后，多出来的连接在归还时关闭
+    if (broken || m_closing || m_totalConnections > m_targetConnections)
+    {
+        --m_totalConnections;
+        --m_instanceConnections[instanceOf(*owned)];
+        // 连接数减少了，等待者可以创建新连接
+        if (!m_closing)
+            dispatchToWaiters();
+        m_available.notify_all();
+        lock.unlock();
+        if (broken)
+        {
+            LOG_WARNING("Discard broken connection [" + owned->getConnectionId() + "], error: " +
+                        std::to_string(errorCode));
+            if (m_metrics)
+                m_metrics->increment(PoolMetrics::RECONNECT);
+            POOL_PROBE1(reconnect, owned->getConnectionId().c_str());
+        }
+        // owned在锁外析构，关闭连接
+        return;
+    }
+
+    // 先放回空闲队列的末尾，如果有等待者，会被立刻交出去；
+    // 到期的连接放到最前面，借出时排在最后，让它保持空闲、等待后台轮换
+    if (m_config.maxLifetime > 0 && Utils::currentTimeMillis() >= expireTime(*owned))
+        m_idle.push_front(std::move(owned));
+    else
+        m_idle.push_back(std::move(owned));
+    dispatchToWaiters();
+}
+
+bool ConnectionPool::isUsable(Connection &conn) const
+{
+    // 空闲时间超过健康检测周期的连接，借出前先ping一次
+    return Utils::currentTimeMillis() - conn.getLastActiveTime() < m_config.healthCheckPeriod || conn.isValid();
+}
+
+size_t ConnectionPool::borrowLimit(AcquirePriority priority) const
+{
+    size_t reserved = 0;
+    if (priority != AcquirePriority::CRITICAL)
+        reserved += m_config.criticalReserved;
+    if (priority == AcquirePriority::BATCH)
+        reserved += m_config.normalReserved;
+    // 预留的是当前上限中的最后几个连接，上限小于预留数时低优先级只能排队，排队会推动自适应扩容
+    return m_targetConnections > reserved ? m_targetConnections - reserved : 0;
+}
+
+bool ConnectionPool::admitWaiter(AcquirePriority priority, std::chrono::steady_clock::time_point now,
+                                 std::string &reason)
+{
+    // 1. 等待队列有上限，排队的线程再多也只会一起超时
+    size_t waiting = m_waiters[0].size() + m_waiters[1].size() + m_waiters[2].size();
+    if (m_config.maxWaiters > 0 && waiting >= m_config.maxWaiters)
+    {
+        reason = "waiters: " + std::to_string(waiting);
+        return false;
+    }
+    if (m_config.queueTargetDelay == 0)
+        return true;
+
+    // 2. CoDel：看最早排队的等待者已经等了多久。突发的排队很快就会消化，
+    //    只有连续queueInterval都超过目标，才说明到达的速度持续超过了归还的速度
+    auto oldest = now;
+    for (const WaiterList &waiters : m_waiters)
+    {
+        if (!waiters.empty())
+            oldest = std::min(oldest, waiters.front()->enqueueTime);
+    }
+    auto sojourn = std::chrono::duration_cast<std::chrono::milliseconds>(now - oldest);
+    if (sojourn.count() < m_config.queueTargetDelay)
+    {
+        m_firstAboveTime = std::chrono::steady_clock::time_point();
+        m_shedding = false;
+    }
+    else if (m_firstAboveTime == std::chrono::steady_clock::time_point())
+    {
+        m_firstAboveTime = now + std::chrono::milliseconds(m_config.queueInterval);
+    }
+    else if (now >= m_firstAboveTime)
+    {
+        m_shedding = true;
+    }
+
+    // 3. 拒绝期间队列只出不进，逗留时间回到目标以下就恢复；CRITICAL有预留的连接，不会被拒绝
+    if (m_shedding && priority != AcquirePriority::CRITICAL)
+    {
+        reason = "queue delay: " + std::to_string(sojourn.count()) + "ms";
+        return false;
+    }
+    return true;
+}
+
+bool ConnectionPool::hasWaitersAtOrAbove(AcquirePriority priority) const
+{
+    for (size_t i = 0; i <= static_cast<size_t>(priority); ++i)
+    {
+        if (!m_waiters[i].empty())
+            return true;
+    }
+    return false;
+}
+
+ConnectionPool::Waiter *ConnectionPool::popEligibleWaiter()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kPriorityCount; ++i)
+    {
+        // 这个优先级已经用满了自己的上限，更低的优先级上限更小，也不能服务
+        if (m_activeConnections >= borrowLimit(static_cast<AcquirePriority>(i)))
+            return nullptr;
+
+        WaiterList &waiters = m_waiters[i];
+        while (!waiters.empty())
+        {
+            Waiter *waiter = waiters.front();
+            waiters.pop_front();
+            waiter->queued = false;
+            // 已经超时的请求拿到连接也没有意义，跳过它，由它自己醒来后返回nullptr
+            if (waiter->deadline > now)
+                return waiter;
+        }
+    }
+    return nullptr;
+}
+
+void ConnectionPool::dispatchToWaiters()
+{
+    // 每一轮交出一个空闲连接，或者一个创建新连接的名额
+    while (!m_idle.empty() || m_totalConnections < m_targetConnections)
+    {
+        Waiter *waiter = popEligibleWaiter();
+        if (!waiter)
+            return;
+
+        ++m_activeConnections;
+        if (!m_idle.empty())
+        {
+            waiter->conn = std::move(m_idle.back());
+            m_idle.pop_back();
+        }
+        else
+        {
+            // 名额在这里计入，等待者醒来后在锁外创建连接
+            ++m_totalConnections;
+            waiter->permit = true;
+        }
+        waiter->cv.notify_one();
+    }
+}
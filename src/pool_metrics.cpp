@@ -0,0 +1,219 @@
+#include "pool_metrics.h"
+#include "profiled_mutex.h"
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 连接池性能统计的实现
+ */
+
+// 类内初始化的static const成员被ODR使用时需要定义（C++14）
+const unsigned int PoolMetrics::kSubBucketBits;
+const size_t PoolMetrics::kSubBucketCount;
+const size_t PoolMetrics::kBucketCount;
+
+namespace
+{
+    std::atomic<uint64_t> g_nextMetricsId{1};   // 统计对象的编号，从1开始，0表示线程还没有缓存分片
+
+    /**
+     * @brief 把一个分片的计数累加到汇总结果中
+     */
+    void accumulate(std::vector<uint64_t> &buckets, const std::atomic<uint64_t> *cells, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            buckets[i] += cells[i].load(std::memory_order_relaxed);
+    }
+}
+
+// =============================
+// 构造函数和析构函数
+// =============================
+
+PoolMetrics::Shard::Shard() : inUse(true)
+{
+    // std::atomic的默认构造不会初始化
+    for (HistogramCells &cells : histograms)
+    {
+        for (std::atomic<uint64_t> &bucket : cells.buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        cells.sum.store(0, std::memory_order_relaxed);
+        cells.max.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t> &counter : counters)
+        counter.store(0, std::memory_order_relaxed);
+}
+
+PoolMetrics::PoolMetrics() : m_id(g_nextMetricsId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+PoolMetrics::~PoolMetrics() = default;
+
+// =============================
+// 记录方法
+// =============================
+
+void PoolMetrics::recordError(unsigned int errorCode)
+{
+    increment(ERROR_TOTAL);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_errors[errorCode];
+}
+
+PoolMetrics::Shard *PoolMetrics::attachShard()
+{
+    // 线程持有自己用过的所有分片，线程退出时把分片标记为空闲；
+    // 分片由shared_ptr共同持有，统计对象先销毁也不会访问已经释放的内存
+    struct ThreadShards
+    {
+        std::unordered_map<uint64_t, ShardPtr> shards;
+        ~ThreadShards()
+        {
+            for (auto &entry : shards)
+                entry.second->inUse.store(false, std::memory_order_release);
+        }
+    };
+    thread_local ThreadShards owned;
+
+    auto it = owned.shards.find(m_id);
+    if (it != owned.shards.end())
+        return it->second.get();
+
+    ShardPtr shard;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // 优先复用已经退出的线程留下的分片，计数是累加的，换一个写者不影响结果
+        for (const ShardPtr &candidate : m_shards)
+        {
+            bool expected = false;
+            if (candidate->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                shard = candidate;
+                break;
+            }
+        }
+        if (!shard)
+        {
+            shard = std::make_shared<Shard>();
+            m_shards.push_back(shard);
+        }
+    }
+    owned.shards.emplace(m_id, shard);
+    return shard.get();
+}
+
+// =============================
+// 读取方法
+// =============================
+
+PoolMetrics::Snapshot PoolMetrics::snapshot() const
+{
+    Snapshot result;
+    for (HistogramSnapshot &histogram : result.histograms)
+        histogram.buckets.assign(kBucketCount, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const ShardPtr &shard : m_shards)
+        {
+            for (size_t h = 0; h < HISTOGRAM_COUNT; ++h)
+            {
+                const HistogramCells &cells = shard->histograms[h];
+                HistogramSnapshot &histogram = result.histograms[h];
+                accumulate(histogram.buckets, cells.buckets, kBucketCount);
+                histogram.sum += cells.sum.load(std::memory_order_relaxed);
+                histogram.max = std::max(histogram.max, cells.max.load(std::memory_order_relaxed));
+            }
+            for (size_t c = 0; c < COUNTER_COUNT; ++c)
+                result.counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+        }
+        result.errors = m_errors;
+    }
+
+    for (HistogramSnapshot &histogram : result.histograms)
+        histogram.summarize();
+#ifdef MYSQL_POOL_LOCK_PROFILING
+    result.locks = LockProfiler::instance().snapshot();
+#endif
+    return result;
+}
+
+void PoolMetrics::HistogramSnapshot::summarize()
+{
+    count = 0;
+    for (uint64_t n : buckets)
+        count += n;
+    p50 = valueAt(0.5);
+    p90 = valueAt(0.9);
+    p99 = valueAt(0.99);
+    p999 = valueAt(0.999);
+}
+
+uint64_t PoolMetrics::HistogramSnapshot::valueAt(double quantile) const
+{
+    if (count == 0)
+        return 0;
+    // 第rank个值所在的桶，rank从1开始
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * count));
+    rank = std::min(std::max<uint64_t>(rank, 1), count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max);
+    }
+    return max;
+}
+
+const char *PoolMetrics::histogramName(Histogram histogram)
+{
+    switch (histogram)
+    {
+    case ACQUIRE_WAIT:
+        return "acquire_wait";
+    case QUERY:
+        return "query";
+    case UPDATE:
+        return "update";
+    case TRANSACTION:
+        return "transaction";
+    case CONNECT:
+        return "connect";
+    case PING:
+        return "ping";
+    default:
+        return "unknown";
+    }
+}
+
+const char *PoolMetrics::counterName(Counter counter)
+{
+    switch (counter)
+    {
+    case ACQUIRE_TIMEOUT:
+        return "acquire_timeout";
+    case ACQUIRE_REJECTED:
+        return "acquire_rejected";
+    case RECONNECT:
+        return "reconnect";
+    case CONNECT_FAILURE:
+        return "connect_failure";
+    case ERROR_TOTAL:
+        return "error";
+    default:
+        return "unknown";
+    }
+}
+
+uint64_t PoolMetrics::bucketUpperBound(size_t index)
+{
+    if (index < kSubBucketCount)
+        return index;
+    // bucketIndex的逆运算：桶的下界是(kSubBucketCount + sub) << shift，宽度是1 << shift
+    size_t shift = index / kSubBucketCount - 1;
+    uint64_t sub = index % kSubBucketCount;
+    return ((kSubBucketCount + sub) << shift) + ((uint64_t(1) << shift) - 1);
+}
@@ -0,0 +1,24 @@
+#include "pool_probes.h"
+
+/**
+ * @brief USDT探针的信号量，挂载探针的工具通过修改它们通知程序计算探针的参数
+ */
+
+#ifdef MYSQL_POOL_USDT
+
+// 信号量必须放在.probes段中，工具才能找到它们
+#define POOL_PROBE_DEFINE(name) \
+    __extension__ unsigned short POOL_PROBE_SEMAPHORE(name) __attribute__((unused, section(".probes"))) = 0
+
+extern "C"
+{
+    POOL_PROBE_DEFINE(acquire);
+    POOL_PROBE_DEFINE(release);
+    POOL_PROBE_DEFINE(query_start);
+    POOL_PROBE_DEFINE(query_end);
+    POOL_PROBE_DEFINE(connect);
+    POOL_PROBE_DEFINE(reconnect);
+    POOL_PROBE_DEFINE(log);
+}
+
+#endif  // MYSQL_POOL_USDT
@@ -0,0 +1,90 @@
+#include "profiled_mutex.h"
+#include <algorithm>
+
+/**
+ * @brief 锁竞争统计的实现
+ */
+
+// 类内初始化的static const成员被ODR使用时需要定义（C++14）
+const size_t LockProfiler::kStripeCount;
+
+namespace
+{
+    std::atomic<size_t> g_nextStripe{0};   // 按照线程第一次加锁的顺序轮流分配条带
+
+    size_t localStripe(size_t stripeCount)
+    {
+        thread_local size_t stripe = g_nextStripe.fetch_add(1, std::memory_order_relaxed) % stripeCount;
+        return stripe;
+    }
+
+    void updateMax(std::atomic<uint64_t> &max, uint64_t value)
+    {
+        uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            ;
+    }
+}
+
+LockProfiler &LockProfiler::instance()
+{
+    static LockProfiler profiler;
+    return profiler;
+}
+
+void LockProfiler::record(LockSite site, uint64_t waitNanos, uint64_t holdNanos, bool contended)
+{
+    Stripe &stripe = m_stripes[static_cast<size_t>(site)][localStripe(kStripeCount)];
+    stripe.wait.buckets[PoolMetrics::bucketIndex(waitNanos)].fetch_add(1, std::memory_order_relaxed);
+    stripe.wait.sum.fetch_add(waitNanos, std::memory_order_relaxed);
+    updateMax(stripe.wait.max, waitNanos);
+    stripe.hold.buckets[PoolMetrics::bucketIndex(holdNanos)].fetch_add(1, std::memory_order_relaxed);
+    stripe.hold.sum.fetch_add(holdNanos, std::memory_order_relaxed);
+    updateMax(stripe.hold.max, holdNanos);
+    if (contended)
+        stripe.contended.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<PoolMetrics::LockSnapshot> LockProfiler::snapshot() const
+{
+    std::vector<PoolMetrics::LockSnapshot> result;
+    for (size_t s = 0; s < static_cast<size_t>(LockSite::COUNT); ++s)
+    {
+        PoolMetrics::LockSnapshot lock;
+        lock.site = siteName(static_cast<LockSite>(s));
+        lock.wait.buckets.assign(PoolMetrics::kBucketCount, 0);
+        lock.hold.buckets.assign(PoolMetrics::kBucketCount, 0);
+        for (const Stripe &stripe : m_stripes[s])
+        {
+            for (size_t i = 0; i < PoolMetrics::kBucketCount; ++i)
+            {
+                lock.wait.buckets[i] += stripe.wait.buckets[i].load(std::memory_order_relaxed);
+                lock.hold.buckets[i] += stripe.hold.buckets[i].load(std::memory_order_relaxed);
+            }
+            lock.wait.sum += stripe.wait.sum.load(std::memory_order_relaxed);
+            lock.hold.sum += stripe.hold.sum.load(std::memory_order_relaxed);
+            lock.wait.max = std::max(lock.wait.max, stripe.wait.max.load(std::memory_order_relaxed));
+            lock.hold.max = std::max(lock.hold.max, stripe.hold.max.load(std::memory_order_relaxed));
+            lock.contended += stripe.contended.load(std::memory_order_relaxed);
+        }
+        lock.wait.summarize();
+        lock.hold.summarize();
+        result.push_back(std::move(lock));
+    }
+    return result;
+}
+
+const char *LockProfiler::siteName(LockSite site)
+{
+    switch (site)
+    {
+    case LockSite::POOL:
+        return "pool";
+    case LockSite::CONNECTION:
+        return "connection";
+    case LockSite::LOGGER:
+        return "logger";
+    default:
+        return "unknown";
+    }
+}
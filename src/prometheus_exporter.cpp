@@ -0,0 +1,211 @@
+#include "prometheus_exporter.h"
+#include "connection_pool.h"
+#include "pool_metrics.h"
+#include <cstdio>
+#include <cinttypes>
+#include <vector>
+
+/**
+ * @brief 连接池状态到Prometheus文本格式的导出的实现
+ */
+
+namespace
+{
+    /**
+     * @brief 直方图的桶边界
+     */
+    struct Bound
+    {
+        uint64_t micros;    // 边界（微秒），内部的桶按照桶内的最大值归入第一个不小于它的边界
+        const char *label;  // le标签（秒）
+    };
+
+    const Bound kBounds[] = {
+        {100, "0.0001"}, {250, "0.00025"}, {500, "0.0005"},
+        {1000, "0.001"}, {2500, "0.0025"}, {5000, "0.005"},
+        {10000, "0.01"}, {25000, "0.025"}, {50000, "0.05"},
+        {100000, "0.1"}, {250000, "0.25"}, {500000, "0.5"},
+        {1000000, "1"}, {2500000, "2.5"}, {5000000, "5"}, {10000000, "10"},
+    };
+
+    void appendUnsigned(std::string &out, uint64_t value)
+    {
+        char buffer[24];
+        int length = std::snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+        out.append(buffer, static_cast<size_t>(length));
+    }
+
+    void appendSeconds(std::string &out, uint64_t micros)
+    {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%" PRIu64 ".%06" PRIu64,
+                                   micros / 1000000, micros % 1000000);
+        out.append(buffer, static_cast<size_t>(length));
+    }
+
+    void appendHeader(std::string &out, const char *name, const char *type, const char *help)
+    {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+
+    /**
+     * @brief 输出一行没有标签的样本
+     */
+    void appendSample(std::string &out, const char *name, uint64_t value)
+    {
+        out += name;
+        out += ' ';
+        appendUnsigned(out, value);
+        out += '\n';
+    }
+
+    void appendCounter(std::string &out, const char *name, const char *help, uint64_t value)
+    {
+        appendHeader(out, name, "counter", help);
+        appendSample(out, name, value);
+    }
+
+    void appendGauge(std::string &out, const char *name, const char *help, uint64_t value)
+    {
+        appendHeader(out, name, "gauge", help);
+        appendSample(out, name, value);
+    }
+
+    void appendConnections(std::string &out, const std::string &instance, const char *state, size_t value)
+    {
+        out += "mysql_pool_connections{instance=\"";
+        PrometheusExporter::appendLabelValue(out, instance);
+        out += "\",state=\"";
+        out += state;
+        out += "\"} ";
+        appendUnsigned(out, value);
+        out += '\n';
+    }
+
+    /**
+     * @brief 把内部的对数线性分桶合并为固定边界的累计桶
+     */
+    void appendHistogram(std::string &out, PoolMetrics::Histogram kind,
+                         const PoolMetrics::HistogramSnapshot &histogram)
+    {
+        std::string name = "mysql_pool_";
+        name += PoolMetrics::histogramName(kind);
+        name += "_seconds";
+        appendHeader(out, name.c_str(), "histogram", "Latency in seconds.");
+
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (const Bound &bound : kBounds)
+        {
+            for (; bucket < histogram.buckets.size() &&
+                   PoolMetrics::bucketUpperBound(bucket) <= bound.micros; ++bucket)
+                cumulative += histogram.buckets[bucket];
+            out += name;
+            out += "_bucket{le=\"";
+            out += bound.label;
+            out += "\"} ";
+            appendUnsigned(out, cumulative);
+            out += '\n';
+        }
+        out += name;
+        out += "_bucket{le=\"+Inf\"} ";
+        appendUnsigned(out, histogram.count);
+        out += '\n';
+
+        out += name;
+        out += "_sum ";
+        appendSeconds(out, histogram.sum);
+        out += '\n';
+        out += name;
+        out += "_count ";
+        appendUnsigned(out, histogram.count);
+        out += '\n';
+    }
+}
+
+namespace PrometheusExporter
+{
+    void render(const ConnectionPool &pool, std::string &out)
+    {
+        // 1. 连接数
+        std::vector<ConnectionPool::InstanceStats> instances = pool.getInstanceStats();
+        appendHeader(out, "mysql_pool_connections", "gauge", "Connections per database instance and state.");
+        for (const ConnectionPool::InstanceStats &instance : instances)
+        {
+            appendConnections(out, instance.connectionStr, "idle", instance.idle);
+            appendConnections(out, instance.connectionStr, "active", instance.active);
+            appendConnections(out, instance.connectionStr, "total", instance.total);
+        }
+        appendGauge(out, "mysql_pool_waiters", "Threads waiting for a connection.", pool.getWaiterCount());
+        appendGauge(out, "mysql_pool_target_connections", "Current connection limit of the pool.",
+                    pool.getTargetCount());
+
+        // 2. 连接池自己的计数器，不依赖性能统计
+        appendCounter(out, "mysql_pool_coalesced_queries_total", "Queries served by an in-flight identical query.",
+                      pool.getCoalescedQueryCount());
+        appendCounter(out, "mysql_pool_rotated_total", "Connections replaced after maxLifetime.",
+                      pool.getRotatedCount());
+        appendCounter(out, "mysql_pool_session_resets_total", "Dirty sessions reset on release.",
+                      pool.getSessionResetCount());
+
+        // 3. 性能统计，没有开启时只输出上面的部分
+        PoolMetricsPtr metrics = pool.getMetrics();
+        if (!metrics)
+            return;
+        PoolMetrics::Snapshot snapshot = metrics->snapshot();
+
+        std::string name;
+        for (size_t c = 0; c < PoolMetrics::COUNTER_COUNT; ++c)
+        {
+            PoolMetrics::Counter counter = static_cast<PoolMetrics::Counter>(c);
+            if (counter == PoolMetrics::ERROR_TOTAL)
+                continue;
+            name = "mysql_pool_";
+            name += PoolMetrics::counterName(counter);
+            name += "_total";
+            appendCounter(out, name.c_str(), "Pool event count.", snapshot.counters[c]);
+        }
+
+        appendHeader(out, "mysql_pool_errors_total", "counter", "Failed statements by MySQL error code.");
+        for (const auto &error : snapshot.errors)
+        {
+            out += "mysql_pool_errors_total{errno=\"";
+            appendUnsigned(out, error.first);
+            out += "\"} ";
+            appendUnsigned(out, error.second);
+            out += '\n';
+        }
+
+        for (size_t h = 0; h < PoolMetrics::HISTOGRAM_COUNT; ++h)
+            appendHistogram(out, static_cast<PoolMetrics::Histogram>(h), snapshot.histograms[h]);
+    }
+
+    void appendLabelValue(std::string &out, const std::string &value)
+    {
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '\\':
+                out += "\\\\";
+                break;
+            case '"':
+                out += "\\\"";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            default:
+                out += c;
+            }
+        }
+    }
+}   // namespace PrometheusExporter
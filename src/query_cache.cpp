@@ -0,0 +1,456 @@
+#include "query_cache.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+
+/**
+ * @brief 查询结果缓存的实现
+ */
+
+namespace
+{
+    /**
+     * @brief SQL的词法单元，只区分解析表名需要的几种
+     */
+    struct Token
+    {
+        enum Kind
+        {
+            WORD,   // 关键字或者没有引号的标识符
+            QUOTED, // 反引号括起来的标识符
+            PUNCT   // 单个标点符号
+        };
+        Kind kind;
+        std::string text;   // WORD已经转换为小写
+    };
+
+    inline bool isWordChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' ||
+               static_cast<unsigned char>(c) >= 0x80;   // 多字节字符也可以出现在标识符中
+    }
+
+    /**
+     * @brief 跳过从pos开始的字符串常量，返回结束引号之后的位置
+     */
+    size_t skipQuoted(const std::string &sql, size_t pos)
+    {
+        char quote = sql[pos++];
+        while (pos < sql.size())
+        {
+            char c = sql[pos++];
+            if (c == '\\' && quote != '`')
+                ++pos;  // 反斜杠转义的字符
+            else if (c == quote)
+            {
+                if (pos < sql.size() && sql[pos] == quote)
+                    ++pos;  // 两个引号表示引号本身
+                else
+                    break;
+            }
+        }
+        return std::min(pos, sql.size());
+    }
+
+    /**
+     * @brief 把SQL切分为词法单元，跳过注释和字符串常量
+     */
+    std::vector<Token> tokenize(const std::string &sql)
+    {
+        std::vector<Token> tokens;
+        size_t i = 0;
+        while (i < sql.size())
+        {
+            char c = sql[i];
+            if (std::isspace(static_cast<unsigned char>(c)))
+            {
+                ++i;
+            }
+            else if (c == '#' || (c == '-' && i + 2 <= sql.size() && sql.compare(i, 2, "--") == 0))
+            {
+                size_t end = sql.find('\n', i);
+                i = end == std::string::npos ? sql.size() : end + 1;
+            }
+            else if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*')
+            {
+                size_t end = sql.find("*/", i + 2);
+                i = end == std::string::npos ? sql.size() : end + 2;
+            }
+            else if (c == '\'' || c == '"')
+            {
+                i = skipQuoted(sql, i);
+            }
+            else if (c == '`')
+            {
+                size_t end = skipQuoted(sql, i);
+                std::string name;
+                for (size_t j = i + 1; j < end; ++j)
+                {
+                    if (sql[j] == '`' && (j + 1 >= end || sql[j + 1] != '`'))
+                        break;
+                    name.push_back(sql[j]);
+                    if (sql[j] == '`')
+                        ++j;    // 两个反引号表示反引号本身
+                }
+                tokens.push_back({Token::QUOTED, Utils::toLower(name)});
+                i = end;
+            }
+            else if (isWordChar(c))
+            {
+                size_t start = i;
+                while (i < sql.size() && isWordChar(sql[i]))
+                    ++i;
+                tokens.push_back({Token::WORD, Utils::toLower(sql.substr(start, i - start))});
+            }
+            else
+            {
+                tokens.push_back({Token::PUNCT, std::string(1, c)});
+                ++i;
+            }
+        }
+        return tokens;
+    }
+
+    inline bool isWord(const std::vector<Token> &tokens, size_t i, const char *word)
+    {
+        return i < tokens.size() && tokens[i].kind == Token::WORD && tokens[i].text == word;
+    }
+
+    inline bool isPunct(const std::vector<Token> &tokens, size_t i, char c)
+    {
+        return i < tokens.size() && tokens[i].kind == Token::PUNCT && tokens[i].text[0] == c;
+    }
+
+    /**
+     * @brief 表名之后出现这些关键字时，说明后面不是别名
+     */
+    bool isClauseKeyword(const std::string &word)
+    {
+        static const std::unordered_set<std::string> keywords = {
+            "where", "join", "inner", "left", "right", "cross", "natural", "straight_join", "on", "using",
+            "group", "order", "limit", "set", "having", "union", "for", "lock", "window", "partition",
+            "use", "ignore", "force", "values", "value", "select", "as", "into", "from", "with", "returning"};
+        return keywords.count(word) != 0;
+    }
+
+    /**
+     * @brief 从tokens[i]开始读取一个表名（可以是db.table），成功时把表名追加到tables
+     * @return 表名之后的位置；不是表名时返回i
+     */
+    size_t readTableName(const std::vector<Token> &tokens, size_t i, std::vector<std::string> &tables)
+    {
+        if (i >= tokens.size() || tokens[i].kind == Token::PUNCT)
+            return i;
+        if (tokens[i].kind == Token::WORD && isClauseKeyword(tokens[i].text))
+            return i;
+
+        size_t last = i++;
+        // db.table的形式，只保留table
+        while (isPunct(tokens, i, '.') && i + 1 < tokens.size() && tokens[i + 1].kind != Token::PUNCT)
+        {
+            last = i + 1;
+            i += 2;
+        }
+        tables.push_back(tokens[last].text);
+        return i;
+    }
+
+    /**
+     * @brief 读取逗号分隔的表名列表，每个表名之后可以有别名：FROM a, b AS x, c y
+     */
+    size_t readTableList(const std::vector<Token> &tokens, size_t i, std::vector<std::string> &tables)
+    {
+        while (true)
+        {
+            size_t next = readTableName(tokens, i, tables);
+            if (next == i)
+                return i;
+            i = next;
+
+            // 跳过别名
+            if (isWord(tokens, i, "as"))
+                i += 2;
+            else if (i < tokens.size() && (tokens[i].kind == Token::QUOTED ||
+                                           (tokens[i].kind == Token::WORD && !isClauseKeyword(tokens[i].text))))
+                ++i;
+
+            if (!isPunct(tokens, i, ','))
+                return i;
+            ++i;
+        }
+    }
+
+    /**
+     * @brief 会修改数据或者表结构的语句的第一个关键字
+     */
+    bool isModifyingKeyword(const std::string &word)
+    {
+        static const std::unordered_set<std::string> keywords = {
+            "insert", "update", "delete", "replace", "truncate", "alter", "drop", "create",
+            "rename", "load", "call", "with", "handler", "import"};
+        return keywords.count(word) != 0;
+    }
+}   // namespace
+
+// =============================
+// 构造函数
+// =============================
+
+QueryCache::QueryCache(size_t maxMemoryBytes, int64_t ttlMs)
+    : m_maxMemoryBytes(maxMemoryBytes), m_ttlMs(ttlMs), m_memoryUsage(0), m_generation(0)
+{
+}
+
+// =============================
+// 缓存读写方法
+// =============================
+
+ColumnarResultPtr QueryCache::get(const std::string &sql)
+{
+    std::string key = normalizeSql(sql);
+    int64_t now = Utils::currentTimeMillis();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+    {
+        ++m_stats.misses;
+        return nullptr;
+    }
+    if (it->second->expireAt <= now)
+    {
+        // 过期的条目直接删除，由调用者重新查询
+        removeEntry(it->second);
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    // 移动到LRU链表的头部，splice不会使迭代器失效
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    ++m_stats.hits;
+    return it->second->result;
+}
+
+uint64_t QueryCache::getGeneration() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
+
+bool QueryCache::put(const std::string &sql, ColumnarResultPtr result, uint64_t generation)
+{
+    if (!result)
+        return false;
+
+    // 在锁外完成解析和内存估算
+    size_t memory = result->getMemoryUsage() + sql.size();
+    if (memory > m_maxMemoryBytes)
+        return false;
+    std::string key = normalizeSql(sql);
+    std::vector<std::string> tables = extractTables(key);
+    int64_t expireAt = Utils::currentTimeMillis() + m_ttlMs;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // 查询期间有表失效，这个结果可能已经过时
+    if (generation != m_generation)
+        return false;
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+        removeEntry(it->second);
+
+    // 按照LRU淘汰，直到放得下新的条目
+    while (!m_lru.empty() && m_memoryUsage + memory > m_maxMemoryBytes)
+    {
+        removeEntry(std::prev(m_lru.end()));
+        ++m_stats.evictions;
+    }
+
+    m_lru.push_front(Entry{key, std::move(result), std::move(tables), expireAt, memory});
+    m_entries[key] = m_lru.begin();
+    for (const std::string &table : m_lru.front().tables)
+        m_tables[table].insert(key);
+    m_memoryUsage += memory;
+    return true;
+}
+
+// =============================
+// 失效方法
+// =============================
+
+void QueryCache::invalidateTable(const std::string &table)
+{
+    // 只按照table匹配：db.table -> table
+    std::string name = Utils::toLower(table);
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos)
+        name = name.substr(dot + 1);
+    name.erase(std::remove(name.begin(), name.end(), '`'), name.end());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    auto tableIt = m_tables.find(name);
+    if (tableIt == m_tables.end())
+        return;
+
+    // removeEntry会修改m_tables，先把键拷贝出来
+    std::vector<std::string> keys(tableIt->second.begin(), tableIt->second.end());
+    for (const std::string &key : keys)
+    {
+        auto it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            removeEntry(it->second);
+            ++m_stats.invalidations;
+        }
+    }
+}
+
+void QueryCache::invalidateStatement(const std::string &sql)
+{
+    std::vector<Token> tokens = tokenize(sql);
+    if (tokens.empty() || tokens[0].kind != Token::WORD || !isModifyingKeyword(tokens[0].text))
+        return;     // SET/USE/COMMIT等语句不会修改数据
+
+    std::vector<std::string> tables = extractTables(sql);
+    // 存储过程或者无法识别的写语句，不知道修改了哪些表，只能全部失效
+    if (tables.empty() || tokens[0].text == "call")
+    {
+        clear();
+        return;
+    }
+    for (const std::string &table : tables)
+        invalidateTable(table);
+}
+
+void QueryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    m_stats.invalidations += m_entries.size();
+    m_lru.clear();
+    m_entries.clear();
+    m_tables.clear();
+    m_memoryUsage = 0;
+}
+
+QueryCache::Stats QueryCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.entries = m_entries.size();
+    stats.memoryUsage = m_memoryUsage;
+    return stats;
+}
+
+// =============================
+// SQL解析方法
+// =============================
+
+std::string QueryCache::normalizeSql(const std::string &sql)
+{
+    std::string key;
+    key.reserve(sql.size());
+    size_t i = 0;
+    while (i < sql.size())
+    {
+        char c = sql[i];
+        if (c == '\'' || c == '"' || c == '`')
+        {
+            // 引号之内的内容原样保留
+            size_t end = skipQuoted(sql, i);
+            key.append(sql, i, end - i);
+            i = end;
+        }
+        else if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            while (i < sql.size() && std::isspace(static_cast<unsigned char>(sql[i])))
+                ++i;
+            if (!key.empty())
+                key.push_back(' ');
+        }
+        else
+        {
+            key.push_back(c);
+            ++i;
+        }
+    }
+
+    // 去掉结尾的空白和分号
+    while (!key.empty() && (key.back() == ' ' || key.back() == ';'))
+        key.pop_back();
+    return key;
+}
+
+std::vector<std::string> QueryCache::extractTables(const std::string &sql)
+{
+    std::vector<Token> tokens = tokenize(sql);
+    std::vector<std::string> tables;
+
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        if (tokens[i].kind != Token::WORD)
+            continue;
+        const std::string &word = tokens[i].text;
+
+        if (word == "from" || word == "update")
+        {
+            size_t j = i + 1;
+            // UPDATE LOW_PRIORITY IGNORE t / DELETE FROM t
+            while (isWord(tokens, j, "low_priority") || isWord(tokens, j, "ignore"))
+                ++j;
+            i = readTableList(tokens, j, tables) - 1;
+        }
+        else if (word == "join" || word == "truncate")
+        {
+            size_t j = i + 1;
+            if (isWord(tokens, j, "table"))
+                ++j;
+            i = readTableName(tokens, j, tables) - 1;
+        }
+        else if (word == "into")
+        {
+            // SELECT ... INTO OUTFILE/DUMPFILE/@var不是表
+            if (isWord(tokens, i + 1, "outfile") || isWord(tokens, i + 1, "dumpfile"))
+                continue;
+            // LOAD DATA ... INTO TABLE t
+            size_t j = isWord(tokens, i + 1, "table") ? i + 2 : i + 1;
+            i = readTableName(tokens, j, tables) - 1;
+        }
+        else if (word == "table")
+        {
+            // CREATE TABLE IF NOT EXISTS t / DROP TABLE IF EXISTS a, b / ALTER TABLE t / RENAME TABLE a TO b
+            size_t j = i + 1;
+            if (isWord(tokens, j, "if"))
+                j += isWord(tokens, j + 1, "not") ? 3 : 2;
+            i = readTableList(tokens, j, tables) - 1;
+            if (isWord(tokens, i + 1, "to"))
+                i = readTableName(tokens, i + 2, tables) - 1;
+        }
+    }
+
+    std::sort(tables.begin(), tables.end());
+    tables.erase(std::unique(tables.begin(), tables.end()), tables.end());
+    return tables;
+}
+
+// =============================
+// 私有辅助方法
+// =============================
+
+void QueryCache::removeEntry(EntryList::iterator it)
+{
+    for (const std::string &table : it->tables)
+    {
+        auto tableIt = m_tables.find(table);
+        if (tableIt != m_tables.end())
+        {
+            tableIt->second.erase(it->key);
+            if (tableIt->second.empty())
+                m_tables.erase(tableIt);
+        }
+    }
+    m_memoryUsage -= it->memory;
+    m_entries.erase(it->key);
+    m_lru.erase(it);
+}
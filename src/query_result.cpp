@@ -199,6 +199,32 @@ bool QueryResult::hasResultSet() const
     return m_result != nullptr;
 }
 
+// =============================
+// 按列转换方法
+// =============================
+ColumnarResult QueryResult::toColumns()
+{
+    if (!m_result)
+        throw std::runtime_error("this is non-select operation, cannot convert to columns");
+
+    ColumnarResult columns(m_result);
+    // ColumnarResult会遍历到结果集末尾，需要把游标重置到开头
+    reset();
+    return columns;
+}
+
+ColumnarResult QueryResult::nextColumns(size_t maxRows)
+{
+    if (!m_result)
+        throw std::runtime_error("this is non-select operation, cannot convert to columns");
+
+    ColumnarResult columns(m_result, maxRows);
+    // 游标已经被ColumnarResult移动，当前行不再有效
+    m_currentRow = nullptr;
+    m_lengths = nullptr;
+    return columns;
+}
+
 // =============================
 // 数据访问方法（按索引）
 // =============================
@@ -309,6 +335,23 @@ bool QueryResult::isNull(unsigned int index) const
     }
 }
 
+// =============================
+// 原始数据访问方法
+// =============================
+const char *QueryResult::getRawValue(unsigned int index, unsigned long &length) const
+{
+    checkIndex(index);
+    checkRow();
+
+    length = m_currentRow[index] ? m_lengths[index] : 0;
+    return m_currentRow[index];
+}
+
+const MYSQL_FIELD *QueryResult::getFields() const
+{
+    return m_result ? mysql_fetch_fields(m_result) : nullptr;
+}
+
 // =============================
 // 数据访问方法（按照字段名）
 // =============================
@@ -0,0 +1,366 @@
+#include "query_stats.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief 按照SQL指纹的执行统计的实现
+ */
+
+// 类内初始化的static const成员被ODR使用时需要定义（C++14）
+const size_t QueryStats::kSegmentCount;
+
+namespace
+{
+    // 字符的类别，查表代替一连串的比较
+    enum CharClass : unsigned char
+    {
+        CHAR_OTHER = 0,
+        CHAR_SPACE = 1,
+        CHAR_DIGIT = 2,
+        CHAR_IDENTIFIER = 4,    // 字母、数字、_、$、@、非ASCII字符
+        CHAR_COMPARISON = 8,    // < > = !
+    };
+
+    struct CharClassTable
+    {
+        unsigned char classes[256];
+    };
+
+    constexpr CharClassTable makeCharClassTable()
+    {
+        CharClassTable table{};
+        for (int c = 0; c < 256; ++c)
+        {
+            unsigned char cls = CHAR_OTHER;
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v')
+                cls = CHAR_SPACE;
+            else if (c >= '0' && c <= '9')
+                cls = CHAR_DIGIT | CHAR_IDENTIFIER;
+            else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c == '@' || c >= 0x80)
+                cls = CHAR_IDENTIFIER;
+            else if (c == '<' || c == '>' || c == '=' || c == '!')
+                cls = CHAR_COMPARISON;
+            table.classes[c] = cls;
+        }
+        return table;
+    }
+
+    constexpr CharClassTable kCharClasses = makeCharClassTable();
+
+    bool hasClass(char c, unsigned char cls)
+    {
+        return (kCharClasses.classes[static_cast<unsigned char>(c)] & cls) != 0;
+    }
+
+    bool isSpace(char c)
+    {
+        return hasClass(c, CHAR_SPACE);
+    }
+
+    bool isDigit(char c)
+    {
+        return hasClass(c, CHAR_DIGIT);
+    }
+
+    bool isIdentifierChar(char c)
+    {
+        return hasClass(c, CHAR_IDENTIFIER);
+    }
+
+    bool isComparison(char c)
+    {
+        return hasClass(c, CHAR_COMPARISON);
+    }
+
+    /**
+     * @brief 64位哈希，每次处理8个字节
+     */
+    uint64_t hashBytes(const char *data, size_t length)
+    {
+        const uint64_t kMultiplier = 0x9E3779B97F4A7C15ull;
+        uint64_t hash = length * kMultiplier;
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * kMultiplier;
+            hash ^= hash >> 29;
+        }
+        if (i < length)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, data + i, length - i);
+            hash = (hash ^ word) * kMultiplier;
+        }
+        hash ^= hash >> 32;
+        hash *= kMultiplier;
+        return hash ^ (hash >> 29);
+    }
+
+    /**
+     * @brief 指纹的输出游标，缓冲区预先分配好，写入时不检查容量
+     * 每个输入字符最多产生两个输出字符（记号前的空格 + 字符本身），缓冲区大小为输入的两倍即可
+     */
+    struct FingerprintWriter
+    {
+        char *begin;
+        char *pos;
+
+        bool empty() const { return pos == begin; }
+        char back() const { return pos[-1]; }
+        void put(char c) { *pos++ = c; }
+
+        bool endsWith(const char *suffix, size_t length) const
+        {
+            return static_cast<size_t>(pos - begin) >= length && std::memcmp(pos - length, suffix, length) == 0;
+        }
+
+        /**
+         * @brief 输出一个占位符，紧跟在"?, "之后的占位符与前一个合并：IN (1, 2, 3) -> in(?)
+         */
+        void placeholder()
+        {
+            if (endsWith("?, ", 3))
+                pos -= 2;
+            else
+                put('?');
+        }
+    };
+
+    /**
+     * @brief 跳过字符串字面量，支持反斜杠转义和两个连续的引号
+     * @return 字面量之后的位置
+     */
+    size_t skipString(const char *sql, size_t n, size_t i)
+    {
+        char quote = sql[i++];
+        while (i < n)
+        {
+            char c = sql[i++];
+            if (c == '\\')
+                ++i;
+            else if (c == quote)
+            {
+                if (i < n && sql[i] == quote)
+                    ++i;
+                else
+                    break;
+            }
+        }
+        return std::min(i, n);
+    }
+
+    /**
+     * @brief 跳过数字字面量：整数、小数、科学计数法、0x十六进制
+     * @return 字面量之后的位置
+     */
+    size_t skipNumber(const char *sql, size_t n, size_t i)
+    {
+        if (sql[i] == '0' && i + 1 < n && (sql[i + 1] == 'x' || sql[i + 1] == 'X'))
+        {
+            i += 2;
+            while (i < n && isIdentifierChar(sql[i]))
+                ++i;
+            return i;
+        }
+        while (i < n && (isDigit(sql[i]) || sql[i] == '.'))
+            ++i;
+        if (i < n && (sql[i] == 'e' || sql[i] == 'E'))
+        {
+            size_t j = i + 1;
+            if (j < n && (sql[j] == '+' || sql[j] == '-'))
+                ++j;
+            if (j < n && isDigit(sql[j]))
+            {
+                i = j;
+                while (i < n && isDigit(sql[i]))
+                    ++i;
+            }
+        }
+        return i;
+    }
+}
+
+// =============================
+// 构造函数
+// =============================
+
+QueryStats::QueryStats(size_t capacity)
+    : m_segmentCapacity(std::max<size_t>((capacity + kSegmentCount - 1) / kSegmentCount, 1))
+{
+}
+
+// =============================
+// 记录和读取
+// =============================
+
+void QueryStats::record(const std::string &sql, uint64_t micros, uint64_t rows, uint64_t affectedRows)
+{
+    // 规范化在锁外完成，缓冲区在线程内复用，正常情况下不分配内存
+    thread_local std::string normalized;
+    uint64_t hash = fingerprint(sql, normalized);
+
+    Segment &segment = m_segments[hash % kSegmentCount];
+    std::lock_guard<std::mutex> lock(segment.mutex);
+    auto it = segment.entries.find(hash);
+    if (it == segment.entries.end())
+    {
+        // 满了以后淘汰总耗时最少的指纹，新指纹继承它的总耗时
+        uint64_t inherited = 0;
+        if (segment.entries.size() >= m_segmentCapacity)
+        {
+            auto victim = std::min_element(segment.entries.begin(), segment.entries.end(),
+                                           [](const std::pair<const uint64_t, Entry> &a,
+                                              const std::pair<const uint64_t, Entry> &b) {
+                                               return a.second.totalMicros < b.second.totalMicros;
+                                           });
+            inherited = victim->second.totalMicros;
+            segment.entries.erase(victim);
+        }
+        it = segment.entries.emplace(hash, Entry()).first;
+        it->second.fingerprint = normalized;
+        it->second.hash = hash;
+        it->second.totalMicros = inherited;
+        it->second.overestimate = inherited;
+    }
+
+    Entry &entry = it->second;
+    ++entry.calls;
+    entry.totalMicros += micros;
+    entry.maxMicros = std::max(entry.maxMicros, micros);
+    entry.rows += rows;
+    entry.affectedRows += affectedRows;
+}
+
+std::vector<QueryStats::Entry> QueryStats::top(size_t n) const
+{
+    std::vector<Entry> result;
+    for (const Segment &segment : m_segments)
+    {
+        std::lock_guard<std::mutex> lock(segment.mutex);
+        for (const auto &entry : segment.entries)
+            result.push_back(entry.second);
+    }
+
+    auto byTotal = [](const Entry &a, const Entry &b) { return a.totalMicros > b.totalMicros; };
+    if (n < result.size())
+    {
+        std::partial_sort(result.begin(), result.begin() + n, result.end(), byTotal);
+        result.resize(n);
+    }
+    else
+    {
+        std::sort(result.begin(), result.end(), byTotal);
+    }
+    return result;
+}
+
+void QueryStats::clear()
+{
+    for (Segment &segment : m_segments)
+    {
+        std::lock_guard<std::mutex> lock(segment.mutex);
+        segment.entries.clear();
+    }
+}
+
+// =============================
+// 指纹
+// =============================
+
+uint64_t QueryStats::fingerprint(const std::string &sql, std::string &out)
+{
+    // 输入和输出都用局部指针访问，避免写输出时编译器认为std::string的成员可能被修改而反复重新读取
+    const char *text = sql.data();
+    size_t n = sql.size();
+    out.resize(2 * n);
+    FingerprintWriter writer{&out[0], &out[0]};
+
+    size_t i = 0;
+    while (i < n)
+    {
+        char c = text[i];
+
+        // 1. 空白和注释直接跳过，记号之间的空格在下面统一决定
+        if (isSpace(c))
+        {
+            ++i;
+            continue;
+        }
+        if (c == '#' || (c == '-' && i + 1 < n && text[i + 1] == '-' && (i + 2 == n || isSpace(text[i + 2]))))
+        {
+            while (i < n && text[i] != '\n')
+                ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && text[i + 1] == '*')
+        {
+            for (i += 2; i + 1 < n && !(text[i] == '*' && text[i + 1] == '/'); ++i)
+                ;
+            i = std::min(i + 2, n);
+            continue;
+        }
+        if (c == ';')
+        {
+            ++i;    // 结尾的分号不影响指纹
+            continue;
+        }
+
+        // 2. 记号之间有且只有一个空格，括号、逗号、点号附近除外，与原始SQL的空白无关：
+        //    id=7 与 id = 42 都是 id = ?，IN (1) 与 IN(1) 都是 in(?)
+        if (!writer.empty() && writer.back() != '(' && writer.back() != '.' &&
+            c != '(' && c != ')' && c != ',' && c != '.')
+            writer.put(' ');
+
+        // 3. 记号
+        if (c == '\'' || c == '"')
+        {
+            i = skipString(text, n, i);
+            writer.placeholder();
+        }
+        else if (isDigit(c))
+        {
+            i = skipNumber(text, n, i);
+            writer.placeholder();
+        }
+        else if (c == '?')
+        {
+            ++i;
+            writer.placeholder();
+        }
+        else if (c == '`')
+        {
+            // 反引号中的标识符区分大小写，原样保留
+            writer.put(c);
+            for (++i; i < n && text[i] != '`'; ++i)
+                writer.put(text[i]);
+            if (i < n)
+                writer.put(text[i++]);
+        }
+        else if (isIdentifierChar(c))
+        {
+            for (; i < n && isIdentifierChar(text[i]); ++i)
+            {
+                char ch = text[i];
+                writer.put((ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch);
+            }
+        }
+        else if (isComparison(c))
+        {
+            // 比较运算符连在一起作为一个记号：>=、<>、!=、<=>
+            for (; i < n && isComparison(text[i]); ++i)
+                writer.put(text[i]);
+        }
+        else
+        {
+            writer.put(c);
+            ++i;
+            // 多行VALUES合并为一行：(?),(?) -> (?)
+            if (c == ')' && writer.endsWith("(?),(?)", 7))
+                writer.pos -= 4;
+        }
+    }
+    out.resize(static_cast<size_t>(writer.pos - writer.begin));
+    return hashBytes(out.data(), out.size());
+}
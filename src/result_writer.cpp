@@ -0,0 +1,378 @@
+#include "result_writer.h"
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief 查询结果到JSON/CSV的序列化的实现
+ */
+
+// =============================
+// 分块输出缓冲区
+// =============================
+
+// 类内初始化的static const成员被ODR使用时需要定义（C++14）
+const size_t ChunkedWriter::kChunkSize;
+
+ChunkedWriter::ChunkedWriter(OutputSink &sink)
+    : m_sink(sink), m_chunk(new char[kChunkSize]), m_pos(0)
+{
+}
+
+ChunkedWriter::~ChunkedWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+        // 析构函数中不能抛出异常，Sink的写入失败只能忽略
+    }
+}
+
+void ChunkedWriter::flush()
+{
+    if (m_pos > 0)
+    {
+        // 先清零再写入，即使Sink抛出异常，也不会重复写入同一块
+        size_t pos = m_pos;
+        m_pos = 0;
+        m_sink.write(m_chunk.get(), pos);
+    }
+}
+
+void ChunkedWriter::writeSlow(const char *data, size_t length)
+{
+    // 先把当前块填满并交给Sink
+    size_t room = kChunkSize - m_pos;
+    std::memcpy(m_chunk.get() + m_pos, data, room);
+    m_pos += room;
+    data += room;
+    length -= room;
+    flush();
+
+    // 剩余的数据如果超过一整块，直接交给Sink，不经过缓冲区
+    if (length >= kChunkSize)
+    {
+        m_sink.write(data, length);
+        return;
+    }
+    std::memcpy(m_chunk.get(), data, length);
+    m_pos = length;
+}
+
+namespace
+{
+    /**
+     * @brief 从from开始查找第一个需要JSON转义的字符：'"'、'\\'以及所有小于0x20的控制字符
+     * @return 字符的位置，找不到时返回length
+     */
+    size_t findJsonSpecial(const char *data, size_t from, size_t length)
+    {
+        size_t i = from;
+#if defined(__AVX2__)
+        // 没有无符号字节比较指令，用max_epu8(x, 0x1F) == 0x1F判断x <= 0x1F
+        const __m256i dquote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i ctrl = _mm256_set1_epi8(0x1F);
+        for (; i + 32 <= length; i += 32)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i hits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, dquote), _mm256_cmpeq_epi8(block, backslash)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(block, ctrl), ctrl));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(hits));
+            if (mask != 0)
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+#elif defined(__SSE2__)
+        const __m128i dquote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i ctrl = _mm_set1_epi8(0x1F);
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, dquote), _mm_cmpeq_epi8(block, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(block, ctrl), ctrl));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+            if (mask != 0)
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+#endif
+        // 剩余不足一个块的部分（或者不支持SIMD的平台）逐个字符处理
+        for (; i < length; ++i)
+        {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            if (c == '"' || c == '\\' || c < 0x20)
+                return i;
+        }
+        return length;
+    }
+
+    /**
+     * @brief 查找第一个需要CSV加引号的字符：','、'"'、'\r'、'\n'
+     * @return 字符的位置，找不到时返回length
+     */
+    size_t findCsvSpecial(const char *data, size_t length)
+    {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i dquote = _mm256_set1_epi8('"');
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        for (; i + 32 <= length; i += 32)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i hits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, comma), _mm256_cmpeq_epi8(block, dquote)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, cr), _mm256_cmpeq_epi8(block, lf)));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(hits));
+            if (mask != 0)
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+#elif defined(__SSE2__)
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i dquote = _mm_set1_epi8('"');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, dquote)),
+                _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+            if (mask != 0)
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+#endif
+        for (; i < length; ++i)
+        {
+            char c = data[i];
+            if (c == ',' || c == '"' || c == '\r' || c == '\n')
+                return i;
+        }
+        return length;
+    }
+
+    /**
+     * @brief 把字符串转义后写入（不包括两端的引号）
+     * 两个特殊字符之间的干净片段整体写入；Out需要提供write(data, length)和put(c)
+     */
+    template <typename Out>
+    void writeJsonEscaped(Out &out, const char *data, size_t length)
+    {
+        static const char kHex[] = "0123456789abcdef";
+        size_t pos = 0;
+        size_t hit;
+        while ((hit = findJsonSpecial(data, pos, length)) < length)
+        {
+            out.write(data + pos, hit - pos);
+            unsigned char c = static_cast<unsigned char>(data[hit]);
+            char shortEscape = 0;
+            switch (c)
+            {
+            case '"': shortEscape = '"'; break;
+            case '\\': shortEscape = '\\'; break;
+            case '\n': shortEscape = 'n'; break;
+            case '\r': shortEscape = 'r'; break;
+            case '\t': shortEscape = 't'; break;
+            case '\b': shortEscape = 'b'; break;
+            case '\f': shortEscape = 'f'; break;
+            default: break;
+            }
+            if (shortEscape)
+            {
+                char escaped[2] = {'\\', shortEscape};
+                out.write(escaped, 2);
+            }
+            else
+            {
+                // 其他控制字符使用\u00XX
+                char escaped[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+                out.write(escaped, 6);
+            }
+            pos = hit + 1;
+        }
+        out.write(data + pos, length - pos);
+    }
+
+    /**
+     * @brief 追加到std::string的适配器，用于预先生成列名前缀
+     */
+    struct StringOut
+    {
+        std::string &str;
+        void write(const char *data, size_t length) { str.append(data, length); }
+        void put(char c) { str.push_back(c); }
+    };
+
+    /**
+     * @brief 按RFC 4180写入一个CSV字段
+     * 只有包含','、'"'、CR、LF时才加引号，字段中的'"'写成两个
+     */
+    void writeCsvField(ChunkedWriter &out, const char *data, size_t length)
+    {
+        size_t hit = findCsvSpecial(data, length);
+        if (hit == length)
+        {
+            out.write(data, length);
+            return;
+        }
+
+        out.put('"');
+        // 第一个特殊字符之前的片段一定不包含'"'，之后用memchr查找引号
+        size_t pos = 0;
+        const char *quote;
+        while ((quote = static_cast<const char *>(std::memchr(data + hit, '"', length - hit))) != nullptr)
+        {
+            size_t quotePos = static_cast<size_t>(quote - data);
+            out.write(data + pos, quotePos + 1 - pos);  // 包括这个引号
+            out.put('"');                               // 再写一个引号
+            pos = quotePos + 1;
+            hit = pos;
+        }
+        out.write(data + pos, length - pos);
+        out.put('"');
+    }
+
+    /**
+     * @brief 检查结果集，并把游标重置到开头
+     */
+    const MYSQL_FIELD *prepareResult(QueryResult &result, const char *format)
+    {
+        const MYSQL_FIELD *fields = result.getFields();
+        if (!fields)
+            throw std::runtime_error(std::string("this is non-select operation, cannot write ") + format);
+        result.reset();
+        return fields;
+    }
+}   // namespace
+
+namespace ResultWriter
+{
+    bool isNumericField(const MYSQL_FIELD &field)
+    {
+        // YEAR的零值是"0000"，不是合法的JSON数字，按字符串输出
+        switch (field.type)
+        {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_LONGLONG:
+        case MYSQL_TYPE_FLOAT:
+        case MYSQL_TYPE_DOUBLE:
+        case MYSQL_TYPE_DECIMAL:
+        case MYSQL_TYPE_NEWDECIMAL:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void writeJson(QueryResult &result, OutputSink &sink)
+    {
+        const MYSQL_FIELD *fields = prepareResult(result, "json");
+        unsigned int fieldCount = result.getFieldCount();
+
+        // 1. 预先生成每一列的键前缀：第一列是{"name":，其他列是,"name":
+        std::vector<std::string> keyPrefixes(fieldCount);
+        std::vector<bool> numeric(fieldCount);
+        for (unsigned int i = 0; i < fieldCount; ++i)
+        {
+            StringOut prefix{keyPrefixes[i]};
+            prefix.put(i == 0 ? '{' : ',');
+            prefix.put('"');
+            writeJsonEscaped(prefix, fields[i].name, std::strlen(fields[i].name));
+            prefix.write("\":", 2);
+            numeric[i] = isNumericField(fields[i]);
+        }
+
+        // 2. 逐行写入，每个单元格直接读取原始字节
+        ChunkedWriter out(sink);
+        out.put('[');
+        bool firstRow = true;
+        while (result.next())
+        {
+            if (!firstRow)
+                out.put(',');
+            firstRow = false;
+
+            if (fieldCount == 0)
+                out.put('{');
+            for (unsigned int i = 0; i < fieldCount; ++i)
+            {
+                out.write(keyPrefixes[i].data(), keyPrefixes[i].size());
+                unsigned long length;
+                const char *value = result.getRawValue(i, length);
+                if (value == nullptr)
+                {
+                    out.write("null", 4);
+                }
+                else if (numeric[i])
+                {
+                    out.write(value, length);
+                }
+                else
+                {
+                    out.put('"');
+                    writeJsonEscaped(out, value, length);
+                    out.put('"');
+                }
+            }
+            out.put('}');
+        }
+        out.put(']');
+        out.flush();
+
+        result.reset();
+    }
+
+    void writeCsv(QueryResult &result, OutputSink &sink)
+    {
+        const MYSQL_FIELD *fields = prepareResult(result, "csv");
+        unsigned int fieldCount = result.getFieldCount();
+
+        ChunkedWriter out(sink);
+
+        // 1. 第一行是列名
+        for (unsigned int i = 0; i < fieldCount; ++i)
+        {
+            if (i > 0)
+                out.put(',');
+            writeCsvField(out, fields[i].name, std::strlen(fields[i].name));
+        }
+        out.write("\r\n", 2);
+
+        // 2. 逐行写入，NULL是空字段，空字符串是""
+        while (result.next())
+        {
+            for (unsigned int i = 0; i < fieldCount; ++i)
+            {
+                if (i > 0)
+                    out.put(',');
+                unsigned long length;
+                const char *value = result.getRawValue(i, length);
+                if (value == nullptr)
+                    continue;
+                if (length == 0)
+                    out.write("\"\"", 2);
+                else
+                    writeCsvField(out, value, length);
+            }
+            out.write("\r\n", 2);
+        }
+        out.flush();
+
+        result.reset();
+    }
+}   // namespace ResultWriter
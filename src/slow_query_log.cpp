@@ -0,0 +1,173 @@
+#include "slow_query_log.h"
+#include "utils.h"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cinttypes>
+
+/**
+ * @brief 慢查询日志的实现
+ */
+
+namespace
+{
+    /**
+     * @brief 线程内的xorshift随机数，只用于采样，不需要密码学强度
+     */
+    uint32_t nextRandom()
+    {
+        thread_local uint32_t state = static_cast<uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /**
+     * @brief 采样率换算为随机数的阈值，1表示全部记录
+     */
+    uint32_t sampleThresholdOf(double sampleRate)
+    {
+        if (sampleRate >= 1.0)
+            return UINT32_MAX;
+        if (sampleRate <= 0.0)
+            return 0;
+        return static_cast<uint32_t>(sampleRate * 4294967296.0);
+    }
+}
+
+// =============================
+// 构造函数和析构函数
+// =============================
+
+SlowQueryLog::SlowQueryLog(const std::string &filePath, uint64_t thresholdMicros, double sampleRate,
+                           size_t maxSqlLength, size_t queueCapacity)
+    : m_thresholdMicros(thresholdMicros), m_sampleThreshold(sampleThresholdOf(sampleRate)),
+      m_maxSqlLength(maxSqlLength), m_queueCapacity(std::max<size_t>(queueCapacity, 1)),
+      m_pending(0), m_stopping(false), m_written(0), m_dropped(0), m_sampledOut(0)
+{
+    m_file.open(filePath, std::ios::app);
+    if (!m_file.is_open())
+        throw std::runtime_error(filePath + " cannot open normally, please check filePath is right or not!");
+    m_writer = std::thread(&SlowQueryLog::writerLoop, this);
+}
+
+SlowQueryLog::~SlowQueryLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_one();
+    if (m_writer.joinable())
+        m_writer.join();
+}
+
+// =============================
+// 提交和写入
+// =============================
+
+void SlowQueryLog::submit(uint64_t micros, const std::string &connectionId, uint64_t rows, uint64_t affectedRows,
+                          const std::string &sql)
+{
+    if (m_sampleThreshold != UINT32_MAX && nextRandom() >= m_sampleThreshold)
+    {
+        m_sampledOut.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // 在锁外构造记录，锁内只做一次移动
+    SlowQuery record;
+    record.timestamp = Utils::currentTimeMillis();
+    record.micros = micros;
+    record.connectionId = connectionId;
+    record.rows = rows;
+    record.affectedRows = affectedRows;
+    if (m_maxSqlLength > 0)
+    {
+        record.truncated = sql.size() > m_maxSqlLength;
+        record.sql.assign(sql, 0, std::min(sql.size(), m_maxSqlLength));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.size() >= m_queueCapacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_queue.push_back(std::move(record));
+        ++m_pending;
+    }
+    m_cv.notify_one();
+}
+
+void SlowQueryLog::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_drainedCv.wait(lock, [this] { return m_pending == 0; });
+}
+
+void SlowQueryLog::writerLoop()
+{
+    std::deque<SlowQuery> batch;
+    std::string line;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_cv.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty())
+            break;      // 退出前已经写完了所有记录
+
+        // 一次取走队列中所有的记录，写文件时不持有锁
+        batch.swap(m_queue);
+        lock.unlock();
+        for (const SlowQuery &record : batch)
+        {
+            format(record, line);
+            m_file << line;
+        }
+        m_file.flush();
+        m_written.fetch_add(batch.size(), std::memory_order_relaxed);
+        size_t count = batch.size();
+        batch.clear();
+        lock.lock();
+
+        m_pending -= count;
+        if (m_pending == 0)
+            m_drainedCv.notify_all();
+    }
+}
+
+void SlowQueryLog::format(const SlowQuery &record, std::string &line)
+{
+    // 使用localtime_r，后台线程和其他线程同时格式化时间也不会互相影响
+    std::time_t seconds = static_cast<std::time_t>(record.timestamp / 1000);
+    std::tm local;
+    localtime_r(&seconds, &local);
+    char buffer[160];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "%04d-%02d-%02d %02d:%02d:%02d.%03d duration=%" PRIu64 ".%03" PRIu64 "ms connection=",
+                               local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min,
+                               local.tm_sec, static_cast<int>(record.timestamp % 1000), record.micros / 1000,
+                               record.micros % 1000);
+    line.assign(buffer, static_cast<size_t>(length));
+    line += record.connectionId;
+    length = std::snprintf(buffer, sizeof(buffer), " rows=%" PRIu64 " affected=%" PRIu64, record.rows,
+                           record.affectedRows);
+    line.append(buffer, static_cast<size_t>(length));
+
+    if (!record.sql.empty())
+    {
+        // 一条记录只占一行，SQL中的换行替换为空格
+        line += " sql=";
+        for (char c : record.sql)
+            line += (c == '\n' || c == '\r') ? ' ' : c;
+        if (record.truncated)
+            line += "...";
+    }
+    line += '\n';
+}
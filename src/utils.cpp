@@ -1,6 +1,13 @@
 // 这里创建的是简单的源文件实现
 #include "utils.h"
 #include <map>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // 命名空间放在包含头文件的外面
 namespace Utils {
@@ -15,4 +22,138 @@ namespace Utils {
     //     return std::map<std::string, std::string>{};
     // }
 
-}   // namespace Utils
\ No newline at end of file
+namespace
+{
+    /**
+     * @brief 写入单个字符的转义结果，返回写入后的位置
+     * 不是特殊字符时原样写入
+     */
+    inline char *escapeChar(char *dst, char c)
+    {
+        char escaped;
+        switch (c)
+        {
+        case '\0': escaped = '0'; break;    // NULL字符
+        case '\n': escaped = 'n'; break;    // 换行符
+        case '\r': escaped = 'r'; break;    // 回车符
+        case '\\': escaped = '\\'; break;   // 反斜杠
+        case '\'': escaped = '\''; break;   // 单引号；最重要的
+        case '"': escaped = '"'; break;     // 双引号
+        case '\x1a': escaped = 'Z'; break;  // Ctrl + Z
+        case '\t': escaped = 't'; break;    // 制表符
+        case '\b': escaped = 'b'; break;    // 退格符
+        default:
+            *dst++ = c;
+            return dst;
+        }
+        *dst++ = '\\';
+        *dst++ = escaped;
+        return dst;
+    }
+
+    /**
+     * @brief 处理一个SIMD块：mask中每一位对应块中的一个字节，为1表示需要转义
+     * 两个特殊字符之间的干净片段使用memcpy整体拷贝
+     */
+    inline char *escapeBlock(char *dst, const char *src, size_t blockSize, unsigned int mask)
+    {
+        size_t pos = 0;
+        while (mask != 0)
+        {
+            size_t hit = static_cast<size_t>(__builtin_ctz(mask));
+            std::memcpy(dst, src + pos, hit - pos);
+            dst += hit - pos;
+            dst = escapeChar(dst, src[hit]);
+            pos = hit + 1;
+            mask &= mask - 1;   // 清除最低位的1
+        }
+        std::memcpy(dst, src + pos, blockSize - pos);
+        return dst + (blockSize - pos);
+    }
+}   // namespace
+
+void escapeAppend(std::string &out, const char *data, size_t length)
+{
+    // 最坏情况下每个字符都需要转义，先按照2倍长度扩容，写完后再截断
+    // 如果out是复用的缓冲区，容量足够时不会发生任何内存分配
+    size_t oldSize = out.size();
+    out.resize(oldSize + length * 2);
+    char *begin = &out[0];
+    char *dst = begin + oldSize;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    // 每次扫描32字节，与9个特殊字符逐一比较，合并成一个位掩码
+    const __m256i quote = _mm256_set1_epi8('\'');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i nul = _mm256_set1_epi8('\0');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i ctrlZ = _mm256_set1_epi8('\x1a');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i bs = _mm256_set1_epi8('\b');
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, dquote)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(block, backslash), _mm256_cmpeq_epi8(block, nul))),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, lf), _mm256_cmpeq_epi8(block, cr)),
+                            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, ctrlZ), _mm256_cmpeq_epi8(block, tab)),
+                                            _mm256_cmpeq_epi8(block, bs))));
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(hits));
+        if (mask == 0)
+        {
+            // 干净的块直接整体拷贝，这是最常见的情况
+            std::memcpy(dst, data + i, 32);
+            dst += 32;
+        }
+        else
+        {
+            dst = escapeBlock(dst, data + i, 32, mask);
+        }
+    }
+#elif defined(__SSE2__)
+    // 每次扫描16字节
+    const __m128i quote = _mm_set1_epi8('\'');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i nul = _mm_set1_epi8('\0');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i ctrlZ = _mm_set1_epi8('\x1a');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i bs = _mm_set1_epi8('\b');
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, dquote)),
+                         _mm_or_si128(_mm_cmpeq_epi8(block, backslash), _mm_cmpeq_epi8(block, nul))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, cr)),
+                         _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, ctrlZ), _mm_cmpeq_epi8(block, tab)),
+                                      _mm_cmpeq_epi8(block, bs))));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+        if (mask == 0)
+        {
+            std::memcpy(dst, data + i, 16);
+            dst += 16;
+        }
+        else
+        {
+            dst = escapeBlock(dst, data + i, 16, mask);
+        }
+    }
+#endif
+
+    // 剩余不足一个块的部分（或者不支持SIMD的平台）逐个字符处理
+    for (; i < length; ++i)
+    {
+        dst = escapeChar(dst, data[i]);
+    }
+
+    out.resize(static_cast<size_t>(dst - begin));
+}
+
+}   // namespace Utils
@@ -1,6 +1,9 @@
 #include <cassert>
 #include <thread>
 #include "utils.h"
+#include "sql_template.h"
+#include "query_cache.h"
+#include "pool_metrics.h"
 #include "logger.h"
 
 
@@ -39,9 +42,89 @@ void testMySQLEscape()
         std::cout << "  " << tc.description << " : " << Utils::quoteMySQLString(tc.input) << std::endl;
     }
 
+    // 验证escapeAppend的SIMD路径与逐字符转义的结果一致，长度覆盖16/32字节块的边界
+    std::cout << "\n--- 测试escapeAppend追加转义 ---" << std::endl;
+    auto reference = [](const std::string &str) {
+        std::string escaped;
+        for(char c : str)
+        {
+            switch (c)
+            {
+            case '\0': escaped += "\\0"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\'': escaped += "\\'"; break;
+            case '"': escaped += "\\\""; break;
+            case '\x1a': escaped += "\\Z"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\b': escaped += "\\b"; break;
+            default: escaped += c; break;
+            }
+        }
+        return escaped;
+    };
+    const char specials[] = {'\0', '\n', '\r', '\\', '\'', '"', '\x1a', '\t', '\b'};
+    std::mt19937 rng(42);
+    std::string buffer;     // 复用的输出缓冲区
+    for(size_t length = 0; length < 100; ++length)
+    {
+        std::string input = Utils::generateRandomString(length);
+        for(size_t i = 0; i < length; ++i)
+        {
+            if(rng() % 5 == 0)
+                input[i] = specials[rng() % sizeof(specials)];
+        }
+        buffer.assign("prefix:");
+        Utils::escapeAppend(buffer, input.data(), input.size());
+        assert(buffer == "prefix:" + reference(input));
+        assert(Utils::escapeMySQLString(input) == reference(input));
+    }
+    assert(Utils::quoteMySQLString("O'relly") == "'O\\'relly'");
+
     std::cout << "  MySQL字符串转义测试通过!" << std::endl;
 }
 
+/**
+ * @brief 测试编译期检查占位符数量的SQL模板
+ */
+void testSqlTemplate()
+{
+    std::cout << "\n--- 测试SqlTemplate ---" << std::endl;
+
+    // 占位符数量在编译期确定，引号内的?不是占位符
+    constexpr auto findUser = SQL_TEMPLATE("SELECT * FROM users WHERE id = ? AND name = ? AND note <> '?'");
+    static_assert(decltype(findUser)::placeholderCount() == 2, "引号内的?不应该被统计");
+    // findUser.format(1);  编译错误：占位符数量与参数数量不一致
+
+    // 注释里的?不是占位符，注释里的引号也不会影响后面的占位符
+    static_assert(countSqlPlaceholders("SELECT * FROM t -- what?\nWHERE id = ?") == 1, "-- 注释内的?不应该被统计");
+    static_assert(countSqlPlaceholders("SELECT * FROM t -- user's row\nWHERE id = ?") == 1, "-- 注释内的引号不应该生效");
+    static_assert(countSqlPlaceholders("SELECT * FROM t # what?\nWHERE id = ?") == 1, "#注释内的?不应该被统计");
+    static_assert(countSqlPlaceholders("SELECT * FROM t # user's row\nWHERE id = ?") == 1, "#注释内的引号不应该生效");
+    static_assert(countSqlPlaceholders("SELECT /* what? */ * FROM t WHERE id = ?") == 1, "块注释内的?不应该被统计");
+    static_assert(countSqlPlaceholders("SELECT /* user's row */ * FROM t WHERE id = ?") == 1, "块注释内的引号不应该生效");
+    static_assert(countSqlPlaceholders("SELECT /**/ ? FROM t WHERE a = ? -- ?") == 2, "空的块注释和行尾的-- 注释");
+    static_assert(countSqlPlaceholders("SELECT 5--? FROM t WHERE id = ?") == 2, "--后面没有空白时是减号，不是注释");
+    static_assert(countSqlPlaceholders("SELECT '#?', \"--?\" FROM t WHERE id = ?") == 1, "引号内的注释符号不是注释");
+    static_assert(countSqlPlaceholders("SELECT ? /* unterminated ?") == 1, "没有闭合的块注释一直到语句结束");
+
+    constexpr auto commented = SQL_TEMPLATE("SELECT * FROM users -- user's row?\nWHERE id = ?");
+    assert(commented.format(7) == "SELECT * FROM users -- user's row?\nWHERE id = 7");
+
+    std::string sql = findUser.format(42, std::string("O'relly"));
+    assert(sql == "SELECT * FROM users WHERE id = 42 AND name = 'O\\'relly' AND note <> '?'");
+
+    auto insertUser = SQL_TEMPLATE("INSERT INTO users (name, age, score, email) VALUES (?, ?, ?, ?)");
+    std::string buffer;     // 复用的输出缓冲区
+    insertUser.formatTo(buffer, "张三", -2147483647LL - 1, 0.5, nullptr);
+    assert(buffer == "INSERT INTO users (name, age, score, email) VALUES ('张三', -2147483648, 0.5, NULL)");
+
+    std::cout << "  " << sql << std::endl
+              << "  " << buffer << std::endl;
+    std::cout << "  SqlTemplate测试通过!" << std::endl;
+}
+
 /**
  * @brief 进行Utils工具类的基准测试
  */
@@ -86,6 +169,8 @@ void testUtils()
 
     // 测试SQL字符串转移函数
     testMySQLEscape();
+    // 测试SQL模板
+    testSqlTemplate();
     // 测试字节数格式化函数
     std::string formatted = Utils::formatBytes(1536);   // 1.5KB
     std::cout << "字节数格式化函数测试通过：" << "1536B = " << formatted << std::endl;
@@ -97,6 +182,107 @@ void testUtils()
     std::cout << "Utils::trim 字符串修剪函数测试通过：'" << trimmed << "'" << std::endl;
 }
 
+/**
+ * @brief 查询缓存的测试，不需要数据库连接
+ */
+void testQueryCache()
+{
+    std::cout << "\n=== 测试QueryCache查询缓存 ===" << std::endl;
+
+    // 规范化：合并引号外的空白，去掉结尾的分号，引号内的内容不变
+    assert(QueryCache::normalizeSql("  SELECT *\n\tFROM  users WHERE name = 'a  b' ; ") ==
+           "SELECT * FROM users WHERE name = 'a  b'");
+
+    // 解析表名
+    auto tables = QueryCache::extractTables(
+        "SELECT u.id FROM `Shop`.`Users` u, items i JOIN orders AS o ON o.uid = u.id WHERE note = 'from fake'");
+    assert((tables == std::vector<std::string>{"items", "orders", "users"}));
+    assert((QueryCache::extractTables("UPDATE LOW_PRIORITY users SET age = 1") == std::vector<std::string>{"users"}));
+    assert((QueryCache::extractTables("INSERT INTO logs SELECT * FROM users") == std::vector<std::string>{"logs", "users"}));
+    assert((QueryCache::extractTables("TRUNCATE TABLE db.logs") == std::vector<std::string>{"logs"}));
+    assert(QueryCache::extractTables("SELECT NOW()").empty());
+
+    // 按表失效
+    QueryCache cache(1024 * 1024, 60000);
+    auto result = std::make_shared<const ColumnarResult>();
+    assert(cache.put("SELECT * FROM users", result, cache.getGeneration()));
+    assert(cache.put("SELECT * FROM flags", result, cache.getGeneration()));
+    assert(cache.get("select * from users") == nullptr);     // 键区分大小写
+    assert(cache.get("SELECT *   FROM users;") == result);
+    cache.invalidateStatement("UPDATE Users SET age = 1");
+    assert(cache.get("SELECT * FROM users") == nullptr);
+    assert(cache.get("SELECT * FROM flags") == result);
+    cache.invalidateStatement("SET autocommit = 1");            // 不是写语句，不会失效
+    assert(cache.get("SELECT * FROM flags") == result);
+
+    // 查询期间发生了失效，结果不会被写入
+    uint64_t generation = cache.getGeneration();
+    cache.invalidateTable("orders");
+    assert(!cache.put("SELECT * FROM orders", result, generation));
+
+    // 超出内存预算时按照LRU淘汰
+    size_t entrySize = result->getMemoryUsage() + std::string("SELECT * FROM t0").size();
+    QueryCache small(entrySize * 2, 60000);
+    small.put("SELECT * FROM t0", result, small.getGeneration());
+    small.put("SELECT * FROM t1", result, small.getGeneration());
+    small.get("SELECT * FROM t0");                              // t0成为最近使用的
+    small.put("SELECT * FROM t2", result, small.getGeneration());
+    assert(small.get("SELECT * FROM t1") == nullptr);
+    assert(small.get("SELECT * FROM t0") == result);
+    assert(small.getStats().evictions == 1);
+
+    // 过期
+    QueryCache shortLived(1024 * 1024, 10);
+    shortLived.put("SELECT 1", result, shortLived.getGeneration());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(shortLived.get("SELECT 1") == nullptr);
+
+    std::cout << "QueryCache测试通过" << std::endl;
+}
+
+/**
+ * @brief 性能统计的测试，不需要数据库连接
+ */
+void testPoolMetrics()
+{
+    std::cout << "\n=== 测试PoolMetrics性能统计 ===" << std::endl;
+
+    // 每个值都落在上界不小于它、前一个桶上界小于它的桶中
+    for (uint64_t value : {0ull, 31ull, 32ull, 33ull, 64ull, 1000ull, 123456ull, (1ull << 32) - 1})
+    {
+        size_t index = PoolMetrics::bucketIndex(value);
+        assert(PoolMetrics::bucketUpperBound(index) >= value);
+        assert(index == 0 || PoolMetrics::bucketUpperBound(index - 1) < value);
+    }
+
+    // 多个线程同时记录，汇总之后不丢失
+    PoolMetrics metrics;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&metrics] {
+            for (uint64_t micros = 1; micros <= 10000; ++micros)
+                metrics.record(PoolMetrics::QUERY, micros);
+            metrics.increment(PoolMetrics::ACQUIRE_TIMEOUT);
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    metrics.recordError(1213);
+
+    PoolMetrics::Snapshot snapshot = metrics.snapshot();
+    const PoolMetrics::HistogramSnapshot &query = snapshot.histograms[PoolMetrics::QUERY];
+    assert(query.count == 80000 && query.max == 10000);
+    assert(query.p50 >= 5000 && query.p50 <= 5000 * 1.04);     // 相对误差不超过约3%
+    assert(query.p99 >= 9900 && query.p99 <= 10000);
+    assert(snapshot.counters[PoolMetrics::ACQUIRE_TIMEOUT] == 8);
+    assert(snapshot.counters[PoolMetrics::ERROR_TOTAL] == 1 && snapshot.errors[1213] == 1);
+
+    std::cout << "query p50: " << query.p50 << "us, p90: " << query.p90 << "us, p99: " << query.p99
+              << "us, p999: " << query.p999 << "us" << std::endl;
+    std::cout << "PoolMetrics测试通过" << std::endl;
+}
+
 /**
  * @brief 日志类所有功能的基准测试
  */
@@ -202,6 +388,8 @@ int main()
     try
     {
         testUtils();
+        testQueryCache();
+        testPoolMetrics();
 
         // 应该在主程序的一开始处就完成Logger的初始化操作,其中的相对路径相对的是开始执行程序的当前路径
         Logger::getInstance().init("./docs/test_day1.log");
@@ -1,12 +1,18 @@
+#include <cassert>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <mysql/mysql.h>
 #include <chrono>
+#include <fstream>
 #include "db_config.h"
 #include "pool_config.h"
 #include "logger.h"
 #include "query_result.h"
 #include "connection.h"
+#include "arrow_export.h"
+#include "result_writer.h"
+#include "utils.h"
 
 /**
  * @brief 第二天数据库连接功能测试
@@ -37,6 +43,19 @@ created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
 )
 )"; // ### 需要使用R"()"包裹SQL语句
 
+/**
+ * @brief 与test_users表对应的结构体，用于测试结构体映射
+ */
+struct TestUser
+{
+    int id;
+    std::string name;
+    long long age;
+    std::string email;
+};
+DB_ROW_MAPPING(TestUser, DB_COLUMN(TestUser, id), DB_COLUMN(TestUser, name),
+               DB_COLUMN(TestUser, age), DB_COLUMN(TestUser, email))
+
 /**
  * @brief 打印每个新的测试模块的标题
  */
@@ -257,6 +276,157 @@ void testQueryOperations()
     }
 }
 
+void testRowMapping()
+{
+    printSeparator("测试结构体映射");
+
+    try
+    {
+        Connection conn {TEST_HOST, TEST_USER, TEST_PASSWORD, TEST_DATABASE, TEST_PORT};
+        if(!conn.connect())
+        {
+            std::cout << "连接失败，跳过结构体映射测试" << std::endl;
+            return;
+        }
+
+        // 列的顺序与结构体成员的顺序不同，验证是按照列名绑定的
+        auto result = conn.executeQuery("SELECT email, age, name, id FROM test_users ORDER BY age");
+        std::vector<TestUser> users = result->fetchAll<TestUser>();
+        std::cout << "映射得到 " << users.size() << " 个TestUser（结果集共 " << result->getRowCount() << " 行）" << std::endl;
+        for(const auto &user : users)
+        {
+            std::cout << user.id << "\t" << user.name << "\t" << user.age << "\t" << user.email << std::endl;
+        }
+
+        std::cout << "结构体映射验证通过" << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "结构体映射测试失败：" << e.what() << '\n';
+    }
+}
+
+void testColumnarResult()
+{
+    printSeparator("测试按列存储的结果集");
+
+    try
+    {
+        Connection conn {TEST_HOST, TEST_USER, TEST_PASSWORD, TEST_DATABASE, TEST_PORT};
+        if(!conn.connect())
+        {
+            std::cout << "连接失败，跳过按列存储测试" << std::endl;
+            return;
+        }
+
+        ColumnarResult columns = conn.executeQuery("SELECT id, name, age FROM test_users")->toColumns();
+        const Column &age = columns.getColumn("age");
+        const Column &name = columns.getColumn("name");
+        int64_t ageSum = 0;
+        for(size_t i = 0; i < columns.getRowCount(); ++i)
+        {
+            ageSum += age.int64Values[i];
+        }
+        std::cout << "共 " << columns.getRowCount() << " 行，age列类型为INT64：" << (age.type == ColumnType::INT64 ? "是" : "否")
+                  << "，age总和 = " << ageSum << "，name列字节数 = " << name.bytes.size()
+                  << "，占用内存约 " << Utils::formatBytes(columns.getMemoryUsage()) << std::endl;
+
+        std::cout << "按列存储验证通过" << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "按列存储测试失败：" << e.what() << '\n';
+    }
+}
+
+void testArrowExport()
+{
+    printSeparator("测试Arrow IPC导出");
+
+    try
+    {
+        Connection conn {TEST_HOST, TEST_USER, TEST_PASSWORD, TEST_DATABASE, TEST_PORT};
+        if(!conn.connect())
+        {
+            std::cout << "连接失败，跳过Arrow导出测试" << std::endl;
+            return;
+        }
+
+        auto result = conn.executeQuery("SELECT id, name, age, email, created_at FROM test_users");
+        std::string stream;
+        ArrowExport::exportStream(*result, stream, 2);  // 每批2行，验证多个RecordBatch
+        std::ofstream("./docs/test_users.arrows", std::ios::binary) << stream;
+        std::cout << "导出 " << result->getRowCount() << " 行，共 " << stream.size() << " 字节" << std::endl
+                  << "可以使用 python -c \"import pyarrow as pa; print(pa.ipc.open_stream(open('docs/test_users.arrows','rb').read()).read_all())\" 验证" << std::endl;
+
+        // 检查封装格式：第一条消息是Schema，以继续标记和8字节对齐的元数据长度开头；流以继续标记 + 0长度结束
+        auto readUint32 = [&stream](size_t offset) {
+            uint32_t value = 0;
+            std::memcpy(&value, stream.data() + offset, sizeof(value));
+            return value;
+        };
+        assert(stream.size() >= 16);
+        assert(readUint32(0) == 0xFFFFFFFF);
+        uint32_t schemaLength = readUint32(4);
+        assert(schemaLength > 0 && schemaLength % 8 == 0 && 8 + schemaLength + 8 <= stream.size());
+        assert(readUint32(stream.size() - 8) == 0xFFFFFFFF && readUint32(stream.size() - 4) == 0);
+        // 有数据时Schema之后紧跟着第一个RecordBatch消息
+        if (result->getRowCount() > 0)
+            assert(stream.size() > 8 + schemaLength + 8 && readUint32(8 + schemaLength) == 0xFFFFFFFF);
+
+        std::cout << "Arrow导出验证通过" << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Arrow导出测试失败：" << e.what() << '\n';
+    }
+}
+
+void testResultWriter()
+{
+    printSeparator("测试JSON/CSV序列化");
+
+    try
+    {
+        Connection conn {TEST_HOST, TEST_USER, TEST_PASSWORD, TEST_DATABASE, TEST_PORT};
+        if(!conn.connect())
+        {
+            std::cout << "连接失败，跳过序列化测试" << std::endl;
+            return;
+        }
+
+        auto result = conn.executeQuery("SELECT id, name, age, email, CONCAT('a\\\"b,', CHAR(10)) AS special, NULL AS nothing, '' AS empty FROM test_users ORDER BY id");
+
+        std::string json;
+        StringSink jsonSink(json);
+        ResultWriter::writeJson(*result, jsonSink);
+        std::cout << "JSON: " << json.substr(0, 200) << std::endl;
+        if(json.front() != '[' || json.back() != ']' || json.compare(0, 7, "[{\"id\":") != 0 ||
+           json.find("\"special\":\"a\\\"b,\\n\",\"nothing\":null,\"empty\":\"\"}") == std::string::npos)
+        {
+            std::cout << "JSON序列化结果不正确" << std::endl;
+            return;
+        }
+
+        std::string csv;
+        StringSink csvSink(csv);
+        ResultWriter::writeCsv(*result, csvSink);
+        std::cout << "CSV: " << csv.substr(0, 200) << std::endl;
+        if(csv.compare(0, 41, "id,name,age,email,special,nothing,empty\r\n") != 0 ||
+           csv.find(",\"a\"\"b,\n\",,\"\"\r\n") == std::string::npos)
+        {
+            std::cout << "CSV序列化结果不正确" << std::endl;
+            return;
+        }
+
+        std::cout << "JSON/CSV序列化验证通过" << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "JSON/CSV序列化测试失败：" << e.what() << '\n';
+    }
+}
+
 void testTransactionOperations()
 {
     printSeparator("测试事务操作");
@@ -443,6 +613,58 @@ void testPerformance()
     }
 }
 
+void testBulkLoad()
+{
+    printSeparator("测试LOAD DATA批量导入");
+
+    try
+    {
+        Connection conn {TEST_HOST, TEST_USER, TEST_PASSWORD, TEST_DATABASE, TEST_PORT};
+        if(!conn.connect())
+        {
+            std::cout << "\n MySQL连接建立失败，跳过批量导入测试" << std::endl;
+            return;
+        }
+
+        conn.executeUpdate("DELETE FROM test_users WHERE email = 'bulk@example.com'");
+
+        // 包含分隔符、转义符的特殊字符串，验证转义是否正确
+        const int total = 10000;
+        int i = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        unsigned long long loaded = conn.bulkLoad("test_users", {"name", "age", "email"}, [&](BulkRowWriter &row) {
+            if(i == total)
+                return false;
+            if(i == 0)
+                row.addString("tab\tnew\nline\\slash");
+            else
+                row.addString("批量用户" + std::to_string(i));
+            row.addInt(20 + i % 30).addString("bulk@example.com");
+            ++i;
+            return true;
+        });
+        auto end = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        std::cout << "批量导入 " << loaded << " 行数据，共花费 " << duration.count() << " ms" << std::endl;
+
+        auto result = conn.executeQuery("SELECT COUNT(*) AS count FROM test_users WHERE email = 'bulk@example.com'");
+        result->next();
+        std::cout << "查询到 " << result->getInt("count") << " 行批量导入的数据（应该是" << total << "行）" << std::endl;
+
+        result = conn.executeQuery("SELECT name FROM test_users WHERE name LIKE 'tab%'");
+        if(result->next())
+        {
+            std::cout << "特殊字符往返验证：" << (result->getString(0) == "tab\tnew\nline\\slash" ? "通过" : "失败") << std::endl;
+        }
+
+        conn.executeUpdate("DELETE FROM test_users WHERE email = 'bulk@example.com'");
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "批量导入测试失败（请确认服务端开启了local_infile）：" << e.what() << '\n';
+    }
+}
+
 int main()
 {
     std::cout << "开始第2天数据库连接测试..." << std::endl;
@@ -462,9 +684,14 @@ int main()
 
         testBasicConnection();
         testQueryOperations();
+        testRowMapping();
+        testColumnarResult();
+        testArrowExport();
+        testResultWriter();
         testTransactionOperations();
         testErrorHandling();
         testPerformance();
+        testBulkLoad();
 
         std::cout << "\n 恭喜我自己，我终于完成了第2天的所有测试任务！" << std::endl
                   << "我已经成功实现了：" << std::endl
@@ -0,0 +1,564 @@
+#include <cassert>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include "pool_config.h"
+#include "logger.h"
+#include "connection_pool.h"
+
+/**
+ * @brief 连接池功能测试
+ *
+ * 注意：运行此测试前需要先运行test_day2_connection，创建测试数据库和test_users表
+ */
+
+// 测试用数据库连接参数，全局常量
+const std::string TEST_HOST = "localhost";
+const std::string TEST_USER = "admin";
+const std::string TEST_PASSWORD = "123456";
+const std::string TEST_DATABASE = "testdb";
+const unsigned int TEST_PORT = 3306;
+
+/**
+ * @brief 打印每个新的测试模块的标题
+ */
+void printSeparator(const std::string &title)
+{
+    std::cout << '\n'
+              << std::string(50, '=') << std::endl;
+    std::cout << "  " << title << std::endl;
+    std::cout << std::string(50, '=') << std::endl;
+}
+
+PoolConfig makeTestConfig()
+{
+    PoolConfig config{TEST_HOST, TEST_USER, TEST_PASSWORD, TEST_DATABASE, TEST_PORT};
+    config.setConnectionLimits(2, 4, 2);
+    config.setTimeouts(500, 300000, 30000);
+    return config;
+}
+
+void testBorrowAndReturn()
+{
+    printSeparator("测试连接的借出与归还");
+
+    ConnectionPool pool(makeTestConfig());
+    std::cout << "初始连接数：" << pool.getTotalCount() << "，空闲：" << pool.getIdleCount() << std::endl;
+
+    {
+        std::vector<ConnectionPtr> borrowed;
+        for (int i = 0; i < 4; ++i)
+            borrowed.push_back(pool.getConnection());
+        std::cout << "借出4个连接，活跃：" << pool.getActiveCount() << "，总数：" << pool.getTotalCount() << std::endl;
+
+        // 连接已经全部借出，等待connectionTimeout之后返回nullptr
+        auto start = std::chrono::steady_clock::now();
+        ConnectionPtr extra = pool.getConnection();
+        auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "第5个连接：" << (extra ? "获取成功（错误）" : "超时（正确）") << "，等待 " << waited << "ms" << std::endl;
+
+        // 其他线程归还连接之后，等待者可以立即拿到
+        std::thread releaser([&borrowed] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            borrowed[0].reset();
+        });
+        extra = pool.getConnection();
+        releaser.join();
+        std::cout << "归还之后再次获取：" << (extra ? "成功" : "失败") << std::endl;
+    }
+
+    std::cout << "全部归还之后，活跃：" << pool.getActiveCount() << "，空闲：" << pool.getIdleCount() << std::endl;
+}
+
+void testFairWaiting()
+{
+    printSeparator("测试按照到达顺序等待连接");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 1, 1);
+    config.setTimeouts(2000, 300000, 30000);
+    ConnectionPool pool(config);
+
+    ConnectionPtr holder = pool.getConnection();
+    std::mutex orderMutex;
+    std::vector<int> order;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 5; ++i)
+    {
+        threads.emplace_back([&pool, &orderMutex, &order, i] {
+            ConnectionPtr conn = pool.getConnection();
+            if (conn)
+            {
+                std::lock_guard<std::mutex> lock(orderMutex);
+                order.push_back(i);
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));   // 保证到达顺序
+    }
+
+    // 截止时间已经过去的请求不会等待，也不会拿到连接
+    ConnectionPtr expired = pool.getConnection(std::chrono::steady_clock::now());
+    std::cout << "过期的请求：" << (expired ? "拿到了连接（错误）" : "立即返回（正确）") << std::endl;
+    assert(expired == nullptr);
+
+    holder.reset();
+    for (auto &thread : threads)
+        thread.join();
+
+    std::cout << "获得连接的顺序：";
+    for (int i : order)
+        std::cout << i << " ";
+    std::cout << (order == std::vector<int>{0, 1, 2, 3, 4} ? "（先到先得）" : "（顺序错误）") << std::endl;
+    assert((order == std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+void testExpiredDeadline()
+{
+    printSeparator("测试过期的请求不会拿到空闲连接");
+
+    ConnectionPool pool(makeTestConfig());
+    PoolMetrics::Snapshot before = pool.getMetrics()->snapshot();
+    size_t idle = pool.getIdleCount();
+
+    // 有空闲连接、也有创建名额，截止时间已经过去的请求仍然要返回nullptr，并且计入超时
+    ConnectionPtr expired = pool.getConnection(std::chrono::steady_clock::now() - std::chrono::milliseconds(1));
+    PoolMetrics::Snapshot after = pool.getMetrics()->snapshot();
+    std::cout << "空闲：" << idle << "，过期的请求：" << (expired ? "拿到了连接（错误）" : "返回nullptr（正确）")
+              << "，超时次数：" << after.counters[PoolMetrics::ACQUIRE_TIMEOUT] - before.counters[PoolMetrics::ACQUIRE_TIMEOUT]
+              << std::endl;
+    assert(idle > 0);
+    assert(expired == nullptr);
+    assert(after.counters[PoolMetrics::ACQUIRE_TIMEOUT] == before.counters[PoolMetrics::ACQUIRE_TIMEOUT] + 1);
+    assert(pool.getIdleCount() == idle && pool.getActiveCount() == 0);
+}
+
+void testPriorityReserve()
+{
+    printSeparator("测试优先级预留");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 4, 1);
+    config.setPriorityReserves(1, 1);   // BATCH最多2个，NORMAL最多3个，CRITICAL可以用满4个
+    config.setTimeouts(200, 300000, 30000);
+    ConnectionPool pool(config);
+
+    std::vector<ConnectionPtr> batch;
+    while (ConnectionPtr conn = pool.getConnection(AcquirePriority::BATCH))
+        batch.push_back(conn);
+    ConnectionPtr normal = pool.getConnection(AcquirePriority::NORMAL);
+    ConnectionPtr normalExtra = pool.getConnection(AcquirePriority::NORMAL);
+    ConnectionPtr critical = pool.getConnection(AcquirePriority::CRITICAL);
+
+    std::cout << "BATCH借到 " << batch.size() << " 个（预期2个）" << std::endl
+              << "NORMAL：" << (normal ? "成功" : "失败") << "，再借一个：" << (normalExtra ? "成功（错误）" : "失败（正确）") << std::endl
+              << "CRITICAL使用最后一个连接：" << (critical ? "成功" : "失败") << std::endl;
+    assert(batch.size() == 2);
+    assert(normal != nullptr);
+    assert(normalExtra == nullptr);
+    assert(critical != nullptr);
+}
+
+void testAdaptiveSizing()
+{
+    printSeparator("测试自适应连接数");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 8, 1);
+    config.setTimeouts(2000, 300000, 30000);
+    config.enableAdaptiveSizing(100, 5);
+    ConnectionPool pool(config);
+    std::cout << "初始上限：" << pool.getTargetCount() << std::endl;
+
+    // 8个线程持续执行慢查询，排队会推动扩容
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&pool, &stop] {
+            while (!stop)
+            {
+                ConnectionPtr conn = pool.getConnection();
+                if (conn)
+                    conn->executeQuery("SELECT SLEEP(0.02)");
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    std::cout << "高负载时上限：" << pool.getTargetCount() << "，连接总数：" << pool.getTotalCount() << std::endl;
+    stop = true;
+    for (auto &thread : threads)
+        thread.join();
+
+    // 空闲之后连续多个周期利用率偏低，逐步收缩到minConnections
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    std::cout << "空闲之后上限：" << pool.getTargetCount() << "，连接总数：" << pool.getTotalCount() << std::endl;
+}
+
+void testLoadShedding()
+{
+    printSeparator("测试过载保护");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 1, 1);
+    config.setAdmissionControl(2, 20, 50);
+    ConnectionPool pool(config);
+
+    // 1. 等待队列满了之后，新的请求立即失败
+    ConnectionPtr holder = pool.getConnection();
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 2; ++i)
+    {
+        waiters.emplace_back([&pool] {
+            pool.getConnection(std::chrono::steady_clock::now() + std::chrono::milliseconds(300));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        pool.getConnection();
+        std::cout << "队列已满时获取连接：没有被拒绝（错误）" << std::endl;
+        assert(false && "等待队列已满时应该抛出PoolOverloadException");
+    }
+    catch (const PoolOverloadException &e)
+    {
+        auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "队列已满时获取连接：" << e.what() << "，耗时 " << waited << "ms" << std::endl;
+    }
+    for (auto &thread : waiters)
+        thread.join();
+
+    // 2. 队首的逗留时间持续超过目标之后，非CRITICAL请求被拒绝
+    std::thread longWaiter([&pool] {
+        pool.getConnection(std::chrono::steady_clock::now() + std::chrono::milliseconds(400));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    pool.getConnection(std::chrono::steady_clock::now() + std::chrono::milliseconds(5));   // 开始观察
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    try
+    {
+        pool.getConnection();
+        std::cout << "队列持续拥堵时获取连接：没有被拒绝（错误）" << std::endl;
+        assert(false && "队列持续拥堵时应该抛出PoolOverloadException");
+    }
+    catch (const PoolOverloadException &e)
+    {
+        std::cout << "队列持续拥堵时获取连接：" << e.what() << std::endl;
+    }
+    longWaiter.join();
+
+    holder.reset();
+    std::cout << "恢复之后获取连接：" << (pool.getConnection() ? "成功" : "失败") << "，累计拒绝 " << pool.getRejectedCount()
+              << " 次" << std::endl;
+}
+
+void testLifetimeRotation()
+{
+    printSeparator("测试连接到期轮换");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(3, 3, 3);
+    config.maxLifetime = 1500;
+    ConnectionPool pool(config);
+
+    // 一边持续使用连接，一边等待全部连接到期
+    std::atomic<bool> stop{false};
+    std::atomic<int> failures{0};
+    std::thread user([&pool, &stop, &failures] {
+        while (!stop)
+        {
+            ConnectionPtr conn = pool.getConnection();
+            if (!conn)
+                ++failures;
+            else
+                conn->executeQuery("SELECT 1");
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(3200));
+    stop = true;
+    user.join();
+
+    std::cout << "轮换连接数：" << pool.getRotatedCount() << "（预期至少3个），连接总数：" << pool.getTotalCount()
+              << "，获取失败：" << failures << std::endl;
+    assert(pool.getRotatedCount() >= 3);
+    assert(pool.getTotalCount() >= config.minConnections && pool.getTotalCount() <= config.maxConnections);
+}
+
+void testSessionReset()
+{
+    printSeparator("测试归还时重置会话");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 1, 1);
+    config.resetSessionOnRelease = true;
+    ConnectionPool pool(config);
+
+    // 只执行普通查询的连接不需要重置
+    {
+        ConnectionPtr conn = pool.getConnection();
+        conn->executeQuery("SELECT COUNT(*) FROM test_users");
+    }
+    std::cout << "普通查询之后重置次数：" << pool.getSessionResetCount() << "（预期0）" << std::endl;
+    assert(pool.getSessionResetCount() == 0);
+
+    // 留下用户变量和没有结束的事务
+    {
+        ConnectionPtr conn = pool.getConnection();
+        conn->executeUpdate("SET @pool_test = 42");
+        conn->beginTransaction();
+        std::cout << "会话状态：" << conn->getSessionState() << std::endl;
+    }
+
+    // 下一个借出者看不到上一个借出者的会话状态
+    ConnectionPtr conn = pool.getConnection();
+    QueryResultPtr result = conn->executeQuery("SELECT @pool_test AS v");
+    bool hasRow = result->next();
+    assert(hasRow);
+    std::cout << "重置之后 @pool_test：" << (result->isNull("v") ? "NULL（正确）" : result->getString("v") + "（错误）")
+              << std::endl;
+    std::cout << "重置次数：" << pool.getSessionResetCount() << "（预期1）" << std::endl;
+    assert(result->isNull("v"));
+    assert(pool.getSessionResetCount() == 1);
+}
+
+void testPrometheusExport()
+{
+    printSeparator("测试Prometheus格式导出");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 4, 2);
+    ConnectionPool pool(config);
+    {
+        ConnectionPtr conn = pool.getConnection();
+        conn->executeQuery("SELECT COUNT(*) FROM test_users");
+        conn->executeQuery("SELECT * FROM table_not_exists");
+    }
+
+    // 缓冲区在多次抓取之间复用
+    std::string body;
+    for (int i = 0; i < 2; ++i)
+    {
+        body.clear();
+        pool.renderPrometheus(body);
+    }
+    std::istringstream lines(body);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.find("mysql_pool_connections{") == 0 || line.find("mysql_pool_errors_total{") == 0 ||
+            line.find("mysql_pool_query_seconds_count") == 0)
+            std::cout << line << std::endl;
+    }
+    std::cout << "导出大小：" << body.size() << "字节" << std::endl;
+}
+
+void testTopQueries()
+{
+    printSeparator("测试SQL指纹统计");
+
+    PoolConfig config = makeTestConfig();
+    config.queryStatsCapacity = 64;
+    ConnectionPool pool(config);
+    {
+        ConnectionPtr conn = pool.getConnection();
+        // 只有字面量不同的语句得到同一个指纹
+        for (int id = 1; id <= 5; ++id)
+            conn->executeQuery("SELECT * FROM test_users WHERE id = " + std::to_string(id));
+        conn->executeQuery("select *  from test_users where id IN (1, 2, 3)");
+        conn->executeQuery("SELECT SLEEP(0.05)");
+    }
+
+    for (const QueryStats::Entry &entry : pool.getTopQueries(5))
+        std::cout << entry.fingerprint << "  calls=" << entry.calls << " total=" << entry.totalMicros
+                  << "us max=" << entry.maxMicros << "us rows=" << entry.rows << std::endl;
+}
+
+void testSlowQueryLog()
+{
+    printSeparator("测试慢查询日志");
+
+    PoolConfig config = makeTestConfig();
+    config.slowQueryThreshold = 20;
+    config.slowQueryLogFile = "./docs/test_slow_query.log";
+    std::remove(config.slowQueryLogFile.c_str());   // 日志以追加方式打开，清掉之前运行留下的记录
+    ConnectionPool pool(config);
+    {
+        ConnectionPtr conn = pool.getConnection();
+        conn->executeQuery("SELECT COUNT(*) FROM test_users");     // 快查询，不会记录
+        conn->executeQuery("SELECT SLEEP(0.05) AS s");
+    }
+
+    SlowQueryLogPtr slowLog = pool.getSlowQueryLog();
+    slowLog->flush();
+    std::cout << "写入慢查询日志：" << slowLog->getWrittenCount() << "条（预期1），见" << config.slowQueryLogFile << std::endl;
+    assert(slowLog->getWrittenCount() == 1);
+
+    std::ifstream file(config.slowQueryLogFile);
+    std::stringstream content;
+    content << file.rdbuf();
+    assert(content.str().find("SLEEP(0.05)") != std::string::npos);
+    assert(content.str().find("COUNT(*)") == std::string::npos);
+}
+
+/**
+ * @brief 把借出等待时间和数据库执行时间打印出来的拦截器，实际使用时在这里创建和结束span
+ */
+class PrintingInterceptor : public PoolInterceptor
+{
+public:
+    void onAcquireEnd(const AcquireEvent &event) override
+    {
+        std::cout << "  借出等待：" << event.waitMicros << "us" << (event.connection ? "" : "（失败）") << std::endl;
+    }
+
+    void onQueryEnd(const QueryEvent &event) override
+    {
+        std::cout << "  执行：" << *event.sql << "，" << event.micros << "us，errno=" << event.errorCode << std::endl;
+    }
+
+    void onConnect(const ConnectEvent &event) override
+    {
+        std::cout << "  建立连接：" << event.micros << "us，errno=" << event.errorCode << std::endl;
+    }
+};
+
+void testInterceptor()
+{
+    printSeparator("测试拦截器");
+
+    PoolConfig config = makeTestConfig();
+    config.setConnectionLimits(1, 1, 1);
+    config.interceptor = std::make_shared<PrintingInterceptor>();
+    ConnectionPool pool(config);
+
+    ConnectionPtr conn = pool.getConnection();
+    conn->executeQuery("SELECT COUNT(*) FROM test_users");
+    try
+    {
+        conn->executeQuery("SELECT * FROM table_not_exists");
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "预期的失败：" << e.what() << std::endl;
+    }
+}
+
+void testLockProfiling()
+{
+    printSeparator("测试锁竞争分析");
+
+    PoolConfig config = makeTestConfig();
+    ConnectionPool pool(config);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&pool] {
+            for (int k = 0; k < 50; ++k)
+            {
+                ConnectionPtr conn = pool.getConnection();
+                if (conn)
+                    conn->executeQuery("SELECT 1");
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    PoolMetrics::Snapshot snapshot = pool.getMetrics()->snapshot();
+    if (snapshot.locks.empty())
+        std::cout << "没有锁竞争统计，需要使用-DENABLE_LOCK_PROFILING=ON编译" << std::endl;
+    for (const PoolMetrics::LockSnapshot &lock : snapshot.locks)
+        std::cout << lock.site << "：加锁 " << lock.hold.count << " 次，阻塞 " << lock.contended
+                  << " 次，等待p99=" << lock.wait.p99 << "ns，持有p50=" << lock.hold.p50
+                  << "ns，持有max=" << lock.hold.max << "ns" << std::endl;
+}
+
+void testSharedQuery()
+{
+    printSeparator("测试相同查询的合并执行");
+
+    PoolConfig config = makeTestConfig();
+    config.queryCacheSize = 16 * 1024 * 1024;
+    ConnectionPool pool(config);
+
+    // 16个线程同时执行相同的慢查询，只有一个线程真正执行
+    const int threadCount = 16;
+    std::atomic<int> succeeded{0};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([&pool, &succeeded] {
+            try
+            {
+                ColumnarResultPtr result = pool.executeSharedQuery("SELECT SLEEP(0.2) AS s, COUNT(*) AS n FROM test_users");
+                if (result && result->getRowCount() == 1)
+                    ++succeeded;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "共享查询失败：" << e.what() << '\n';
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << threadCount << "个线程，成功 " << succeeded << " 个，合并 " << pool.getCoalescedQueryCount()
+              << " 次，耗时 " << elapsed << "ms（连接数只有 " << config.maxConnections << " 个）" << std::endl;
+
+    // 第二次执行直接命中缓存
+    start = std::chrono::steady_clock::now();
+    pool.executeSharedQuery("SELECT SLEEP(0.2) AS s, COUNT(*) AS n FROM test_users");
+    elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "缓存命中耗时 " << elapsed << "ms" << std::endl;
+
+    // 写操作让缓存失效
+    {
+        ConnectionPtr conn = pool.getConnection();
+        conn->executeUpdate("UPDATE test_users SET age = age WHERE id = 0");
+    }
+    QueryCache::Stats stats = pool.getQueryCache()->getStats();
+    std::cout << "写操作之后缓存条目数：" << stats.entries << "，命中：" << stats.hits
+              << "，未命中：" << stats.misses << "，失效：" << stats.invalidations << std::endl;
+}
+
+int main()
+{
+    std::cout << "开始连接池测试..." << std::endl;
+    Logger::getInstance().init("./docs/test_pool.log", LogLevel::INFO);
+
+    try
+    {
+        testBorrowAndReturn();
+        testFairWaiting();
+        testExpiredDeadline();
+        testPriorityReserve();
+        testAdaptiveSizing();
+        testLoadShedding();
+        testLifetimeRotation();
+        testSessionReset();
+        testPrometheusExport();
+        testTopQueries();
+        testSlowQueryLog();
+        testInterceptor();
+        testLockProfiling();
+        testSharedQuery();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "测试失败：" << e.what() << '\n';
+        return 1;
+    }
+
+    std::cout << "\n连接池测试完成" << std::endl;
+    return 0;
+}